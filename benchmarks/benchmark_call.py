@@ -0,0 +1,94 @@
+#------------------------------------------------------------------------------
+#
+#
+# Copyright (c) 2016, Pivotal.
+#
+#------------------------------------------------------------------------------
+
+import sys
+import datetime as dt
+from gppylib.db import dbconn
+from pygresql.pg import DatabaseError
+
+# Functions doing nothing, so the timing shows the cost of the call itself:
+# sending the arguments, converting them to Python objects and back, and
+# receiving the result. The last one refers to "args" list and so gets it
+# built for every call
+functions = {
+    'call_noarg': ('', """
+# container: plc_python
+return 1
+"""),
+    'call_int': ('a int', """
+# container: plc_python
+return a
+"""),
+    'call_int3': ('a int, b int, c int', """
+# container: plc_python
+return a
+"""),
+    'call_text': ('a text', """
+# container: plc_python
+return 1
+"""),
+    'call_args': ('a int', """
+# container: plc_python
+return args[0]
+""")
+}
+
+queries = {
+    'call_noarg': 'select sum(call_noarg()) from testdata',
+    'call_int': 'select sum(call_int(id)) from testdata',
+    'call_int3': 'select sum(call_int3(id, id, id)) from testdata',
+    'call_text': "select sum(call_text('abcdefghij')) from testdata",
+    'call_args': 'select sum(call_args(id)) from testdata'
+}
+
+def execute_noret(dburl, query):
+    try:
+        conn = dbconn.connect(dburl)
+        curs = dbconn.execSQL(conn, query)
+        conn.commit()
+        conn.close()
+    except DatabaseError, ex:
+        print 'Failed to execute the statement on the database: %s' % ex
+        sys.exit(3)
+    return
+
+def execute_for_timing(dburl, query):
+    conn = dbconn.connect(dburl)
+    # Execute dummy command to bring up container
+    cursor = dbconn.execSQL(conn, "%s where id = 1" % query)
+    cursor.fetchall()
+    n1 = dt.datetime.now()
+    cursor = dbconn.execSQL(conn, query)
+    cursor.fetchall()
+    n2 = dt.datetime.now()
+    cursor.close()
+    conn.close()
+    return ((n2-n1).seconds*1e6 + (n2-n1).microseconds) / 1e6
+
+def main():
+    dbURL = dbconn.DbURL(hostname = '127.0.0.1',
+                         port     = 5432,
+                         dbname   = 'pl_regression',
+                         username = 'vagrant')
+
+    for func, (args, src) in functions.items():
+        execute_noret(dbURL, "create or replace function %s(%s) returns int as $$%s$$ language plcontainer" % (func, args, src))
+
+    cnt = 100000
+    execute_noret(dbURL, "drop table if exists testdata")
+    execute_noret(dbURL, "create table testdata (id int, a int) distributed randomly")
+    execute_noret(dbURL, "insert into testdata (id,a) select id, id from generate_series(1,%d) id" % cnt)
+
+    # Prints the function, number of calls, seconds and calls per second
+    for func in sorted(functions.keys()):
+        s = 0.0
+        for i in range(5):
+            s += execute_for_timing(dbURL, queries[func])
+        s /= 5.0
+        print '%s %d %f %f' % (func, cnt, s, cnt / s)
+
+main()
@@ -0,0 +1,85 @@
+#------------------------------------------------------------------------------
+#
+#
+# Copyright (c) 2016, Pivotal.
+#
+#------------------------------------------------------------------------------
+
+import sys
+import datetime as dt
+from gppylib.db import dbconn
+from pygresql.pg import DatabaseError
+
+# Each function runs 10000 small queries, the first one runs each of them in
+# its own subtransaction, the second one shares a single explicit
+# subtransaction and the third one runs them without subtransactions. The
+# first one is the behavior before the explicit subtransactions were added,
+# the throughput of the others is also reported relative to it
+functions = {
+    'spi_statement_subxact': """
+# container: plc_python
+for i in range(n):
+    plpy.execute('select 1')
+return n
+""",
+    'spi_explicit_subxact': """
+# container: plc_python
+with plpy.subtransaction():
+    for i in range(n):
+        plpy.execute('select 1')
+return n
+""",
+    'spi_no_subxact': """
+# container: plc_python
+# statement_subtransactions: off
+for i in range(n):
+    plpy.execute('select 1')
+return n
+"""
+}
+
+def execute_noret(dburl, query):
+    try:
+        conn = dbconn.connect(dburl)
+        curs = dbconn.execSQL(conn, query)
+        conn.commit()
+        conn.close()
+    except DatabaseError, ex:
+        print 'Failed to execute the statement on the database: %s' % ex
+        sys.exit(3)
+    return
+
+def execute_for_timing(dburl, func, cnt):
+    conn = dbconn.connect(dburl)
+    # Execute dummy command to bring up container
+    cursor = dbconn.execSQL(conn, "select %s(1)" % func)
+    cursor.fetchall()
+    n1 = dt.datetime.now()
+    cursor = dbconn.execSQL(conn, "select %s(%d)" % (func, cnt))
+    cursor.fetchall()
+    n2 = dt.datetime.now()
+    cursor.close()
+    conn.close()
+    return ((n2-n1).seconds*1e6 + (n2-n1).microseconds) / 1e6
+
+def main():
+    dbURL = dbconn.DbURL(hostname = '127.0.0.1',
+                         port     = 5432,
+                         dbname   = 'pl_regression',
+                         username = 'vagrant')
+
+    for func, src in functions.items():
+        execute_noret(dbURL, "create or replace function %s(n int) returns int as $$%s$$ language plcontainer" % (func, src))
+
+    cnt = 10000
+    base = None
+    for func in ['spi_statement_subxact', 'spi_explicit_subxact', 'spi_no_subxact']:
+        s = 0.0
+        for i in range(5):
+            s += execute_for_timing(dbURL, func, cnt)
+        s /= 5.0
+        if base is None:
+            base = s
+        print '%s %d %f %f %.2fx' % (func, cnt, s, cnt / s, base / s)
+
+main()
@@ -30,4 +30,145 @@ $$ LANGUAGE SQL VOLATILE;
 
 CREATE OR REPLACE FUNCTION plcontainer_read_config() RETURNS SETOF plcontainer_status AS $$
     select plcontainer_read_config(false);
+$$ LANGUAGE SQL VOLATILE;
+
+-- Defining client statistics functions
+
+CREATE TYPE plcontainer_client_counter AS (
+    container_name varchar,
+    counter varchar,
+    value int8
+);
+
+CREATE OR REPLACE FUNCTION plcontainer_client_counters() RETURNS SETOF plcontainer_client_counter
+AS '$libdir/plcontainer', 'plcontainer_client_counters'
+LANGUAGE C VOLATILE;
+
+CREATE TYPE plcontainer_client_function_stat AS (
+    container_name varchar,
+    function_oid oid,
+    function_name varchar,
+    calls int8,
+    arguments_time float8,
+    execution_time float8,
+    results_time float8,
+    spi_calls int8,
+    spi_time float8,
+    time_histogram int8[]
+);
+
+CREATE OR REPLACE FUNCTION plcontainer_client_stats() RETURNS SETOF plcontainer_client_function_stat
+AS '$libdir/plcontainer', 'plcontainer_client_stats'
+LANGUAGE C VOLATILE;
+
+-- Defining function call statistics functions
+
+CREATE TYPE plcontainer_function_stat AS (
+    segment_id int,
+    function_oid oid,
+    function_name varchar,
+    calls int8,
+    total_time float8,
+    max_time float8,
+    encode_time float8,
+    receive_time float8,
+    decode_time float8,
+    bytes_sent int8,
+    bytes_received int8,
+    spi_calls int8,
+    log_messages int8
+);
+
+CREATE OR REPLACE FUNCTION plcontainer_local_function_stats() RETURNS SETOF plcontainer_function_stat
+AS '$libdir/plcontainer', 'plcontainer_local_function_stats'
+LANGUAGE C VOLATILE;
+
+CREATE OR REPLACE FUNCTION plcontainer_function_stats() RETURNS SETOF plcontainer_function_stat AS $$
+    select plcontainer_local_function_stats()
+        from (
+            select gp_segment_id
+                from gp_dist_random('pg_namespace')
+                group by 1
+            ) as segments
+    union all
+    select plcontainer_local_function_stats();
+$$ LANGUAGE SQL VOLATILE;
+
+CREATE OR REPLACE FUNCTION plcontainer_function_stats_summary() RETURNS SETOF plcontainer_function_stat AS $$
+    select null::int, function_oid, max(function_name), sum(calls)::int8,
+           sum(total_time), max(max_time), sum(encode_time), sum(receive_time),
+           sum(decode_time), sum(bytes_sent)::int8, sum(bytes_received)::int8,
+           sum(spi_calls)::int8, sum(log_messages)::int8
+        from plcontainer_function_stats()
+        group by function_oid;
+$$ LANGUAGE SQL VOLATILE;
+
+-- Defining call tracing functions
+
+CREATE TYPE plcontainer_trace_event AS (
+    segment_id int,
+    backend_pid int,
+    thread int,
+    thread_name varchar,
+    seq int,
+    name varchar,
+    phase varchar,
+    ts int8
+);
+
+CREATE OR REPLACE FUNCTION plcontainer_local_trace(enable bool) RETURNS text
+AS '$libdir/plcontainer', 'plcontainer_local_trace'
+LANGUAGE C VOLATILE;
+
+CREATE OR REPLACE FUNCTION plcontainer_trace(enable bool) RETURNS SETOF plcontainer_status AS $$
+    select gp_segment_id, plcontainer_local_trace($1)
+        from (
+            select gp_segment_id
+                from gp_dist_random('pg_namespace')
+                group by 1
+            ) as segments
+    union all
+    select -1, plcontainer_local_trace($1);
+$$ LANGUAGE SQL VOLATILE;
+
+CREATE OR REPLACE FUNCTION plcontainer_local_trace_events() RETURNS SETOF plcontainer_trace_event
+AS '$libdir/plcontainer', 'plcontainer_local_trace_events'
+LANGUAGE C VOLATILE;
+
+CREATE OR REPLACE FUNCTION plcontainer_trace_events() RETURNS SETOF plcontainer_trace_event AS $$
+    select plcontainer_local_trace_events()
+        from (
+            select gp_segment_id
+                from gp_dist_random('pg_namespace')
+                group by 1
+            ) as segments
+    union all
+    select plcontainer_local_trace_events();
+$$ LANGUAGE SQL VOLATILE;
+
+-- Text quoted for the use as JSON string value
+CREATE OR REPLACE FUNCTION plcontainer_json_string(value text) RETURNS text
+AS '$libdir/plcontainer', 'plcontainer_json_string'
+LANGUAGE C IMMUTABLE STRICT;
+
+-- Trace in Chrome trace event format, with the backends as the processes and
+-- their containers as the threads
+CREATE OR REPLACE FUNCTION plcontainer_trace_dump() RETURNS text AS $$
+    select '{"traceEvents":[' || array_to_string(array(
+        select case when seq = 0
+                    then '{"name":"process_name","ph":"M","pid":' || backend_pid::text
+                         || ',"args":{"name":'
+                         || plcontainer_json_string(case when segment_id = -1 then 'master'
+                                                         else 'segment ' || segment_id::text end)
+                         || '}},{"name":"thread_name","ph":"M","pid":' || backend_pid::text
+                         || ',"tid":' || thread::text
+                         || ',"args":{"name":' || plcontainer_json_string(thread_name) || '}},'
+                    else '' end
+               || '{"name":' || plcontainer_json_string(name)
+               || ',"cat":"plcontainer","ph":' || plcontainer_json_string(phase)
+               || ',"ts":' || ts::text || ',"pid":' || backend_pid::text
+               || ',"tid":' || thread::text || '}'
+            from plcontainer_trace_events()
+            order by backend_pid, thread, seq
+        ), ',') || ']}';
 $$ LANGUAGE SQL VOLATILE;
\ No newline at end of file
@@ -29,6 +29,7 @@ interpreted as representing official policies, either expressed or implied, of t
 #include "comm_channel.h"
 #include "comm_utils.h"
 #include "comm_connectivity.h"
+#include "comm_trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,6 +38,7 @@ interpreted as representing official policies, either expressed or implied, of t
 
 static int message_start(plcConn *conn, char msgType);
 static int message_end(plcConn *conn);
+static int message_end_deferred(plcConn *conn);
 
 static int send_char(plcConn *conn, char c);
 static int send_int16(plcConn *conn, short i);
@@ -46,9 +48,14 @@ static int send_int64(plcConn *conn, long long i);
 static int send_float4(plcConn *conn, float f);
 static int send_float8(plcConn *conn, double f);
 static int send_cstring(plcConn *conn, char *s);
+static int send_text(plcConn *conn, char *s);
 static int send_bytea(plcConn *conn, char *s);
+static int send_interval(plcConn *conn, plcInterval *iv);
+static int send_temporal_text(plcConn *conn, plcDatatype dt, char *value);
 static int send_raw_object(plcConn *conn, plcType *type, rawdata *obj);
 static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter);
+static int send_contiguous_array(plcConn *conn, plcIterator *iter);
+static int send_fixed_width_array(plcConn *conn, plcIterator *iter);
 static int send_type(plcConn *conn, plcType *type);
 static int send_udt(plcConn *conn, plcType *type, plcUDT *udt);
 
@@ -62,9 +69,16 @@ static int receive_float4(plcConn *conn, float *f);
 static int receive_float8(plcConn *conn, double *f);
 static int receive_raw(plcConn *conn, char *s, size_t len);
 static int receive_cstring(plcConn *conn, char **s);
+static int receive_text(plcConn *conn, char **s);
 static int receive_bytea(plcConn *conn, char **s);
+static int receive_interval(plcConn *conn, plcInterval *iv);
+static int receive_temporal_text(plcConn *conn, plcDatatype dt, char **value);
 static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj);
 static int receive_array(plcConn *conn, plcType *type, rawdata *obj);
+static int receive_contiguous_array(plcConn *conn, plcArray *arr);
+static int receive_contiguous_array_elements(plcConn *conn, plcArray *arr);
+static int receive_fixed_width_array(plcConn *conn, plcArray *arr);
+static int receive_array_text(plcConn *conn, plcArray *arr, int i);
 static int receive_type(plcConn *conn, plcType *type);
 static int receive_udt(plcConn *conn, plcType *type, char **resdata);
 
@@ -75,15 +89,22 @@ static int send_result(plcConn *conn, plcMsgResult *res);
 static int send_log(plcConn *conn, plcMsgLog *mlog);
 static int send_exception(plcConn *conn, plcMsgError *err);
 static int send_sql(plcConn *conn, plcMsgSQL *msg);
+static int send_sql_content(plcConn *conn, plcMsgSQL *msg);
+static int send_function_stats(plcConn *conn, plcFunctionStats *stats);
+static int send_stats(plcConn *conn, plcMsgStats *msg);
+static int send_trace(plcConn *conn, plcMsgTrace *msg);
 
 static int receive_exception(plcConn *conn, plcMessage **mExc);
 static int receive_result(plcConn *conn, plcMessage **mRes);
 static int receive_log(plcConn *conn, plcMessage **mLog);
-static int receive_sql_statement(plcConn *conn, plcMessage **mStmt);
+static int receive_sql_statement(plcConn *conn, plcMessage **mStmt, int sqlType);
 static int receive_argument(plcConn *conn, plcArgument *arg);
 static int receive_ping(plcConn *conn, plcMessage **mPing);
 static int receive_call(plcConn *conn, plcMessage **mCall);
 static int receive_sql(plcConn *conn, plcMessage **mSql);
+static int receive_function_stats(plcConn *conn, plcFunctionStats *stats);
+static int receive_stats(plcConn *conn, plcMessage **mStats);
+static int receive_trace(plcConn *conn, plcMessage **mTrace);
 
 /* Public API Functions */
 
@@ -94,7 +115,9 @@ int plcontainer_channel_send(plcConn *conn, plcMessage *msg) {
             res = send_ping(conn);
             break;
         case MT_CALLREQ:
+            plc_trace_begin("send call");
             res = send_call(conn, (plcMsgCallreq*)msg);
+            plc_trace_end("send call");
             break;
         case MT_RESULT:
             res = send_result(conn, (plcMsgResult*)msg);
@@ -108,6 +131,12 @@ int plcontainer_channel_send(plcConn *conn, plcMessage *msg) {
         case MT_SQL:
             res = send_sql(conn, (plcMsgSQL*)msg);
             break;
+        case MT_STATS:
+            res = send_stats(conn, (plcMsgStats*)msg);
+            break;
+        case MT_TRACE:
+            res = send_trace(conn, (plcMsgTrace*)msg);
+            break;
         default:
             lprintf(ERROR, "UNHANDLED MESSAGE: '%c'", msg->msgtype);
             res = -1;
@@ -129,7 +158,10 @@ int plcontainer_channel_receive(plcConn *conn, plcMessage **msg) {
                 res = receive_ping(conn, msg);
                 break;
             case MT_CALLREQ:
+                /* Starts when the call request begins to arrive */
+                plc_trace_begin("receive call");
                 res = receive_call(conn, msg);
+                plc_trace_end("receive call");
                 break;
             case MT_RESULT:
                 res = receive_result(conn, msg);
@@ -143,6 +175,12 @@ int plcontainer_channel_receive(plcConn *conn, plcMessage **msg) {
             case MT_SQL:
                 res = receive_sql(conn, msg);
                 break;
+            case MT_STATS:
+                res = receive_stats(conn, msg);
+                break;
+            case MT_TRACE:
+                res = receive_trace(conn, msg);
+                break;
             default:
                 lprintf(ERROR, "message type unknown %d / '%c'", (int)cType, cType);
                 *msg = NULL;
@@ -163,45 +201,46 @@ static int message_end(plcConn *conn) {
     return plcBufferFlush(conn);
 }
 
+/*
+ * Finishes the message without sending it unless a lot of data is buffered.
+ * It is sent with the next message finished by message_end(), or before
+ * waiting for the data from the other side
+ */
+static int message_end_deferred(plcConn *conn) {
+    return plcBufferMaybeSend(conn);
+}
+
 static int send_char(plcConn *conn, char c) {
-    debug_print(WARNING, "    ===> sending int8/char '%d/%c'", (int)c, c);
     return plcBufferAppend(conn, &c, 1);
 }
 
 static int send_int16(plcConn *conn, short i) {
-    debug_print(WARNING, "    ===> sending int16 '%d'", (int)i);
     return plcBufferAppend(conn, (char*)&i, 2);
 }
 
 static int send_int32(plcConn *conn, int i) {
-    debug_print(WARNING, "    ===> sending int32 '%d'", i);
     return plcBufferAppend(conn, (char*)&i, 4);
 }
 
 static int send_uint32(plcConn *conn, unsigned int i) {
-    debug_print(WARNING, "    ===> sending uint32 '%u'", i);
     return plcBufferAppend(conn, (char*)&i, 4);
 }
 
 static int send_int64(plcConn *conn, long long i) {
-    debug_print(WARNING, "    ===> sending int64 '%lld'", i);
     return plcBufferAppend(conn, (char*)&i, 8);
 }
 
 static int send_float4(plcConn *conn, float f) {
-    debug_print(WARNING, "    ===> sending float4 '%f'", f);
     return plcBufferAppend(conn, (char*)&f, 4);
 }
 
 static int send_float8(plcConn *conn, double f) {
-    debug_print(WARNING, "    ===> sending float8 '%f'", f);
     return plcBufferAppend(conn, (char*)&f, 8);
 }
 
 static int send_cstring(plcConn *conn, char *s) {
     int res = 0;
 
-    debug_print(WARNING, "    ===> sending cstring '%s'", s);
     if (s == NULL) {
         res = send_int32(conn, -1);
     } else {
@@ -216,23 +255,51 @@ static int send_cstring(plcConn *conn, char *s) {
     return res;
 }
 
+/* Text values carry their length, so they are sent without strlen() */
+static int send_text(plcConn *conn, char *s) {
+    int res = 0;
+
+    res |= send_int32(conn, *((int*)s));
+    res |= plcBufferAppend(conn, s + 4, *((int*)s));
+    return res;
+}
+
 static int send_bytea(plcConn *conn, char *s) {
     int res = 0;
 
-    debug_print(WARNING, "    ===> sending bytea of size '%d'", *((int*)s));
     res |= send_int32(conn, *((int*)s));
     res |= plcBufferAppend(conn, s + 4, *((int*)s));
     return res;
 }
 
+/* Interval is sent as its format followed by the binary value, or by the
+ * text for interval passed as text */
+static int send_interval(plcConn *conn, plcInterval *iv) {
+    int res = 0;
+
+    res |= send_char(conn, iv->format);
+    if (iv->format != PLC_BINARY_FORMAT_TEXT) {
+        res |= send_int64(conn, iv->time);
+        res |= send_int32(conn, iv->day);
+        res |= send_int32(conn, iv->month);
+    }
+    return res;
+}
+
+/* Sends the text following the marker of date or time value passed as text */
+static int send_temporal_text(plcConn *conn, plcDatatype dt, char *value) {
+    if (!plc_is_temporal_text(dt, value)) {
+        return 0;
+    }
+    return send_text(conn, plc_temporal_text(dt, value));
+}
+
 static int send_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
     int res = 0;
     if (obj->isnull) {
         res |= send_char(conn, 'N');
-        debug_print(WARNING, "Object is null");
     } else {
         res |= send_char(conn, 'D');
-        debug_print(WARNING, "Object type is '%s' and value is:", plc_get_type_name(type->type));
         switch (type->type) {
             case PLC_DATA_INT1:
                 res |= send_char(conn, *((char*)obj->value));
@@ -253,11 +320,30 @@ static int send_raw_object(plcConn *conn, plcType *type, rawdata *obj) {
                 res |= send_float8(conn, *((double*)obj->value));
                 break;
             case PLC_DATA_TEXT:
-                res |= send_cstring(conn, obj->value);
+            case PLC_DATA_JSON:
+                res |= send_text(conn, obj->value);
                 break;
             case PLC_DATA_BYTEA:
+            case PLC_DATA_BINARY:
                 res |= send_bytea(conn, obj->value);
                 break;
+            case PLC_DATA_TIMESTAMP:
+            case PLC_DATA_TIMESTAMPTZ:
+            case PLC_DATA_TIME:
+                res |= send_int64(conn, *((long long*)obj->value));
+                res |= send_temporal_text(conn, type->type, obj->value);
+                break;
+            case PLC_DATA_DATE:
+                res |= send_int32(conn, *((int*)obj->value));
+                res |= send_temporal_text(conn, type->type, obj->value);
+                break;
+            case PLC_DATA_INTERVAL:
+                res |= send_interval(conn, (plcInterval*)obj->value);
+                res |= send_temporal_text(conn, type->type, obj->value);
+                break;
+            case PLC_DATA_UUID:
+                res |= plcBufferAppend(conn, obj->value, PLC_UUID_LEN);
+                break;
             case PLC_DATA_ARRAY:
                 res |= send_raw_array_iter(conn, &type->subTypes[0], (plcIterator*)obj->value);
                 break;
@@ -277,21 +363,29 @@ static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter)
     int res = 0;
     int i = 0;
     plcArrayMeta *meta = (plcArrayMeta*)iter->meta;
+    /* Text protocol has all the arrays sent element by element */
+    bool typed = (conn->version >= PLC_PROTOCOL_VERSION_TYPED);
     res |= send_int32(conn, meta->ndims);
 
     for (i = 0; i < meta->ndims; i++) {
         res |= send_int32(conn, meta->dims[i]);
     }
-    for (i = 0; i < meta->size && res == 0; i++) {
-        rawdata* raw_object = iter->next(iter);
-        res |= send_raw_object(conn, type, raw_object);
-        if (!raw_object->isnull) {
-            if (type->type == PLC_DATA_UDT) {
-                plc_free_udt((plcUDT*)raw_object->value, type, true);
+    if (typed && meta->size > 0 && plc_array_is_contiguous(type->type)) {
+        res |= send_contiguous_array(conn, iter);
+    } else if (typed && meta->size > 0 && plc_array_is_fixed_width(type->type)) {
+        res |= send_fixed_width_array(conn, iter);
+    } else {
+        for (i = 0; i < meta->size && res == 0; i++) {
+            rawdata* raw_object = iter->next(iter);
+            res |= send_raw_object(conn, type, raw_object);
+            if (!raw_object->isnull) {
+                if (type->type == PLC_DATA_UDT) {
+                    plc_free_udt((plcUDT*)raw_object->value, type, true);
+                }
+                pfree(raw_object->value);
             }
-            pfree(raw_object->value);
+            pfree(raw_object);
         }
-        pfree(raw_object);
     }
     if (iter->cleanup != NULL) {
     	iter->cleanup(iter);
@@ -299,20 +393,121 @@ static int send_raw_array_iter(plcConn *conn, plcType *type, plcIterator *iter)
     return res;
 }
 
+/*
+ * Text and bytea elements are sent as the null flags of all the elements,
+ * followed by size+1 offsets of the elements in the data blob and the blob
+ * itself, so that the receiver could read the whole array with three reads
+ * into the same layout plcArray uses in memory
+ */
+static int send_contiguous_array(plcConn *conn, plcIterator *iter) {
+    int       res = 0;
+    int       i = 0;
+    int       offset = 0;
+    int       size = iter->meta->size;
+    rawdata **elems;
+
+    elems = (rawdata**)pmalloc(size * sizeof(rawdata*));
+    for (i = 0; i < size; i++) {
+        elems[i] = iter->next(iter);
+        res |= send_char(conn, elems[i]->isnull ? 'N' : 'D');
+    }
+
+    res |= send_int32(conn, offset);
+    for (i = 0; i < size; i++) {
+        if (!elems[i]->isnull) {
+            offset += *((int*)elems[i]->value);
+        }
+        res |= send_int32(conn, offset);
+    }
+
+    for (i = 0; i < size; i++) {
+        if (!elems[i]->isnull) {
+            if (res == 0) {
+                res |= plcBufferAppend(conn, elems[i]->value + 4, *((int*)elems[i]->value));
+            }
+            pfree(elems[i]->value);
+        }
+        pfree(elems[i]);
+    }
+    pfree(elems);
+
+    return res;
+}
+
+/*
+ * Fixed-width elements are sent as the null flags of all the elements
+ * followed by the block of their values, with zeroes in place of nulls,
+ * and by the texts of date and time elements passed as text
+ */
+static int send_fixed_width_array(plcConn *conn, plcIterator *iter) {
+    int      res = 0;
+    int      i = 0;
+    int      size = iter->meta->size;
+    int      entrylen = plc_get_type_length(iter->meta->type);
+    char    *nulls;
+    char    *values;
+    char   **texts = NULL;
+    rawdata *raw_object;
+
+    nulls = (char*)pmalloc(size);
+    if (iter->values != NULL) {
+        memset(nulls, 'D', size);
+        res |= plcBufferAppend(conn, nulls, size);
+        res |= plcBufferAppend(conn, iter->values, size * entrylen);
+    } else {
+        values = (char*)pmalloc(size * entrylen);
+        memset(values, 0, size * entrylen);
+        for (i = 0; i < size; i++) {
+            raw_object = iter->next(iter);
+            if (raw_object->isnull) {
+                nulls[i] = 'N';
+            } else {
+                nulls[i] = 'D';
+                memcpy(values + i * entrylen, raw_object->value, entrylen);
+                if (plc_is_temporal_text(iter->meta->type, raw_object->value)) {
+                    if (texts == NULL) {
+                        texts = (char**)pmalloc(size * sizeof(char*));
+                        memset(texts, 0, size * sizeof(char*));
+                    }
+                    texts[i] = raw_object->value;
+                } else {
+                    pfree(raw_object->value);
+                }
+            }
+            pfree(raw_object);
+        }
+        res |= plcBufferAppend(conn, nulls, size);
+        res |= plcBufferAppend(conn, values, size * entrylen);
+        pfree(values);
+        if (texts != NULL) {
+            for (i = 0; i < size; i++) {
+                if (texts[i] != NULL) {
+                    res |= send_text(conn, plc_temporal_text(iter->meta->type, texts[i]));
+                    pfree(texts[i]);
+                }
+            }
+            pfree(texts);
+        }
+    }
+    pfree(nulls);
+
+    return res;
+}
+
 static int send_type(plcConn *conn, plcType *type) {
     int res = 0;
     int i = 0;
 
-    debug_print(WARNING, "VVVVVVVVVVVVVVV");
-    debug_print(WARNING, "    Type '%s' with name '%s'", plc_get_type_name(type->type), type->typeName);
     res |= send_char(conn, (char)type->type);
     res |= send_cstring(conn, type->typeName);
+    if (type->type == PLC_DATA_BINARY) {
+        res |= send_cstring(conn, type->pgTypeName);
+    }
     if (type->type == PLC_DATA_ARRAY || type->type == PLC_DATA_UDT) {
         res |= send_int16(conn, type->nSubTypes);
         for (i = 0; i < type->nSubTypes && res == 0; i++)
             res |= send_type(conn, &type->subTypes[i]);
     }
-    debug_print(WARNING, "///////////////");
 
     return res;
 }
@@ -321,8 +516,6 @@ static int send_udt(plcConn *conn, plcType *type, plcUDT *udt) {
     int res = 0;
     int i = 0;
 
-    debug_print(WARNING, "Sending user-defined type with %d members", type->nSubTypes);
-
     for (i = 0; i < type->nSubTypes && res == 0; i++) {
         res |= send_raw_object(conn, &type->subTypes[i], &udt->data[i]);
     }
@@ -340,49 +533,41 @@ static int receive_message_type(plcConn *conn, char *c) {
 
 static int receive_char(plcConn *conn, char *c) {
     int res = plcBufferRead(conn, c, 1);
-    debug_print(WARNING, "    <=== receiving int8/char '%d/%c'", (int)*c, *c);
     return res;
 }
 
 static int receive_int16(plcConn *conn, short *i) {
     int res = plcBufferRead(conn, (char*)i, 2);
-    debug_print(WARNING, "    <=== receiving int16 '%d'", (int)*i);
     return res;
 }
 
 static int receive_int32(plcConn *conn, int *i) {
     int res = plcBufferRead(conn, (char*)i, 4);
-    debug_print(WARNING, "    <=== receiving int32 '%d'", *i);
     return res;
 }
 
 static int receive_uint32(plcConn *conn, unsigned int *i) {
     int res = plcBufferRead(conn, (char*)i, 4);
-    debug_print(WARNING, "    <=== receiving uint32 '%u'", *i);
     return res;
 }
 
 static int receive_int64(plcConn *conn, long long *i) {
     int res = plcBufferRead(conn, (char*)i, 8);
-    debug_print(WARNING, "    <=== receiving int64 '%lld'", *i);
     return res;
 }
 
 static int receive_float4(plcConn *conn, float *f) {
     int res = plcBufferRead(conn, (char*)f, 4);
-    debug_print(WARNING, "    <=== receiving float4 '%f'", *f);
     return res;
 }
 
 static int receive_float8(plcConn *conn, double *f) {
     int res = plcBufferRead(conn, (char*)f, 8);
-    debug_print(WARNING, "    <=== receiving float8 '%f'", *f);
     return res;
 }
 
 static int receive_raw(plcConn *conn, char *s, size_t len) {
     int res = plcBufferRead(conn, s, len);
-    debug_print(WARNING, "    <=== receiving raw '%d' bytes", (int)len );
     return res;
 }
 
@@ -404,7 +589,31 @@ static int receive_cstring(plcConn *conn, char **s) {
         (*s)[cnt] = 0;
     }
 
-    debug_print(WARNING, "    <=== receiving cstring '%s'", *s);
+    return res;
+}
+
+/* Text is received as length followed by data and a terminating zero, so that
+ * it could be used both as a counted string and as a cstring */
+static int receive_text(plcConn *conn, char **s) {
+    int res = 0;
+    int len = 0;
+
+    *s = NULL;
+    if (receive_int32(conn, &len) < 0) {
+        return -1;
+    }
+    if (len < 0) {
+        lprintf(ERROR, "Received text with invalid length %d", len);
+        return -1;
+    }
+
+    *s = pmalloc(len + 5);
+    *((int*)*s) = len;
+    if (len > 0) {
+        res = plcBufferRead(conn, *s + 4, len);
+    }
+    (*s)[len + 4] = '\0';
+
     return res;
 }
 
@@ -415,19 +624,56 @@ static int receive_bytea(plcConn *conn, char **s) {
     if (receive_int32(conn, &len) < 0) {
         return -1;
     }
+    if (len < 0) {
+        lprintf(ERROR, "Received bytea with invalid length %d", len);
+        return -1;
+    }
 
     *s = pmalloc(len + 4);
-    debug_print(WARNING, "    ===> receiving bytea of size '%d' at %p for %p", len, *s, s);
 
     *((int*)*s) = len;
     if (len > 0) {
         res = plcBufferRead(conn, *s + 4, len);
     }
-    debug_print(WARNING, "    ===> receiving bytea '%s'", strndup(*s + 4, len));
 
     return res;
 }
 
+static int receive_interval(plcConn *conn, plcInterval *iv) {
+    int res = 0;
+
+    iv->time = 0;
+    iv->day = 0;
+    iv->month = 0;
+    res |= receive_char(conn, &iv->format);
+    if (res == 0 && iv->format == PLC_BINARY_FORMAT_BINARY) {
+        res |= receive_int64(conn, &iv->time);
+        res |= receive_int32(conn, &iv->day);
+        res |= receive_int32(conn, &iv->month);
+    } else if (res == 0 && iv->format != PLC_BINARY_FORMAT_TEXT) {
+        lprintf(ERROR, "Received interval in unknown format %d", (int)iv->format);
+        return -1;
+    }
+    return res;
+}
+
+/* Replaces the received marker of date or time value passed as text with
+ * the marker followed by the text, the way the sender had it in memory */
+static int receive_temporal_text(plcConn *conn, plcDatatype dt, char **value) {
+    char *text = NULL;
+
+    if (!plc_is_temporal_text(dt, *value)) {
+        return 0;
+    }
+    if (receive_text(conn, &text) < 0) {
+        return -1;
+    }
+    pfree(*value);
+    *value = plc_alloc_temporal_text(dt, text + 4, *((int*)text));
+    pfree(text);
+    return 0;
+}
+
 static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj)  {
     int res = 0;
     char isn;
@@ -438,10 +684,8 @@ static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj)  {
     if (isn == 'N') {
         obj->isnull = 1;
         obj->value  = NULL;
-        debug_print(WARNING, "Object is null");
     } else {
         obj->isnull = 0;
-        debug_print(WARNING, "Object value is:");
         switch (type->type) {
             case PLC_DATA_INT1:
                 obj->value = (char*)pmalloc(1);
@@ -468,11 +712,34 @@ static int receive_raw_object(plcConn *conn, plcType *type, rawdata *obj)  {
                 res |= receive_float8(conn, (double*)obj->value);
                 break;
             case PLC_DATA_TEXT:
-                res |= receive_cstring(conn, &obj->value);
+            case PLC_DATA_JSON:
+                res |= receive_text(conn, &obj->value);
                 break;
             case PLC_DATA_BYTEA:
+            case PLC_DATA_BINARY:
                 res |= receive_bytea(conn, &obj->value);
                 break;
+            case PLC_DATA_TIMESTAMP:
+            case PLC_DATA_TIMESTAMPTZ:
+            case PLC_DATA_TIME:
+                obj->value = (char*)pmalloc(8);
+                res |= receive_int64(conn, (long long*)obj->value);
+                res |= receive_temporal_text(conn, type->type, &obj->value);
+                break;
+            case PLC_DATA_DATE:
+                obj->value = (char*)pmalloc(4);
+                res |= receive_int32(conn, (int*)obj->value);
+                res |= receive_temporal_text(conn, type->type, &obj->value);
+                break;
+            case PLC_DATA_INTERVAL:
+                obj->value = (char*)pmalloc(sizeof(plcInterval));
+                res |= receive_interval(conn, (plcInterval*)obj->value);
+                res |= receive_temporal_text(conn, type->type, &obj->value);
+                break;
+            case PLC_DATA_UUID:
+                obj->value = (char*)pmalloc(PLC_UUID_LEN);
+                res |= receive_raw(conn, obj->value, PLC_UUID_LEN);
+                break;
             case PLC_DATA_ARRAY:
                 res |= receive_array(conn, &type->subTypes[0], obj);
                 break;
@@ -495,6 +762,8 @@ static int receive_array(plcConn *conn, plcType *type, rawdata *obj) {
     int entrylen = 0;
     char isnull;
     plcArray *arr;
+    /* Text protocol has all the arrays sent element by element */
+    bool typed = (conn->version >= PLC_PROTOCOL_VERSION_TYPED);
 
     res |= receive_int32(conn, &ndims);
     arr = plc_alloc_array(ndims);
@@ -505,7 +774,13 @@ static int receive_array(plcConn *conn, plcType *type, rawdata *obj) {
         res |= receive_int32(conn, &arr->meta->dims[i]);
         arr->meta->size *= arr->meta->dims[i];
     }
-    if (arr->meta->size > 0) {
+    if (typed && arr->meta->size > 0 && plc_array_is_contiguous(arr->meta->type)) {
+        res |= receive_contiguous_array(conn, arr);
+    } else if (typed && arr->meta->size > 0 && plc_array_is_fixed_width(arr->meta->type)) {
+        res |= receive_fixed_width_array(conn, arr);
+    } else if (arr->meta->size > 0 && plc_array_is_contiguous(arr->meta->type)) {
+        res |= receive_contiguous_array_elements(conn, arr);
+    } else if (arr->meta->size > 0) {
         entrylen = plc_get_type_length(arr->meta->type);
         arr->nulls = (char*)pmalloc(arr->meta->size * 1);
         arr->data = (char*)pmalloc(arr->meta->size * entrylen);
@@ -526,10 +801,16 @@ static int receive_array(plcConn *conn, plcType *type, rawdata *obj) {
                     case PLC_DATA_FLOAT8:
                         res |= receive_raw(conn, arr->data + i*entrylen, entrylen);
                         break;
-                    case PLC_DATA_TEXT:
-                        res |= receive_cstring(conn, &((char**)arr->data)[i]);
+                    case PLC_DATA_INTERVAL:
+                        res |= receive_interval(conn, (plcInterval*)(arr->data + i*entrylen));
+                        if (plc_is_temporal_text(arr->meta->type, arr->data + i*entrylen)) {
+                            res |= receive_array_text(conn, arr, i);
+                        }
                         break;
-                    case PLC_DATA_BYTEA:
+                    case PLC_DATA_JSON:
+                        res |= receive_text(conn, &((char**)arr->data)[i]);
+                        break;
+                    case PLC_DATA_BINARY:
                         res |= receive_bytea(conn, &((char**)arr->data)[i]);
                         break;
                     case PLC_DATA_UDT:
@@ -545,16 +826,126 @@ static int receive_array(plcConn *conn, plcType *type, rawdata *obj) {
     return res;
 }
 
+static int receive_contiguous_array(plcConn *conn, plcArray *arr) {
+    int res = 0;
+    int i = 0;
+    int size = arr->meta->size;
+
+    arr->nulls = (char*)pmalloc(size);
+    arr->offsets = (int*)pmalloc((size + 1) * sizeof(int));
+    res |= receive_raw(conn, arr->nulls, size);
+    res |= receive_raw(conn, (char*)arr->offsets, (size + 1) * sizeof(int));
+    if (res < 0) {
+        return res;
+    }
+
+    for (i = 0; i < size; i++) {
+        arr->nulls[i] = (arr->nulls[i] == 'N') ? 1 : 0;
+        if (arr->offsets[i + 1] < arr->offsets[i]) {
+            res = -1;
+        }
+    }
+    if (arr->offsets[0] != 0 || res < 0) {
+        lprintf(ERROR, "Received array with invalid element offsets");
+        return -1;
+    }
+
+    /* Allocate at least one byte to have a valid pointer for empty blobs */
+    arr->data = (char*)pmalloc(arr->offsets[size] + 1);
+    if (arr->offsets[size] > 0) {
+        res |= receive_raw(conn, arr->data, arr->offsets[size]);
+    }
+    return res;
+}
+
+/*
+ * Text and bytea elements sent one by one are collected into the same
+ * contiguous layout the typed protocol receives them in
+ */
+static int receive_contiguous_array_elements(plcConn *conn, plcArray *arr) {
+    int    res = 0;
+    int    i = 0;
+    int    size = arr->meta->size;
+    char   isnull;
+    char **elems;
+
+    arr->nulls = (char*)pmalloc(size);
+    arr->offsets = (int*)pmalloc((size + 1) * sizeof(int));
+    elems = (char**)pmalloc(size * sizeof(char*));
+    memset(elems, 0, size * sizeof(char*));
+
+    arr->offsets[0] = 0;
+    for (i = 0; i < size; i++) {
+        arr->nulls[i] = 1;
+        arr->offsets[i + 1] = arr->offsets[i];
+        if (res == 0) {
+            res |= receive_char(conn, &isnull);
+        }
+        if (res == 0 && isnull != 'N') {
+            arr->nulls[i] = 0;
+            res |= receive_bytea(conn, &elems[i]);
+        }
+        if (elems[i] != NULL) {
+            arr->offsets[i + 1] += *((int*)elems[i]);
+        }
+    }
+
+    /* Allocate at least one byte to have a valid pointer for empty blobs */
+    arr->data = (char*)pmalloc(arr->offsets[size] + 1);
+    for (i = 0; i < size; i++) {
+        if (elems[i] != NULL) {
+            memcpy(arr->data + arr->offsets[i], elems[i] + 4, *((int*)elems[i]));
+            pfree(elems[i]);
+        }
+    }
+    pfree(elems);
+
+    return res;
+}
+
+static int receive_fixed_width_array(plcConn *conn, plcArray *arr) {
+    int res = 0;
+    int i = 0;
+    int size = arr->meta->size;
+    int entrylen = plc_get_type_length(arr->meta->type);
+
+    arr->nulls = (char*)pmalloc(size);
+    arr->data = (char*)pmalloc(size * entrylen);
+    res |= receive_raw(conn, arr->nulls, size);
+    res |= receive_raw(conn, arr->data, size * entrylen);
+    for (i = 0; i < size; i++) {
+        arr->nulls[i] = (arr->nulls[i] == 'N') ? 1 : 0;
+    }
+    for (i = 0; i < size && res == 0; i++) {
+        if (!arr->nulls[i] && plc_is_temporal_text(arr->meta->type, arr->data + i * entrylen)) {
+            res |= receive_array_text(conn, arr, i);
+        }
+    }
+    return res;
+}
+
+/* Receives the text of array element passed as text into "texts" */
+static int receive_array_text(plcConn *conn, plcArray *arr, int i) {
+    if (arr->texts == NULL) {
+        arr->texts = (char**)pmalloc(arr->meta->size * sizeof(char*));
+        memset(arr->texts, 0, arr->meta->size * sizeof(char*));
+    }
+    return receive_text(conn, &arr->texts[i]);
+}
+
 static int receive_type(plcConn *conn, plcType *type) {
     int res = 0;
     int i = 0;
     char typ;
 
-    debug_print(WARNING, "VVVVVVVVVVVVVVV");
     res |= receive_char(conn, &typ);
     res |= receive_cstring(conn, &type->typeName);
     type->type = (int)typ;
-    debug_print(WARNING, "    Type '%s' with name '%s'", plc_get_type_name(type->type), type->typeName);
+
+    type->pgTypeName = NULL;
+    if (type->type == PLC_DATA_BINARY) {
+        res |= receive_cstring(conn, &type->pgTypeName);
+    }
 
     if (type->type == PLC_DATA_ARRAY || type->type == PLC_DATA_UDT) {
         res |= receive_int16(conn, &type->nSubTypes);
@@ -567,7 +958,6 @@ static int receive_type(plcConn *conn, plcType *type) {
         type->nSubTypes = 0;
         type->subTypes = NULL;
     }
-    debug_print(WARNING, "///////////////");
 
     return res;
 }
@@ -577,8 +967,6 @@ static int receive_udt(plcConn *conn, plcType *type, char **resdata) {
     int i = 0;
     plcUDT *udt;
 
-    debug_print(WARNING, "Receiving user-defined type with %d members", type->nSubTypes);
-
     udt = plc_alloc_udt(type->nSubTypes);
     for (i = 0; i < type->nSubTypes && res == 0; i++) {
         res |= receive_raw_object(conn, &type->subTypes[i], &udt->data[i]);
@@ -592,23 +980,29 @@ static int receive_udt(plcConn *conn, plcType *type, char **resdata) {
 
 static int send_argument(plcConn *conn, plcArgument *arg) {
     int res = 0;
-    debug_print(WARNING, "Sending argument '%s'", arg->name);
     res |= send_cstring(conn, arg->name);
-    debug_print(WARNING, "Argument type is '%s'", plc_get_type_name(arg->type.type));
     res |= send_type(conn, &arg->type);
     res |= send_raw_object(conn, &arg->type, &arg->data);
     return res;
 }
 
+/*
+ * Ping carries the protocol version of the connection, which is not sent for
+ * the text protocol the same way the first releases did not send it
+ */
 static int send_ping(plcConn *conn) {
     int res = 0;
-    char *ping = "ping";
+    char ping[32];
+
+    if (conn->version > PLC_PROTOCOL_VERSION_TEXT) {
+        snprintf(ping, sizeof(ping), "ping %d", conn->version);
+    } else {
+        snprintf(ping, sizeof(ping), "ping");
+    }
 
-    debug_print(WARNING, "Sending ping message");
     res |= message_start(conn, MT_PING);
     res |= send_cstring(conn, ping);
     res |= message_end(conn);
-    debug_print(WARNING, "Finished ping message");
     return res;
 }
 
@@ -616,28 +1010,23 @@ static int send_call(plcConn *conn, plcMsgCallreq *call) {
     int res = 0;
     int i;
 
-    debug_print(WARNING, "Sending call request for function '%s'", call->proc.name);
     res |= message_start(conn, MT_CALLREQ);
     res |= send_cstring(conn, call->proc.name);
-    debug_print(WARNING, "Function source code:");
-    debug_print(WARNING, "%s", call->proc.src);
     res |= send_cstring(conn, call->proc.src);
-    debug_print(WARNING, "Function OID is '%u'", call->objectid);
     res |= send_uint32(conn, call->objectid);
-    debug_print(WARNING, "Function has changed is '%d'", call->hasChanged);
     res |= send_int32(conn, call->hasChanged);
-    debug_print(WARNING, "Function return type is '%s'", plc_get_type_name(call->retType.type));
+    if (conn->version >= PLC_PROTOCOL_VERSION_TYPED) {
+        res |= send_int32(conn, call->logLevel);
+        res |= send_int32(conn, call->trace);
+    }
     res |= send_type(conn, &call->retType);
-    debug_print(WARNING, "Function is set-returning: %d", (int)call->retset);
     res |= send_int32(conn, call->retset);
-    debug_print(WARNING, "Function number of arguments is '%d'", call->nargs);
     res |= send_int32(conn, call->nargs);
 
     for (i = 0; i < call->nargs; i++)
         res |= send_argument(conn, &call->args[i]);
 
     res |= message_end(conn);
-    debug_print(WARNING, "Finished call request for function '%s'", call->proc.name);
     return res;
 }
 
@@ -647,22 +1036,18 @@ static int send_result(plcConn *conn, plcMsgResult *ret) {
     plcMsgError *msg = NULL;
 
     res |= message_start(conn, MT_RESULT);
-    debug_print(WARNING, "Sending result of %d rows and %d columns", ret->rows, ret->cols);
     res |= send_int32(conn, ret->rows);
     res |= send_int32(conn, ret->cols);
 
     /* send columns types and names */
-    debug_print(WARNING, "Sending types and names of %d columns", ret->cols);
     for (i = 0; i < ret->cols; i++) {
-        debug_print(WARNING, "Column '%s' with type '%d'", ret->names[i], (int)ret->types[i].type);
         res |= send_type(conn, &ret->types[i]);
         res |= send_cstring(conn, ret->names[i]);
     }
 
-    /* send rows */
-    for (i = 0; i < ret->rows; i++)
+    /* send rows, result without columns has no data */
+    for (i = 0; i < ret->rows && ret->cols > 0; i++)
         for (j = 0; j < ret->cols; j++) {
-            debug_print(WARNING, "Sending row %d column %d", i, j);
             res |= send_raw_object(conn, &ret->types[j], &ret->data[i][j]);
         }
 
@@ -679,21 +1064,25 @@ static int send_result(plcConn *conn, plcMsgResult *ret) {
 
     res |= message_end(conn);
 
-    debug_print(WARNING, "Finished sending function result");
-
     return res;
 }
 
 static int send_log(plcConn *conn, plcMsgLog *mlog) {
     int res = 0;
 
-    debug_print(WARNING, "Sending log message to backend");
     res |= message_start(conn, MT_LOG);
     res |= send_int32(conn, mlog->level);
     res |= send_cstring(conn, mlog->message);
 
-    res |= message_end(conn);
-    debug_print(WARNING, "Finished sending log message");
+    /*
+     * Log messages are coalesced with the messages following them, but the
+     * error is the last message the backend reads before it aborts the call
+     */
+    if (mlog->level >= ERROR) {
+        res |= message_end(conn);
+    } else {
+        res |= message_end_deferred(conn);
+    }
     return res;
 }
 
@@ -706,20 +1095,152 @@ static int send_exception(plcConn *conn, plcMsgError *err) {
     return res;
 }
 
-static int send_sql(plcConn *conn, plcMsgSQL *msg) {
+static int send_function_stats(plcConn *conn, plcFunctionStats *stats) {
     int res = 0;
-    if (msg->sqltype == SQL_TYPE_STATEMENT) {
-        res |= message_start(conn, MT_SQL);
-        res |= send_int32(conn, ((plcMsgSQL*)msg)->sqltype);
-        res |= send_cstring(conn, ((plcMsgSQL*)msg)->statement);
-        res |= message_end(conn);
-    } else {
-        lprintf(ERROR, "Unhandled SQL Message type '%c'", msg->sqltype);
-        res = -1;
+    int i;
+
+    res |= send_uint32(conn, stats->objectid);
+    res |= send_int64(conn, stats->calls);
+    res |= send_int64(conn, stats->argumentsTime);
+    res |= send_int64(conn, stats->executionTime);
+    res |= send_int64(conn, stats->resultsTime);
+    res |= send_int64(conn, stats->spiCalls);
+    res |= send_int64(conn, stats->spiTime);
+    for (i = 0; i < PLC_STATS_HISTOGRAM_BUCKETS; i++) {
+        res |= send_int64(conn, stats->histogram[i]);
     }
     return res;
 }
 
+static int send_stats(plcConn *conn, plcMsgStats *msg) {
+    int res = 0;
+    int i;
+
+    res |= message_start(conn, MT_STATS);
+    res |= send_int32(conn, msg->ncounters);
+    for (i = 0; i < msg->ncounters; i++) {
+        res |= send_cstring(conn, msg->names[i]);
+        res |= send_int64(conn, msg->values[i]);
+    }
+    res |= send_int32(conn, msg->nfunctions);
+    for (i = 0; i < msg->nfunctions; i++) {
+        res |= send_function_stats(conn, &msg->functions[i]);
+    }
+    res |= message_end(conn);
+    return res;
+}
+
+static int send_trace(plcConn *conn, plcMsgTrace *msg) {
+    int res = 0;
+    int i;
+
+    res |= message_start(conn, MT_TRACE);
+    res |= send_int32(conn, msg->nevents);
+    for (i = 0; i < msg->nevents; i++) {
+        res |= send_cstring(conn, msg->events[i].name);
+        res |= send_char(conn, msg->events[i].phase);
+        res |= send_int64(conn, msg->events[i].ts);
+    }
+    res |= message_end(conn);
+    return res;
+}
+
+/* Sends the content of SQL message, which might be a part of the batch */
+static int send_sql_content(plcConn *conn, plcMsgSQL *msg) {
+    int res = 0;
+    int i, j;
+
+    switch (msg->sqltype) {
+        case SQL_TYPE_STATEMENT:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_cstring(conn, msg->statement);
+            if (conn->version >= PLC_PROTOCOL_VERSION_TYPED) {
+                res |= send_int32(conn, msg->limit);
+            }
+            break;
+        case SQL_TYPE_PREPARE:
+        case SQL_TYPE_PREPARE_INSERT:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_cstring(conn, msg->statement);
+            res |= send_int32(conn, msg->nargs);
+            for (i = 0; i < msg->nargs; i++) {
+                res |= send_cstring(conn, msg->argtypes[i]);
+            }
+            break;
+        case SQL_TYPE_PEXECUTE:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_int32(conn, msg->planid);
+            res |= send_int32(conn, msg->limit);
+            res |= send_int32(conn, msg->nargs);
+            for (i = 0; i < msg->nargs; i++) {
+                res |= send_argument(conn, &msg->args[i]);
+            }
+            break;
+        case SQL_TYPE_UNPREPARE:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_int32(conn, msg->planid);
+            break;
+        case SQL_TYPE_CURSOR_OPEN:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_cstring(conn, msg->statement);
+            res |= send_int32(conn, msg->planid);
+            res |= send_int32(conn, msg->nargs);
+            for (i = 0; i < msg->nargs; i++) {
+                res |= send_argument(conn, &msg->args[i]);
+            }
+            break;
+        case SQL_TYPE_FETCH:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_int32(conn, msg->cursorid);
+            res |= send_int32(conn, msg->limit);
+            break;
+        case SQL_TYPE_CURSOR_CLOSE:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_int32(conn, msg->cursorid);
+            break;
+        case SQL_TYPE_SUBXACT_BEGIN:
+        case SQL_TYPE_SUBXACT_COMMIT:
+        case SQL_TYPE_SUBXACT_ROLLBACK:
+            res |= send_int32(conn, msg->sqltype);
+            break;
+        case SQL_TYPE_INSERT:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_int32(conn, msg->planid);
+            res |= send_int32(conn, msg->nargs);
+            res |= send_int32(conn, msg->nrows);
+            for (i = 0; i < msg->nargs; i++) {
+                res |= send_type(conn, &msg->types[i]);
+            }
+            for (i = 0; i < msg->nrows; i++) {
+                for (j = 0; j < msg->nargs; j++) {
+                    res |= send_raw_object(conn, &msg->types[j], &msg->rows[i][j]);
+                }
+            }
+            break;
+        case SQL_TYPE_BATCH:
+            res |= send_int32(conn, msg->sqltype);
+            res |= send_int32(conn, msg->nbatch);
+            for (i = 0; i < msg->nbatch; i++) {
+                res |= send_sql_content(conn, msg->batch[i]);
+            }
+            break;
+        default:
+            lprintf(ERROR, "Unhandled SQL Message type '%d'", (int)msg->sqltype);
+            res = -1;
+            break;
+    }
+    return res;
+}
+
+static int send_sql(plcConn *conn, plcMsgSQL *msg) {
+    int res = 0;
+
+    res |= message_start(conn, MT_SQL);
+    res |= send_sql_content(conn, msg);
+    res |= message_end(conn);
+    return res;
+}
+
 /* Receive Functions for the Main Engine */
 
 static int receive_exception(plcConn *conn, plcMessage **mExc) {
@@ -744,13 +1265,13 @@ static int receive_result(plcConn *conn, plcMessage **mRes) {
     *mRes = pmalloc(sizeof(plcMsgResult));
     ret = (plcMsgResult*) *mRes;
     ret->msgtype = MT_RESULT;
+    ret->sharedTypes = 0;
     res |= receive_int32(conn, &ret->rows);
     res |= receive_int32(conn, &ret->cols);
-    debug_print(WARNING, "Receiving function result of %d rows and %d columns",
-            ret->rows, ret->cols);
 
     if (res == 0) {
-        if (ret->rows > 0) {
+        /* Result without columns only has the number of processed rows */
+        if (ret->rows > 0 && ret->cols > 0) {
             ret->data = pmalloc((ret->rows) * sizeof(rawdata*));
         } else {
             ret->data  = NULL;
@@ -758,21 +1279,18 @@ static int receive_result(plcConn *conn, plcMessage **mRes) {
         }
 
         /* Read column names and column types of result set */
-        debug_print(WARNING, "Receiving types and names of %d columns", ret->cols);
         ret->types = pmalloc(ret->cols * sizeof(plcType));
         ret->names = pmalloc(ret->cols * sizeof(*ret->names));
         for (i = 0; i < ret->cols; i++) {
              res |= receive_type(conn, &ret->types[i]);
              res |= receive_cstring(conn, &ret->names[i]);
-             debug_print(WARNING, "Column '%s' with type '%d'", ret->names[i], (int)ret->types[i].type);
         }
 
         /* Receive data */
-        for (i = 0; i < ret->rows && res == 0; i++) {
+        for (i = 0; i < ret->rows && ret->data != NULL && res == 0; i++) {
             if (ret->cols > 0) {
                 ret->data[i] = pmalloc((ret->cols) * sizeof(*ret->data[i]));
                 for (j = 0; j < ret->cols; j++) {
-                    debug_print(WARNING, "Receiving row %d column %d", i, j);
                     res |= receive_raw_object(conn, &ret->types[j], &ret->data[i][j]);
                 }
             } else {
@@ -787,7 +1305,6 @@ static int receive_result(plcConn *conn, plcMessage **mRes) {
         free_result(ret, false);
     }
 
-    debug_print(WARNING, "Finished receiving function result");
     return res;
 }
 
@@ -795,35 +1312,211 @@ static int receive_log(plcConn *conn, plcMessage **mLog) {
     int res = 0;
     plcMsgLog *ret;
 
-    debug_print(WARNING, "Receiving log message from client");
     *mLog = pmalloc(sizeof(plcMsgLog));
     ret   = (plcMsgLog*) *mLog;
     ret->msgtype = MT_LOG;
     res |= receive_int32(conn, &ret->level);
     res |= receive_cstring(conn, &ret->message);
 
-    debug_print(WARNING, "Finished receiving log message");
     return res;
 }
 
-static int receive_sql_statement(plcConn *conn, plcMessage **mStmt) {
+static int receive_function_stats(plcConn *conn, plcFunctionStats *stats) {
+    int res = 0;
+    int i;
+
+    res |= receive_uint32(conn, &stats->objectid);
+    res |= receive_int64(conn, &stats->calls);
+    res |= receive_int64(conn, &stats->argumentsTime);
+    res |= receive_int64(conn, &stats->executionTime);
+    res |= receive_int64(conn, &stats->resultsTime);
+    res |= receive_int64(conn, &stats->spiCalls);
+    res |= receive_int64(conn, &stats->spiTime);
+    for (i = 0; i < PLC_STATS_HISTOGRAM_BUCKETS; i++) {
+        res |= receive_int64(conn, &stats->histogram[i]);
+    }
+    return res;
+}
+
+static int receive_stats(plcConn *conn, plcMessage **mStats) {
+    int res = 0;
+    int i;
+    plcMsgStats *ret;
+
+    *mStats = pmalloc(sizeof(plcMsgStats));
+    ret = (plcMsgStats*) *mStats;
+    ret->msgtype = MT_STATS;
+    ret->names = NULL;
+    ret->values = NULL;
+    ret->functions = NULL;
+    res |= receive_int32(conn, &ret->ncounters);
+    if (res == 0 && ret->ncounters > 0) {
+        ret->names = pmalloc(ret->ncounters * sizeof(char*));
+        ret->values = pmalloc(ret->ncounters * sizeof(long long));
+        for (i = 0; i < ret->ncounters; i++) {
+            ret->names[i] = NULL;
+            res |= receive_cstring(conn, &ret->names[i]);
+            res |= receive_int64(conn, &ret->values[i]);
+        }
+    } else {
+        ret->ncounters = 0;
+    }
+    res |= receive_int32(conn, &ret->nfunctions);
+    if (res == 0 && ret->nfunctions > 0) {
+        ret->functions = pmalloc(ret->nfunctions * sizeof(plcFunctionStats));
+        for (i = 0; i < ret->nfunctions; i++) {
+            res |= receive_function_stats(conn, &ret->functions[i]);
+        }
+    } else {
+        ret->nfunctions = 0;
+    }
+
+    return res;
+}
+
+static int receive_trace(plcConn *conn, plcMessage **mTrace) {
+    int res = 0;
+    int i;
+    plcMsgTrace *ret;
+
+    *mTrace = pmalloc(sizeof(plcMsgTrace));
+    ret = (plcMsgTrace*) *mTrace;
+    ret->msgtype = MT_TRACE;
+    ret->events = NULL;
+    res |= receive_int32(conn, &ret->nevents);
+    if (res == 0 && ret->nevents > 0) {
+        ret->events = pmalloc(ret->nevents * sizeof(plcTraceEvent));
+        for (i = 0; i < ret->nevents; i++) {
+            ret->events[i].name = NULL;
+            res |= receive_cstring(conn, &ret->events[i].name);
+            res |= receive_char(conn, &ret->events[i].phase);
+            res |= receive_int64(conn, &ret->events[i].ts);
+        }
+    } else {
+        ret->nevents = 0;
+    }
+    return res;
+}
+
+static int receive_sql_statement(plcConn *conn, plcMessage **mStmt, int sqlType) {
     int res = 0;
+    int i, j;
     plcMsgSQL *ret;
 
-    *mStmt       = pmalloc(sizeof(plcMsgSQL));
-    ret          = (plcMsgSQL*) *mStmt;
-    ret->msgtype = MT_SQL;
-    ret->sqltype = SQL_TYPE_STATEMENT;
-    res = receive_cstring(conn, &ret->statement);
+    *mStmt         = pmalloc(sizeof(plcMsgSQL));
+    ret            = (plcMsgSQL*) *mStmt;
+    ret->msgtype   = MT_SQL;
+    ret->sqltype   = sqlType;
+    ret->statement = NULL;
+    ret->planid    = 0;
+    ret->cursorid  = 0;
+    ret->limit     = 0;
+    ret->nargs     = 0;
+    ret->argtypes  = NULL;
+    ret->args      = NULL;
+    ret->nrows     = 0;
+    ret->types     = NULL;
+    ret->rows      = NULL;
+    ret->nbatch    = 0;
+    ret->batch     = NULL;
+
+    switch (sqlType) {
+        case SQL_TYPE_STATEMENT:
+            res |= receive_cstring(conn, &ret->statement);
+            if (conn->version >= PLC_PROTOCOL_VERSION_TYPED) {
+                res |= receive_int32(conn, &ret->limit);
+            }
+            break;
+        case SQL_TYPE_PREPARE:
+        case SQL_TYPE_PREPARE_INSERT:
+            res |= receive_cstring(conn, &ret->statement);
+            res |= receive_int32(conn, &ret->nargs);
+            if (res == 0) {
+                ret->argtypes = pmalloc((ret->nargs + 1) * sizeof(char*));
+                for (i = 0; i < ret->nargs; i++) {
+                    ret->argtypes[i] = NULL;
+                }
+                for (i = 0; i < ret->nargs && res == 0; i++) {
+                    res |= receive_cstring(conn, &ret->argtypes[i]);
+                }
+            }
+            break;
+        case SQL_TYPE_PEXECUTE:
+        case SQL_TYPE_CURSOR_OPEN:
+            if (sqlType == SQL_TYPE_PEXECUTE) {
+                res |= receive_int32(conn, &ret->planid);
+                res |= receive_int32(conn, &ret->limit);
+            } else {
+                res |= receive_cstring(conn, &ret->statement);
+                res |= receive_int32(conn, &ret->planid);
+            }
+            res |= receive_int32(conn, &ret->nargs);
+            if (res == 0) {
+                ret->args = pmalloc((ret->nargs + 1) * sizeof(*ret->args));
+                for (i = 0; i < ret->nargs && res == 0; i++) {
+                    res |= receive_argument(conn, &ret->args[i]);
+                }
+            }
+            break;
+        case SQL_TYPE_UNPREPARE:
+            res |= receive_int32(conn, &ret->planid);
+            break;
+        case SQL_TYPE_FETCH:
+            res |= receive_int32(conn, &ret->cursorid);
+            res |= receive_int32(conn, &ret->limit);
+            break;
+        case SQL_TYPE_CURSOR_CLOSE:
+            res |= receive_int32(conn, &ret->cursorid);
+            break;
+        case SQL_TYPE_INSERT:
+            res |= receive_int32(conn, &ret->planid);
+            res |= receive_int32(conn, &ret->nargs);
+            res |= receive_int32(conn, &ret->nrows);
+            if (res == 0) {
+                ret->types = pmalloc((ret->nargs + 1) * sizeof(plcType));
+                for (i = 0; i < ret->nargs && res == 0; i++) {
+                    res |= receive_type(conn, &ret->types[i]);
+                }
+            }
+            if (res == 0) {
+                ret->rows = pmalloc((ret->nrows + 1) * sizeof(rawdata*));
+                for (i = 0; i < ret->nrows; i++) {
+                    ret->rows[i] = NULL;
+                }
+                for (i = 0; i < ret->nrows && res == 0; i++) {
+                    ret->rows[i] = pmalloc((ret->nargs + 1) * sizeof(rawdata));
+                    for (j = 0; j < ret->nargs; j++) {
+                        ret->rows[i][j].isnull = 1;
+                        ret->rows[i][j].value = NULL;
+                    }
+                    for (j = 0; j < ret->nargs && res == 0; j++) {
+                        res |= receive_raw_object(conn, &ret->types[j], &ret->rows[i][j]);
+                    }
+                }
+            }
+            break;
+        case SQL_TYPE_BATCH:
+            res |= receive_int32(conn, &ret->nbatch);
+            if (res == 0) {
+                ret->batch = pmalloc(ret->nbatch * sizeof(plcMsgSQL*));
+                for (i = 0; i < ret->nbatch; i++) {
+                    ret->batch[i] = NULL;
+                }
+                for (i = 0; i < ret->nbatch && res == 0; i++) {
+                    res |= receive_sql(conn, (plcMessage**)&ret->batch[i]);
+                }
+            }
+            break;
+        default:
+            break;
+    }
     return res;
 }
 
 static int receive_argument(plcConn *conn, plcArgument *arg) {
     int res = 0;
     res |= receive_cstring(conn, &arg->name);
-    debug_print(WARNING, "Receiving argument '%s'", arg->name);
     res |= receive_type(conn, &arg->type);
-    debug_print(WARNING, "Argument type is '%s'", plc_get_type_name(arg->type.type));
     res |= receive_raw_object(conn, &arg->type, &arg->data);
     return res;
 }
@@ -835,17 +1528,22 @@ static int receive_ping(plcConn *conn, plcMessage **mPing) {
     *mPing = (plcMessage*)pmalloc(sizeof(plcMsgPing));
     ((plcMsgPing*)*mPing)->msgtype = MT_PING;
 
-    debug_print(WARNING, "Receiving ping message");
     res |= receive_cstring(conn, &ping);
     if (res == 0) {
         if (strncmp(ping, "ping", 4) != 0) {
-            debug_print(WARNING, "Ping message receive failed");
+            res = -1;
+        } else if (ping[4] == ' ' && atoi(ping + 5) < conn->version) {
+            conn->version = atoi(ping + 5);
+        } else if (ping[4] == '\0') {
+            conn->version = PLC_PROTOCOL_VERSION_TEXT;
+        }
+        if (conn->version < PLC_PROTOCOL_VERSION_TEXT) {
+            lprintf(ERROR, "Received ping of unknown protocol version '%s'", ping);
             res = -1;
         }
         pfree(ping);
     }
 
-    debug_print(WARNING, "Finished receiving ping message");
     return res;
 }
 
@@ -858,26 +1556,24 @@ static int receive_call(plcConn *conn, plcMessage **mCall) {
     req            = (plcMsgCallreq*) *mCall;
     req->msgtype   = MT_CALLREQ;
     res |= receive_cstring(conn, &req->proc.name);
-    debug_print(WARNING, "Receiving call request for function '%s'", req->proc.name);
     res |= receive_cstring(conn, &req->proc.src);
-    debug_print(WARNING, "Function source code:");
-    debug_print(WARNING, "%s", req->proc.src);
     res |= receive_uint32(conn, &req->objectid);
-    debug_print(WARNING, "Function OID is '%u'", req->objectid);
     res |= receive_int32(conn, &req->hasChanged);
-    debug_print(WARNING, "Function has changed is '%d'", req->hasChanged);
+    /* Backend of the text protocol gets all the messages and no trace */
+    req->logLevel = 0;
+    req->trace = 0;
+    if (conn->version >= PLC_PROTOCOL_VERSION_TYPED) {
+        res |= receive_int32(conn, &req->logLevel);
+        res |= receive_int32(conn, &req->trace);
+    }
     res |= receive_type(conn, &req->retType);
-    debug_print(WARNING, "Function return type is '%s'", plc_get_type_name(req->retType.type));
     res |= receive_int32(conn, &req->retset);
-    debug_print(WARNING, "Function is set-returning: %d", (int)req->retset);
     res |= receive_int32(conn, &req->nargs);
-    debug_print(WARNING, "Function number of arguments is '%d'", req->nargs);
     if (res == 0) {
         req->args = pmalloc(sizeof(*req->args) * req->nargs);
         for (i = 0; i < req->nargs && res == 0; i++)
             res |= receive_argument(conn, &req->args[i]);
     }
-    debug_print(WARNING, "Finished call request for function '%s'", req->proc.name);
     return res;
 }
 
@@ -889,7 +1585,19 @@ static int receive_sql(plcConn *conn, plcMessage **mSql) {
     if (res == 0) {
         switch (sqlType) {
             case SQL_TYPE_STATEMENT:
-                res = receive_sql_statement(conn, mSql);
+            case SQL_TYPE_PREPARE:
+            case SQL_TYPE_PEXECUTE:
+            case SQL_TYPE_UNPREPARE:
+            case SQL_TYPE_CURSOR_OPEN:
+            case SQL_TYPE_FETCH:
+            case SQL_TYPE_CURSOR_CLOSE:
+            case SQL_TYPE_SUBXACT_BEGIN:
+            case SQL_TYPE_SUBXACT_COMMIT:
+            case SQL_TYPE_SUBXACT_ROLLBACK:
+            case SQL_TYPE_PREPARE_INSERT:
+            case SQL_TYPE_INSERT:
+            case SQL_TYPE_BATCH:
+                res = receive_sql_statement(conn, mSql, sqlType);
                 break;
             default:
                 res = -1;
@@ -21,6 +21,16 @@
 #include "comm_utils.h"
 #include "comm_connectivity.h"
 
+/*
+ * The backend speaks the typed protocol, while the clients built from this
+ * code announce it only if they handle all the types it passes
+ */
+#ifndef COMM_STANDALONE
+int plc_protocol_version = PLC_PROTOCOL_VERSION_TYPED;
+#else
+int plc_protocol_version = PLC_PROTOCOL_VERSION_TEXT;
+#endif
+
 static ssize_t plcSocketRecv(plcConn *conn, void *ptr, size_t len);
 static ssize_t plcSocketSend(plcConn *conn, const void *ptr, size_t len);
 static int plcBufferMaybeFlush (plcConn *conn, bool isForse);
@@ -35,6 +45,9 @@ static ssize_t plcSocketRecv(plcConn *conn, void *ptr, size_t len) {
 
     while (sz <= 0) {
         sz = recv(conn->sock, ptr, len, 0);
+        if (sz > 0) {
+            conn->bytesReceived += sz;
+        }
 
         /* If receive command is terminated by SIGINT */
         if (sz < 0 && errno == EINTR) {
@@ -56,6 +69,10 @@ static ssize_t plcSocketRecv(plcConn *conn, void *ptr, size_t len) {
 static ssize_t plcSocketSend(plcConn *conn, const void *ptr, size_t len) {
     ssize_t sz = send(conn->sock, ptr, len, 0);
 
+    if (sz > 0) {
+        conn->bytesSent += sz;
+    }
+
     /* If receive command is terminated by SIGINT */
     if (sz < 0 && errno == EINTR) {
         lprintf(ERROR, "Query and PL/Container connections are terminated by user request");
@@ -288,6 +305,13 @@ int plcBufferReceive (plcConn *conn, size_t nBytes) {
         if (res < 0)
             return res;
 
+        // The other side might wait for the deferred messages to answer
+        if (conn->buffer[PLC_OUTPUT_BUFFER]->pStart < conn->buffer[PLC_OUTPUT_BUFFER]->pEnd) {
+            res = plcBufferFlush(conn);
+            if (res < 0)
+                return res;
+        }
+
         // When we sure we have enough space - receive the related data
         nBytesToReceive = (int)nBytes - (buf->pEnd - buf->pStart);
         while (nBytesToReceive > 0) {
@@ -315,6 +339,16 @@ int plcBufferFlush (plcConn *conn) {
     return plcBufferMaybeFlush(conn, true);
 }
 
+/*
+ * Function flushes the buffer only if it holds much data, leaving small
+ * messages to be sent together with the following ones
+ *
+ * Returns 0 on success, -1 if failed
+ */
+int plcBufferMaybeSend (plcConn *conn) {
+    return plcBufferMaybeFlush(conn, false);
+}
+
 /*
  *  Initialize plcConn data structure and input/output buffers
  */
@@ -338,6 +372,9 @@ plcConn * plcConnInit(int sock) {
 
     // Initializing control parameters
     conn->sock = sock;
+    conn->bytesSent = 0;
+    conn->bytesReceived = 0;
+    conn->version = plc_protocol_version;
 
     return conn;
 }
@@ -15,6 +15,18 @@
 #define PLC_INPUT_BUFFER 0
 #define PLC_OUTPUT_BUFFER 1
 
+/*
+ * Versions of the protocol. Clients of the text protocol know only the types
+ * of the first releases, get all the other types as text and send arrays
+ * element by element. The version of the connection is the lowest of the
+ * versions both sides announce with the ping message
+ */
+#define PLC_PROTOCOL_VERSION_TEXT  1
+#define PLC_PROTOCOL_VERSION_TYPED 2
+
+/* Version this side of the connection supports */
+extern int plc_protocol_version;
+
 typedef struct plcBuffer {
     char *data;
     int   pStart;
@@ -25,6 +37,9 @@ typedef struct plcBuffer {
 typedef struct plcConn {
     int sock;
     plcBuffer* buffer[2];
+    long long bytesSent;
+    long long bytesReceived;
+    int version;
 } plcConn;
 
 plcConn * plcConnect(int port);
@@ -35,5 +50,6 @@ int plcBufferAppend (plcConn *conn, char *prt, size_t len);
 int plcBufferRead (plcConn *conn, char *resBuffer, size_t len);
 int plcBufferReceive (plcConn *conn, size_t nBytes);
 int plcBufferFlush (plcConn *conn);
+int plcBufferMaybeSend (plcConn *conn);
 
 #endif /* PLC_COMM_CONNECTIVITY_H */
@@ -27,15 +27,19 @@ interpreted as representing official policies, either expressed or implied, of t
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "comm_utils.h"
 #include "messages/messages.h"
 
 /* Recursive function to free up the type structure */
-static void free_type(plcType *typArr) {
+void free_type(plcType *typArr) {
     if (typArr->typeName != NULL) {
         pfree(typArr->typeName);
     }
+    if (typArr->type == PLC_DATA_BINARY && typArr->pgTypeName != NULL) {
+        pfree(typArr->pgTypeName);
+    }
     if (typArr->nSubTypes > 0) {
         int i = 0;
         for (i = 0; i < typArr->nSubTypes; i++) {
@@ -45,37 +49,73 @@ static void free_type(plcType *typArr) {
     }
 }
 
-void free_callreq(plcMsgCallreq *req, bool isShared, bool isSender) {
+/* Frees the arguments of call request or SQL message */
+static void free_arguments(plcArgument *args, int nargs, bool isShared, bool isSender) {
     int i;
 
-    if (!isShared) {
-        /* free the procedure */
-        pfree(req->proc.name);
-        pfree(req->proc.src);
-    }
-
-    /* free the arguments */
-    for (i = 0; i < req->nargs; i++) {
-        if (!isShared && req->args[i].name != NULL) {
-            pfree(req->args[i].name);
+    for (i = 0; i < nargs; i++) {
+        if (!isShared && args[i].name != NULL) {
+            pfree(args[i].name);
         }
-        if (req->args[i].data.value != NULL) {
+        if (args[i].data.value != NULL) {
             // For UDT we need to free up internal structures
-            if (req->args[i].type.type == PLC_DATA_UDT) {
-                plc_free_udt((plcUDT*)req->args[i].data.value, &req->args[i].type, isSender);
+            if (args[i].type.type == PLC_DATA_UDT) {
+                plc_free_udt((plcUDT*)args[i].data.value, &args[i].type, isSender);
             }
 
             /* For arrays on receiver side we need to free up their data,
              * while on the sender side cleanup is managed by comm_channel */
-            if (!isSender && req->args[i].type.type == PLC_DATA_ARRAY) {
-                plc_free_array((plcArray*)req->args[i].data.value, &req->args[i].type, isSender);
+            if (!isSender && args[i].type.type == PLC_DATA_ARRAY) {
+                plc_free_array((plcArray*)args[i].data.value, &args[i].type, isSender);
             } else {
-                pfree(req->args[i].data.value);
+                pfree(args[i].data.value);
             }
         }
-        free_type(&req->args[i].type);
+        free_type(&args[i].type);
     }
-    pfree(req->args);
+    pfree(args);
+}
+
+/* Frees the rows of result or SQL message */
+static void free_rows(rawdata **data, int rows, int cols, plcType *types, bool isSender) {
+    int i, j;
+
+    for (i = 0; i < rows; i++) {
+        /* this can happen if for some reason we abort sending the result early */
+        if (data[i] != NULL){
+            for (j = 0; j < cols; j++) {
+                /* free the data if it is not null */
+                if (data[i][j].value != NULL) {
+                    // For UDT we need to free up internal structures
+                    if (types[j].type == PLC_DATA_UDT) {
+                        plc_free_udt((plcUDT*)data[i][j].value, &types[j], isSender);
+                    }
+
+                    /* For arrays on receiver side we need to free up their data,
+                     * while on the sender side cleanup is managed by comm_channel */
+                    if (!isSender && types[j].type == PLC_DATA_ARRAY) {
+                        plc_free_array((plcArray*)data[i][j].value, &types[j], isSender);
+                    } else {
+                        pfree(data[i][j].value);
+                    }
+                }
+            }
+            /* free the row */
+            pfree(data[i]);
+        }
+    }
+    pfree(data);
+}
+
+void free_callreq(plcMsgCallreq *req, bool isShared, bool isSender) {
+    if (!isShared) {
+        /* free the procedure */
+        pfree(req->proc.name);
+        pfree(req->proc.src);
+    }
+
+    /* free the arguments */
+    free_arguments(req->args, req->nargs, isShared, isSender);
 
     free_type(&req->retType);
 
@@ -83,36 +123,51 @@ void free_callreq(plcMsgCallreq *req, bool isShared, bool isSender) {
     pfree(req);
 }
 
-void free_result(plcMsgResult *res, bool isSender) {
-    int i, j;
+void free_sql(plcMsgSQL *msg, bool isShared, bool isSender) {
+    int i;
 
-    /* free the data array */
-    if (res->data != NULL) {
-        for (i = 0; i < res->rows; i++) {
-            /* this can happen if for some reason we abort sending the result early */
-            if (res->data[i] != NULL){
-                for (j = 0; j < res->cols; j++) {
-                    /* free the data if it is not null */
-                    if (res->data[i][j].value != NULL) {
-                        // For UDT we need to free up internal structures
-                        if (res->types[j].type == PLC_DATA_UDT) {
-                            plc_free_udt((plcUDT*)res->data[i][j].value, &res->types[j], isSender);
-                        }
-
-                        /* For arrays on receiver side we need to free up their data,
-                         * while on the sender side cleanup is managed by comm_channel */
-                        if (!isSender && res->types[j].type == PLC_DATA_ARRAY) {
-                            plc_free_array((plcArray*)res->data[i][j].value, &res->types[j], isSender);
-                        } else {
-                            pfree(res->data[i][j].value);
-                        }
-                    }
+    if (!isShared && msg->statement != NULL) {
+        pfree(msg->statement);
+    }
+    if (msg->argtypes != NULL) {
+        if (!isShared) {
+            for (i = 0; i < msg->nargs; i++) {
+                if (msg->argtypes[i] != NULL) {
+                    pfree(msg->argtypes[i]);
                 }
-                /* free the row */
-                pfree(res->data[i]);
             }
         }
-        pfree(res->data);
+        pfree(msg->argtypes);
+    }
+    if (msg->args != NULL) {
+        free_arguments(msg->args, msg->nargs, isShared, isSender);
+    }
+    if (msg->rows != NULL) {
+        free_rows(msg->rows, msg->nrows, msg->nargs, msg->types, isSender);
+    }
+    if (msg->types != NULL) {
+        for (i = 0; i < msg->nargs; i++) {
+            free_type(&msg->types[i]);
+        }
+        pfree(msg->types);
+    }
+    if (msg->batch != NULL) {
+        for (i = 0; i < msg->nbatch; i++) {
+            if (msg->batch[i] != NULL) {
+                free_sql(msg->batch[i], isShared, isSender);
+            }
+        }
+        pfree(msg->batch);
+    }
+    pfree(msg);
+}
+
+void free_result(plcMsgResult *res, bool isSender) {
+    int i;
+
+    /* free the data array */
+    if (res->data != NULL) {
+        free_rows(res->data, res->rows, res->cols, res->types, isSender);
     }
 
     /* free the types and names arrays */
@@ -120,9 +175,13 @@ void free_result(plcMsgResult *res, bool isSender) {
         if (res->names[i] != NULL) {
             pfree(res->names[i]);
         }
-        free_type(&res->types[i]);
+        if (!res->sharedTypes) {
+            free_type(&res->types[i]);
+        }
+    }
+    if (!res->sharedTypes) {
+        pfree(res->types);
     }
-    pfree(res->types);
     pfree(res->names);
 
     pfree(res);
@@ -149,13 +208,28 @@ plcArray *plc_alloc_array(int ndims) {
     if (ndims > 0)
         arr->meta->dims = (int*)pmalloc(ndims * sizeof(int));
     arr->meta->size = 0;
+    arr->data    = NULL;
+    arr->nulls   = NULL;
+    arr->offsets = NULL;
+    arr->texts   = NULL;
     return arr;
 }
 
 void plc_free_array(plcArray *arr, plcType *type, bool isSender) {
     int i;
     if (arr != NULL) {
-        if (arr->meta->type == PLC_DATA_TEXT || arr->meta->type == PLC_DATA_BYTEA) {
+        if (arr->texts != NULL) {
+            for (i = 0; i < arr->meta->size; i++) {
+                if (arr->texts[i] != NULL) {
+                    pfree(arr->texts[i]);
+                }
+            }
+            pfree(arr->texts);
+        }
+        if (arr->offsets != NULL) {
+            pfree(arr->offsets);
+        } else if (arr->meta->type == PLC_DATA_TEXT || arr->meta->type == PLC_DATA_BYTEA
+                || arr->meta->type == PLC_DATA_JSON || arr->meta->type == PLC_DATA_BINARY) {
             for (i = 0; i < arr->meta->size; i++) {
                 if ( ((char**)arr->data)[i] != NULL ) {
                     pfree(((char**)arr->data)[i]);
@@ -170,8 +244,10 @@ void plc_free_array(plcArray *arr, plcType *type, bool isSender) {
                 }
             }
         }
-        if (arr->meta->size > 0) {
+        if (arr->data != NULL) {
             pfree(arr->data);
+        }
+        if (arr->nulls != NULL) {
             pfree(arr->nulls);
         }
         if (arr->meta->ndims > 0) {
@@ -182,6 +258,18 @@ void plc_free_array(plcArray *arr, plcType *type, bool isSender) {
     }
 }
 
+/* Allocates text value: length, the data itself and a terminating zero */
+char *plc_alloc_text(const char *data, int len) {
+    char *res;
+
+    res = pmalloc(len + 5);
+    *((int*)res) = len;
+    memcpy(res + 4, data, len);
+    res[len + 4] = '\0';
+
+    return res;
+}
+
 plcUDT *plc_alloc_udt(int nargs) {
     plcUDT *res;
 
@@ -228,9 +316,25 @@ int plc_get_type_length(plcDatatype dt) {
         case PLC_DATA_FLOAT8:
             res = 8;
             break;
+        case PLC_DATA_TIMESTAMP:
+        case PLC_DATA_TIMESTAMPTZ:
+        case PLC_DATA_TIME:
+            res = 8;
+            break;
+        case PLC_DATA_DATE:
+            res = 4;
+            break;
+        case PLC_DATA_INTERVAL:
+            res = sizeof(plcInterval);
+            break;
+        case PLC_DATA_UUID:
+            res = PLC_UUID_LEN;
+            break;
         case PLC_DATA_TEXT:
         case PLC_DATA_UDT:
         case PLC_DATA_BYTEA:
+        case PLC_DATA_JSON:
+        case PLC_DATA_BINARY:
             /* 8 = the size of pointer */
             res = 8;
             break;
@@ -243,6 +347,45 @@ int plc_get_type_length(plcDatatype dt) {
     return res;
 }
 
+/* Allocates date or time value passed as text: the marker in place of the
+ * binary value followed by the text value */
+char *plc_alloc_temporal_text(plcDatatype dt, const char *data, int len) {
+    int   entrylen = plc_get_type_length(dt);
+    char *res;
+
+    res = pmalloc(entrylen + len + 5);
+    if (dt == PLC_DATA_DATE) {
+        *((int*)res) = PLC_TEMPORAL_TEXT_INT32;
+    } else if (dt == PLC_DATA_INTERVAL) {
+        ((plcInterval*)res)->time = 0;
+        ((plcInterval*)res)->day = 0;
+        ((plcInterval*)res)->month = 0;
+        ((plcInterval*)res)->format = PLC_BINARY_FORMAT_TEXT;
+    } else {
+        *((long long*)res) = PLC_TEMPORAL_TEXT_INT64;
+    }
+    *((int*)(res + entrylen)) = len;
+    memcpy(res + entrylen + 4, data, len);
+    res[entrylen + len + 4] = '\0';
+
+    return res;
+}
+
+int plc_is_temporal_text(plcDatatype dt, const char *value) {
+    switch (dt) {
+        case PLC_DATA_TIMESTAMP:
+        case PLC_DATA_TIMESTAMPTZ:
+        case PLC_DATA_TIME:
+            return *((const long long*)value) == PLC_TEMPORAL_TEXT_INT64;
+        case PLC_DATA_DATE:
+            return *((const int*)value) == PLC_TEMPORAL_TEXT_INT32;
+        case PLC_DATA_INTERVAL:
+            return ((const plcInterval*)value)->format == PLC_BINARY_FORMAT_TEXT;
+        default:
+            return 0;
+    }
+}
+
 const char *plc_get_type_name(plcDatatype dt) {
     const char * types[] = {"PLC_DATA_INT1", "PLC_DATA_INT2", "PLC_DATA_INT4", "PLC_DATA_INT8",
                             "PLC_DATA_FLOAT4", "PLC_DATA_FLOAT8",
@@ -250,6 +393,46 @@ const char *plc_get_type_name(plcDatatype dt) {
                             "PLC_DATA_ARRAY",
                             "PLC_DATA_UDT",
                             "PLC_DATA_BYTEA",
+                            "PLC_DATA_TIMESTAMP", "PLC_DATA_TIMESTAMPTZ",
+                            "PLC_DATA_DATE", "PLC_DATA_TIME",
+                            "PLC_DATA_INTERVAL",
+                            "PLC_DATA_UUID",
+                            "PLC_DATA_JSON",
+                            "PLC_DATA_BINARY",
                             "PLC_DATA_INVALID"};
-    return (dt >= 0 && dt <= 10) ? types[dt] : "UNKNOWN";
-}
\ No newline at end of file
+    return (dt >= 0 && dt <= PLC_DATA_INVALID) ? types[dt] : "UNKNOWN";
+}
+
+void free_trace(plcMsgTrace *msg) {
+    int i;
+
+    for (i = 0; i < msg->nevents; i++) {
+        if (msg->events[i].name != NULL) {
+            pfree(msg->events[i].name);
+        }
+    }
+    if (msg->events != NULL) {
+        pfree(msg->events);
+    }
+    pfree(msg);
+}
+
+void free_stats(plcMsgStats *msg) {
+    int i;
+
+    for (i = 0; i < msg->ncounters; i++) {
+        if (msg->names[i] != NULL) {
+            pfree(msg->names[i]);
+        }
+    }
+    if (msg->names != NULL) {
+        pfree(msg->names);
+    }
+    if (msg->values != NULL) {
+        pfree(msg->values);
+    }
+    if (msg->functions != NULL) {
+        pfree(msg->functions);
+    }
+    pfree(msg);
+}
@@ -15,6 +15,7 @@
 #include "comm_utils.h"
 #include "comm_connectivity.h"
 #include "comm_server.h"
+#include "comm_trace.h"
 #include "messages/messages.h"
 
 /*
@@ -90,10 +91,23 @@ plcConn* connection_init(int sock) {
     return plcConnInit(connection);
 }
 
+/*
+ * Answers the trace request with the events recorded by the client process
+ */
+static void handle_trace(plcConn* conn) {
+    plcMsgTrace res;
+
+    res.msgtype = MT_TRACE;
+    res.events = plc_trace_events(&res.nevents);
+    plcontainer_channel_send(conn, (plcMessage*)&res);
+    pfree(res.events);
+}
+
 /*
  * The loop of receiving commands from the Greenplum process and processing them
  */
-void receive_loop( void (*handle_call)(plcMsgCallreq*, plcConn*), plcConn* conn) {
+void receive_loop( void (*handle_call)(plcMsgCallreq*, plcConn*),
+                   void (*handle_stats)(plcMsgStats*, plcConn*), plcConn* conn) {
     plcMessage *msg;
     int res = 0;
 
@@ -131,6 +145,14 @@ void receive_loop( void (*handle_call)(plcMsgCallreq*, plcConn*), plcConn* conn)
                 handle_call((plcMsgCallreq*)msg, conn);
                 free_callreq((plcMsgCallreq*)msg, false, false);
                 break;
+            case MT_STATS:
+                handle_stats((plcMsgStats*)msg, conn);
+                free_stats((plcMsgStats*)msg);
+                break;
+            case MT_TRACE:
+                handle_trace(conn);
+                free_trace((plcMsgTrace*)msg);
+                break;
             default:
                 lprintf(ERROR, "received unknown message: %c", msg->msgtype);
         }
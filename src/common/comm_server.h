@@ -21,6 +21,7 @@
 int  start_listener(void);
 void connection_wait(int sock);
 plcConn* connection_init(int sock);
-void receive_loop( void (*handle_call)(plcMsgCallreq*, plcConn*), plcConn* conn);
+void receive_loop( void (*handle_call)(plcMsgCallreq*, plcConn*),
+                   void (*handle_stats)(plcMsgStats*, plcConn*), plcConn* conn);
 
 #endif /* PLC_COMM_SERVER_H */
@@ -0,0 +1,45 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "comm_utils.h"
+#include "comm_trace.h"
+
+int plc_trace_enabled = 0;
+
+static plcTraceEvent plcTraceBuffer[PLC_TRACE_BUFFER_SIZE];
+static long long     plcTraceCount = 0;
+
+void plc_trace_event(const char *name, char phase) {
+    plcTraceEvent  *event = &plcTraceBuffer[plcTraceCount % PLC_TRACE_BUFFER_SIZE];
+    struct timeval  tv;
+
+    gettimeofday(&tv, NULL);
+    event->name = (char*)name;
+    event->phase = phase;
+    event->ts = (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+    plcTraceCount++;
+}
+
+plcTraceEvent *plc_trace_events(int *nevents) {
+    plcTraceEvent *res;
+    long long      first = 0;
+    long long      i;
+    int            n = 0;
+
+    if (plcTraceCount > PLC_TRACE_BUFFER_SIZE) {
+        first = plcTraceCount - PLC_TRACE_BUFFER_SIZE;
+    }
+    res = pmalloc((plcTraceCount - first + 1) * sizeof(plcTraceEvent));
+    for (i = first; i < plcTraceCount; i++) {
+        res[n++] = plcTraceBuffer[i % PLC_TRACE_BUFFER_SIZE];
+    }
+    *nevents = n;
+    return res;
+}
@@ -0,0 +1,39 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef PLC_COMM_TRACE_H
+#define PLC_COMM_TRACE_H
+
+#include "messages/messages.h"
+
+/* Number of events kept by the process, older events are overwritten */
+#define PLC_TRACE_BUFFER_SIZE 8192
+
+/* Whether the events are recorded, switched at runtime */
+extern int plc_trace_enabled;
+
+#define plc_trace_begin(name)                 \
+    do {                                      \
+        if (plc_trace_enabled) {              \
+            plc_trace_event((name), 'B');     \
+        }                                     \
+    } while (0)
+
+#define plc_trace_end(name)                   \
+    do {                                      \
+        if (plc_trace_enabled) {              \
+            plc_trace_event((name), 'E');     \
+        }                                     \
+    } while (0)
+
+/* Records the event, the name should be a string constant */
+void plc_trace_event(const char *name, char phase);
+
+/* Events in the buffer starting from the oldest, the array should be freed */
+plcTraceEvent *plc_trace_events(int *nevents);
+
+#endif /* PLC_COMM_TRACE_H */
@@ -5,6 +5,9 @@
  *
  *------------------------------------------------------------------------------
  */
+#include <string.h>
+#include <strings.h>
+
 #include "comm_utils.h"
 
 #ifndef COMM_STANDALONE
@@ -26,3 +29,39 @@
     }
 
 #endif /* COMM_STANDALONE */
+
+bool plc_is_setting_on(const char *value) {
+    size_t len;
+
+    if (value == NULL) {
+        return false;
+    }
+    value += strspn(value, " \t");
+    len = strcspn(value, " \t\r\n");
+    return (len == 2 && strncasecmp(value, "on", len) == 0)
+        || (len == 4 && strncasecmp(value, "true", len) == 0)
+        || (len == 3 && strncasecmp(value, "yes", len) == 0)
+        || (len == 1 && value[0] == '1');
+}
+
+const char *plc_get_source_option(const char *src, const char *name) {
+    const char *line = src;
+    size_t      len = strlen(name);
+
+    while (line != NULL) {
+        line += strspn(line, " \t\r\n");
+        if (*line != '#') {
+            break;
+        }
+        line += 1 + strspn(line + 1, " \t");
+        if (strncmp(line, name, len) == 0) {
+            const char *value = line + len + strspn(line + len, " \t");
+            if (*value == ':') {
+                return value + 1;
+            }
+        }
+        line = strchr(line, '\n');
+    }
+
+    return NULL;
+}
@@ -99,4 +99,13 @@ interpreted as representing official policies, either expressed or implied, of t
 
 #endif /* COMM_STANDALONE */
 
+/* Whether the value of the setting is one of "on", "true", "yes" or "1" */
+bool plc_is_setting_on(const char *value);
+
+/*
+ * Value of the function option set with "# name: value" among the comment
+ * lines on top of the function source, NULL if the option is not set
+ */
+const char *plc_get_source_option(const char *src, const char *name);
+
 #endif /* PLC_COMM_UTILS_H */
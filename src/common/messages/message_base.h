@@ -29,13 +29,48 @@ typedef enum {
     PLC_DATA_FLOAT4  = 4,  // 4-byte float
     PLC_DATA_FLOAT8  = 5,  // 8-byte float
     PLC_DATA_TEXT    = 6,  // Text - transferred as a set of bytes of predefined length,
-                           //        stored as cstring
+                           //        stored as length + data + terminating zero
     PLC_DATA_ARRAY   = 7,  // Array - array type specification should follow
     PLC_DATA_UDT     = 8,  // User-defined type, specification to follow
     PLC_DATA_BYTEA   = 9,  // Arbitrary set of bytes, stored and transferred as length + data
-    PLC_DATA_INVALID = 10  // Invalid data type
+    PLC_DATA_TIMESTAMP   = 10, // 8-byte integer, microseconds since 2000-01-01 00:00:00
+    PLC_DATA_TIMESTAMPTZ = 11, // 8-byte integer, microseconds since 2000-01-01 00:00:00 UTC
+    PLC_DATA_DATE        = 12, // 4-byte integer, days since 2000-01-01
+    PLC_DATA_TIME        = 13, // 8-byte integer, microseconds since midnight
+    PLC_DATA_INTERVAL    = 14, // Format byte and 16-byte interval or text, stored as plcInterval
+    PLC_DATA_UUID        = 15, // 16 bytes of UUID in network byte order
+    PLC_DATA_JSON        = 16, // JSON document, transferred and stored the same way as text
+    PLC_DATA_BINARY      = 17, // Value in the type's own binary send/receive format, stored and
+                               //        transferred as bytea with a leading format byte
+    PLC_DATA_INVALID     = 18  // Invalid data type
 } plcDatatype;
 
+/* Binary representation of interval, matches the backend Interval layout.
+ * Every interval value is valid, so the value passed as text is told by the
+ * format, which is sent ahead of the value */
+typedef struct {
+    long long time;   // microseconds
+    int       day;
+    int       month;
+    char      format; // PLC_BINARY_FORMAT_BINARY or PLC_BINARY_FORMAT_TEXT
+} plcInterval;
+
+/* Date and time value the client could not convert to binary is passed as
+ * text for the backend input function: the binary value is replaced by the
+ * marker below, never produced by the backend, and is followed by the text.
+ * Interval passed as text has text format instead of the marker */
+#define PLC_TEMPORAL_TEXT_INT64 (-0x7FFFFFFFFFFFFFFFLL)
+#define PLC_TEMPORAL_TEXT_INT32 (-0x7FFFFFFF)
+
+#define plc_temporal_text(dt, value) ((value) + plc_get_type_length(dt))
+
+#define PLC_UUID_LEN 16
+
+/* First data byte of PLC_DATA_BINARY value: the rest of the value is either
+ * the output of the type's send function or its text representation */
+#define PLC_BINARY_FORMAT_BINARY 'B'
+#define PLC_BINARY_FORMAT_TEXT   'T'
+
 typedef struct plcType plcType;
 
 struct plcType {
@@ -43,6 +78,7 @@ struct plcType {
     short        nSubTypes;
     char        *typeName;
     plcType     *subTypes;
+    char        *pgTypeName; // database type name, only set for PLC_DATA_BINARY
 };
 
 typedef struct {
@@ -52,6 +88,9 @@ typedef struct {
 } plcArgument;
 
 int plc_get_type_length(plcDatatype dt);
+char *plc_alloc_temporal_text(plcDatatype dt, const char *data, int len);
+int plc_is_temporal_text(plcDatatype dt, const char *value);
 const char* plc_get_type_name(plcDatatype dt);
+void free_type(plcType *type);
 
 #endif /* PLC_MESSAGE_BASE_H */
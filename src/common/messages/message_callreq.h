@@ -19,6 +19,8 @@ typedef struct plcMsgCallreq {
     base_message_content;    // message_type ID
     unsigned int objectid;   // OID of the function in GPDB
     int          hasChanged; // flag signaling the function has changed in GPDB
+    int          logLevel;   // lowest level of the log messages output by GPDB
+    int          trace;      // whether the client should record trace events
     plcProcSrc   proc;       // procedure - its name and source code
     plcType      retType;    // function return type
     int          retset;     // whether the function is set-returning
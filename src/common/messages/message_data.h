@@ -19,12 +19,35 @@ typedef struct plcArrayMeta {
     int          size;  // deprecated - should be moved to payload if required
 } plcArrayMeta;
 
+/*
+ * Arrays of variable-width elements (text and bytea) are stored as a single
+ * contiguous blob in "data", element i occupying the bytes from offsets[i]
+ * to offsets[i+1]. For all the other element types "offsets" is NULL and
+ * "data" holds size fixed-length entries. Date and time elements passed as
+ * text have the marker in "data" and their text values in "texts", which is
+ * NULL if there are no such elements
+ */
 typedef struct plcArray {
     plcArrayMeta *meta;
     char         *data;
     char         *nulls;
+    int          *offsets;
+    char        **texts;
 } plcArray;
 
+#define plc_array_is_contiguous(type) \
+    ((type) == PLC_DATA_TEXT || (type) == PLC_DATA_BYTEA)
+
+/*
+ * Arrays of fixed-width elements are sent as the null flags followed by the
+ * block of all the values, which is received right into "data"
+ */
+#define plc_array_is_fixed_width(type) \
+    ((type) == PLC_DATA_INT1 || (type) == PLC_DATA_INT2 || (type) == PLC_DATA_INT4 \
+     || (type) == PLC_DATA_INT8 || (type) == PLC_DATA_FLOAT4 || (type) == PLC_DATA_FLOAT8 \
+     || (type) == PLC_DATA_TIMESTAMP || (type) == PLC_DATA_TIMESTAMPTZ \
+     || (type) == PLC_DATA_DATE || (type) == PLC_DATA_TIME || (type) == PLC_DATA_UUID)
+
 struct plcIterator {
     plcArrayMeta *meta;
     char         *data;
@@ -35,6 +58,12 @@ struct plcIterator {
      * creating a copy of full array before sending it
      */
     rawdata *(*next)(plcIterator *self);
+    /*
+     * optional, set when the array of fixed-width elements has no nulls and
+     * its values are already laid out in memory the way they are sent, so
+     * that the whole block could be sent at once instead of calling "next"
+     */
+    char *values;
     /*
      * called after data is sent to free data
      */
@@ -49,5 +78,6 @@ plcArray *plc_alloc_array(int ndims);
 void plc_free_array(plcArray *arr, plcType *type, bool isSender);
 plcUDT *plc_alloc_udt(int nargs);
 void plc_free_udt(plcUDT *udt, plcType *type, bool isSender);
+char *plc_alloc_text(const char *data, int len);
 
 #endif /* PLC_MESSAGE_DATA_H */
@@ -20,6 +20,9 @@ typedef struct plcMsgResult {
     /* Callback called from message sending function to return the error message
      * generated during the period engine could not send it */
     void        *(*exception_callback)(void);
+    /* Column types are owned by the sender's cache and not freed with the
+     * message, only used on the sender side */
+    int           sharedTypes;
 } plcMsgResult;
 
 void free_result(plcMsgResult *res, bool isSender);
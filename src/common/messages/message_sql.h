@@ -19,13 +19,68 @@ typedef enum {
     SQL_TYPE_PREPARE,
     SQL_TYPE_PEXECUTE,
     SQL_TYPE_UNPREPARE,
+    SQL_TYPE_SUBXACT_BEGIN,
+    SQL_TYPE_SUBXACT_COMMIT,
+    SQL_TYPE_SUBXACT_ROLLBACK,
+    SQL_TYPE_PREPARE_INSERT,
+    SQL_TYPE_INSERT,
+    SQL_TYPE_BATCH,
     SQL_TYPE_MAX
 } plcSqlType;
 
+/*
+ * SQL request of the client. Statement is executed right away. Prepare
+ * sends the query with the names of its argument types, and is answered
+ * with a result of a single row: the first column "plan" is the handle of
+ * the prepared plan, the rest of the columns have the types of the plan
+ * arguments and contain NULLs. Execution of the prepared plan sends the
+ * handle with argument values, and is answered with the query result.
+ * Unprepare releases the plan and is not answered.
+ *
+ * Cursor open sends either the query or the handle of the prepared plan
+ * with argument values, and is answered with a result of a single row with
+ * the cursor handle in the "cursor" column. Fetch sends the cursor handle
+ * with the number of rows to fetch, and is answered with the next rows of
+ * the cursor, no rows meaning that the cursor is exhausted. Cursor close is
+ * not answered.
+ *
+ * Subtransaction messages begin, commit and roll back the subtransaction
+ * shared by all the statements till it ends. They have no content and are
+ * not answered.
+ *
+ * Statements that return no rows are answered with the result without
+ * columns, which has the number of processed rows as its number of rows.
+ *
+ * Insert prepare sends the name of the relation with the names of its
+ * columns, all the columns if none are given. It is answered as prepare,
+ * with the column names as the names of the plan arguments. Insert sends
+ * the plan handle with the batch of rows, each row holds the values of all
+ * the plan arguments, and is answered with the number of inserted rows.
+ *
+ * Batch carries statements and executions of prepared plans, which are
+ * executed in order. Each of them is answered with its own result, and all
+ * the results are sent without waiting for the client.
+ */
 typedef struct plcMsgSQL {
     base_message_content;
-    plcSqlType  sqltype;
-    char       *statement;
+    plcSqlType   sqltype;
+    char        *statement; // query text for statement, prepare and cursor open
+    int          planid;    // plan handle for execute, unprepare and cursor open
+    int          cursorid;  // cursor handle for fetch and cursor close
+    int          limit;     // maximum number of rows to return, 0 for all
+    int          nargs;     // number of plan arguments
+    char       **argtypes;  // names of argument types for prepare, column names for insert prepare
+    plcArgument *args;      // argument values for execute and cursor open
+    int          nrows;     // number of rows to insert
+    plcType     *types;     // types of the inserted values, one per plan argument
+    rawdata    **rows;      // inserted rows of nargs values each
+    int          nbatch;    // number of messages in the batch
+    struct plcMsgSQL **batch; // messages of the batch
 } plcMsgSQL;
 
+/*
+  Frees SQL message, strings are not freed if they are shared
+*/
+void free_sql(plcMsgSQL *msg, bool isShared, bool isSender);
+
 #endif /* PLC_MESSAGE_SQL_H */
@@ -0,0 +1,48 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef PLC_MESSAGE_STATS_H
+#define PLC_MESSAGE_STATS_H
+
+#include "message_base.h"
+
+/*
+ * Number of buckets in the histogram of the function call times. Bucket i
+ * counts the calls that took less than 10^(i+1) microseconds, the last one
+ * counts all the longer calls
+ */
+#define PLC_STATS_HISTOGRAM_BUCKETS 8
+
+/* Execution profile of the function in the client, times are in microseconds */
+typedef struct plcFunctionStats {
+    unsigned int objectid;
+    long long    calls;
+    long long    argumentsTime;  // converting the arguments to the client objects
+    long long    executionTime;  // running the function, excluding SPI
+    long long    resultsTime;    // converting and sending the result
+    long long    spiCalls;
+    long long    spiTime;        // waiting for the backend to run SQL
+    long long    histogram[PLC_STATS_HISTOGRAM_BUCKETS];
+} plcFunctionStats;
+
+/*
+ * Statistics of the client. Backend sends the message without counters as
+ * the request between the function calls, and the client answers with the
+ * message holding its counters and the profiles of the functions it has run
+ */
+typedef struct plcMsgStats {
+    base_message_content;
+    int               ncounters;
+    char            **names;
+    long long        *values;
+    int               nfunctions;
+    plcFunctionStats *functions;
+} plcMsgStats;
+
+void free_stats(plcMsgStats *msg);
+
+#endif /* PLC_MESSAGE_STATS_H */
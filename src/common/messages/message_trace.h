@@ -0,0 +1,33 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+#ifndef PLC_MESSAGE_TRACE_H
+#define PLC_MESSAGE_TRACE_H
+
+#include "message_base.h"
+
+typedef struct plcTraceEvent {
+    char      *name;   // name of the phase
+    char       phase;  // 'B' for the beginning of the phase, 'E' for its end
+    long long  ts;     // wall clock time in microseconds
+} plcTraceEvent;
+
+/*
+ * Trace events recorded by the client. Backend sends the message without
+ * events as the request between the function calls, and the client answers
+ * with the content of its trace buffer
+ */
+typedef struct plcMsgTrace {
+    base_message_content;
+    int            nevents;
+    plcTraceEvent *events;
+} plcMsgTrace;
+
+/* Frees the received message, including the event names */
+void free_trace(plcMsgTrace *msg);
+
+#endif /* PLC_MESSAGE_TRACE_H */
@@ -17,6 +17,8 @@
 #define MT_TUPLRES 'U'
 #define MT_TRANSEVENT 'V'
 #define MT_PING 'P'
+#define MT_STATS 'X'
+#define MT_TRACE 'D'
 #define MT_EOF 0
 
 #endif /* PLC_MESSAGE_TYPES_H */
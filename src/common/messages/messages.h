@@ -17,5 +17,7 @@
 #include "message_log.h"
 #include "message_data.h"
 #include "message_ping.h"
+#include "message_stats.h"
+#include "message_trace.h"
 
 #endif /* PLC_MESSAGES_H */
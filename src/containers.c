@@ -18,8 +18,11 @@
 
 #include "common/comm_utils.h"
 #include "common/comm_channel.h"
+#include "common/comm_trace.h"
 #include "common/messages/messages.h"
 #include "plc_configuration.h"
+#include "plc_wait.h"
+#include "sqlhandler.h"
 #include "containers.h"
 
 #ifdef CURL_DOCKER_API
@@ -34,7 +37,6 @@ typedef struct {
     plcConn *conn;
 } container_t;
 
-#define CONTAINER_NUMBER 10
 static int containers_init = 0;
 static container_t *containers;
 
@@ -132,6 +134,16 @@ static void init_containers() {
     containers_init = 1;
 }
 
+plcConn *get_container_conn(int slot, char **name) {
+    if (containers_init == 0)
+        init_containers();
+    if (slot < 0 || slot >= CONTAINER_NUMBER || containers[slot].name == NULL) {
+        return NULL;
+    }
+    *name = containers[slot].name;
+    return containers[slot].conn;
+}
+
 plcConn *find_container(const char *image) {
     size_t i;
     if (containers_init == 0)
@@ -153,6 +165,8 @@ plcConn *start_container(plcContainer *cont) {
     plcMsgPing *mping = NULL;
     plcConn *conn = NULL;
     char *dockerid = NULL;
+    unsigned int timeoutms = CONTAINER_CONNECT_TIMEOUT_MS;
+    plcWaitState wait;
 
 #ifdef CONTAINER_DEBUG
 
@@ -163,6 +177,8 @@ plcConn *start_container(plcContainer *cont) {
     int sockfd;
     int res = 0;
 
+    plc_trace_begin("container start");
+    wait = plc_wait_start(PLC_WAIT_CONTAINER_START);
     sockfd = plc_docker_connect();
     if (sockfd < 0) {
         elog(ERROR, "Cannot connect to the Docker API socket");
@@ -195,16 +211,25 @@ plcConn *start_container(plcContainer *cont) {
 
     /* Create a process to clean up the container after it finishes */
     cleanup(dockerid);
+    plc_wait_end(wait);
+    plc_trace_end("container start");
 
 #endif // CONTAINER_DEBUG
 
     /* Making a series of connection attempts unless connection timeout of
      * CONTAINER_CONNECT_TIMEOUT_MS is reached. Exponential backoff for
      * reconnecting first attempts: 25ms, 50ms, 100ms, 200ms, 200ms, etc.
+     * The client starts listening only after the preload is finished, so
+     * such containers are given more time to start
      */
+    if (cont->preload != NULL || cont->warmup != NULL) {
+        timeoutms = CONTAINER_PRELOAD_CONNECT_TIMEOUT_MS;
+    }
     mping = palloc(sizeof(plcMsgPing));
     mping->msgtype = MT_PING;
-    while (sleepms < CONTAINER_CONNECT_TIMEOUT_MS) {
+    plc_trace_begin("connect");
+    wait = plc_wait_start(PLC_WAIT_PING);
+    while (sleepms < timeoutms) {
         int         res = 0;
         plcMessage *mresp = NULL;
 
@@ -226,10 +251,12 @@ plcConn *start_container(plcContainer *cont) {
         sleepms += sleepus / 1000;
         sleepus = sleepus >= 200000 ? 200000 : sleepus * 2;
     }
+    plc_wait_end(wait);
+    plc_trace_end("connect");
 
-    if (sleepms >= CONTAINER_CONNECT_TIMEOUT_MS) {
-        elog(ERROR, "Cannot connect to the container, %d ms timeout reached",
-                    CONTAINER_CONNECT_TIMEOUT_MS);
+    if (sleepms >= timeoutms) {
+        elog(ERROR, "Cannot connect to the container, %u ms timeout reached",
+                    timeoutms);
         conn = NULL;
     } else {
         insert_container(cont->name, dockerid, conn);
@@ -249,6 +276,7 @@ void stop_containers() {
 
                 /* Terminate connection to the container */
                 if (containers[i].conn != NULL) {
+                    release_plans(containers[i].conn);
                     plcDisconnect(containers[i].conn);
                 }
 
@@ -14,6 +14,11 @@
 
 //#define CONTAINER_DEBUG
 #define CONTAINER_CONNECT_TIMEOUT_MS 5000
+/* Maximum number of containers started by a single session */
+#define CONTAINER_NUMBER 10
+
+/* Connection timeout for the containers importing modules at start */
+#define CONTAINER_PRELOAD_CONNECT_TIMEOUT_MS 60000
 
 /* given source code of the function, extract the container name */
 char *parse_container_meta(const char *source);
@@ -21,6 +26,10 @@ char *parse_container_meta(const char *source);
 /* return the port of a started container, -1 if the container isn't started */
 plcConn *find_container(const char *image);
 
+/* return the connection to the container in the given slot and its name,
+ * NULL if the slot is free. Slots are numbered from 0 to CONTAINER_NUMBER-1 */
+plcConn *get_container_conn(int slot, char **name);
+
 /* start a new docker container using the given image  */
 plcConn *start_container(plcContainer *cont);
 
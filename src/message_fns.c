@@ -34,17 +34,19 @@ interpreted as representing official policies, either expressed or implied, of t
 #include "postgres.h"
 #include "executor/spi.h"
 #include "access/transam.h"
+#include "utils/guc.h"
 
 /* message and function definitions */
 #include "common/comm_utils.h"
+#include "common/comm_trace.h"
 #include "common/messages/messages.h"
 #include "message_fns.h"
 #include "function_cache.h"
 #include "plc_typeio.h"
 
 static bool plc_procedure_valid(plcProcInfo *proc, HeapTuple procTup);
-static bool plc_type_valid(plcTypeInfo *type);
 static void fill_callreq_arguments(FunctionCallInfo fcinfo, plcProcInfo *pinfo, plcMsgCallreq *req);
+static int plc_log_level(void);
 
 plcProcInfo * get_proc_info(FunctionCallInfo fcinfo) {
     int           i, len;
@@ -59,6 +61,7 @@ plcProcInfo * get_proc_info(FunctionCallInfo fcinfo) {
                   textHeapTup = NULL;
     Form_pg_type  typeTup;
     plcProcInfo  *pinfo = NULL;
+    const char   *option;
 
     procoid = fcinfo->flinfo->fn_oid;
     procHeapTup = SearchSysCache(PROCOID, procoid, 0, 0, 0);
@@ -154,6 +157,13 @@ plcProcInfo * get_proc_info(FunctionCallInfo fcinfo) {
             elog(ERROR, "null proname");
         pinfo->name = plc_top_strdup(DatumGetCString(DirectFunctionCall1(nameout, namedatum)));
 
+        /*
+         * Function declared with "# statement_subtransactions: off" accepts
+         * that an error in SQL statement aborts the whole transaction
+         */
+        option = plc_get_source_option(pinfo->src, "statement_subtransactions");
+        pinfo->statementSubxacts = (option == NULL) || plc_is_setting_on(option);
+
         /* Cache the function for later use */
         function_cache_put(pinfo);
     } else {
@@ -178,6 +188,16 @@ void free_proc_info(plcProcInfo *proc) {
     pfree(proc);
 }
 
+/*
+ * Lowest level of the messages that are output either to the client or to
+ * the server log, the client does not send the messages below it. LOG and
+ * INFO messages are checked by the client separately, as their place in the
+ * order is different for the server log and for the client
+ */
+static int plc_log_level(void) {
+    return Min(client_min_messages, log_min_messages);
+}
+
 plcMsgCallreq *plcontainer_create_call(FunctionCallInfo fcinfo, plcProcInfo *pinfo) {
     plcMsgCallreq *req;
 
@@ -187,6 +207,8 @@ plcMsgCallreq *plcontainer_create_call(FunctionCallInfo fcinfo, plcProcInfo *pin
     req->proc.src  = pinfo->src;
     req->objectid  = pinfo->funcOid;
     req->hasChanged = pinfo->hasChanged;
+    req->logLevel = plc_log_level();
+    req->trace = plc_trace_enabled;
     copy_type_info(&req->retType, &pinfo->rettype);
 
     fill_callreq_arguments(fcinfo, pinfo, req);
@@ -194,7 +216,7 @@ plcMsgCallreq *plcontainer_create_call(FunctionCallInfo fcinfo, plcProcInfo *pin
     return req;
 }
 
-static bool plc_type_valid(plcTypeInfo *type) {
+bool plc_type_valid(plcTypeInfo *type) {
     bool valid = true;
     int  i;
 
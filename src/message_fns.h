@@ -49,10 +49,13 @@ typedef struct {
     int              nargs;
     char           **argnames;
     plcTypeInfo     *argtypes;
+    /* Whether each SQL statement runs in its own subtransaction */
+    bool             statementSubxacts;
 } plcProcInfo;
 
 plcProcInfo *get_proc_info(FunctionCallInfo fcinfo);
 void free_proc_info(plcProcInfo *proc);
+bool plc_type_valid(plcTypeInfo *type);
 
 plcMsgCallreq *plcontainer_create_call(FunctionCallInfo fcinfo, plcProcInfo *pinfo);
 
@@ -7,10 +7,12 @@
  */
 
 
+#include <ctype.h>
 #include <libxml/tree.h>
 #include <libxml/parser.h>
 
 #include "postgres.h"
+#include "lib/stringinfo.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
 
@@ -22,9 +24,12 @@ static plcContainer *plcContainerConf = NULL;
 static int plcNumContainers = 0;
 
 static int parse_container(xmlNode *node, plcContainer *cont);
+static bool is_valid_setting_name(const char *name);
 static plcContainer *get_containers(xmlNode *node, int *size);
 static void free_containers(plcContainer *cont, int size);
 static void print_containers(plcContainer *cont, int size);
+static void append_environment_option(StringInfo buf, const char *name,
+                                      const char *value);
 
 PG_FUNCTION_INFO_V1(read_plcontainer_config);
 
@@ -37,10 +42,14 @@ static int parse_container(xmlNode *node, plcContainer *cont) {
     int has_id = 0;
     int has_command = 0;
     int num_shared_dirs = 0;
+    int num_settings = 0;
 
     /* First iteration - parse name, container_id and memory_mb and count the
-     * number of shared directories for later allocation of related structure */
+     * number of shared directories and settings for later allocation of
+     * related structures */
     cont->memoryMb = -1;
+    cont->preload = NULL;
+    cont->warmup = NULL;
     for (cur_node = node->children; cur_node; cur_node = cur_node->next) {
         if (cur_node->type == XML_ELEMENT_NODE) {
             int processed = 0;
@@ -78,6 +87,30 @@ static int parse_container(xmlNode *node, plcContainer *cont) {
                 processed = 1;
             }
 
+            if (xmlStrcmp(cur_node->name, (const xmlChar *)"setting") == 0) {
+                num_settings += 1;
+                processed = 1;
+            }
+
+            if (xmlStrcmp(cur_node->name, (const xmlChar *)"preload") == 0) {
+                processed = 1;
+                if (cont->preload != NULL || cont->warmup != NULL) {
+                    elog(ERROR, "Container specification can have only one 'preload' tag");
+                    return -1;
+                }
+                value = xmlNodeGetContent(cur_node);
+                if (value != NULL && value[0] != '\0') {
+                    cont->preload = plc_top_strdup((char*)value);
+                }
+                if (value != NULL) {
+                    xmlFree(value);
+                }
+                value = xmlGetProp(cur_node, (const xmlChar *)"warmup");
+                if (value != NULL) {
+                    cont->warmup = plc_top_strdup((char*)value);
+                }
+            }
+
             /* If the tag is not known - we raise the related error */
             if (processed == 0) {
                 elog(ERROR, "Unrecognized element '%s' inside of container specification",
@@ -157,9 +190,64 @@ static int parse_container(xmlNode *node, plcContainer *cont) {
         }
     }
 
+    /* Process the client settings */
+    cont->nSettings = num_settings;
+    cont->settings = NULL;
+    if (num_settings > 0) {
+        int i = 0;
+
+        cont->settings = plc_top_alloc(num_settings * sizeof(plcSetting));
+        for (cur_node = node->children; cur_node; cur_node = cur_node->next) {
+            if (cur_node->type == XML_ELEMENT_NODE &&
+                    xmlStrcmp(cur_node->name, (const xmlChar *)"setting") == 0) {
+
+                value = xmlGetProp(cur_node, (const xmlChar *)"name");
+                if (value == NULL) {
+                    elog(ERROR, "Configuration tag 'setting' has a mandatory element"
+                         " 'name' that is not found");
+                    return -1;
+                }
+                if (!is_valid_setting_name((char*)value)) {
+                    elog(ERROR, "Setting name should consist of latin letters, digits and"
+                         " underscores, passed value is '%s'", value);
+                    return -1;
+                }
+                cont->settings[i].name = plc_top_strdup((char*)value);
+                xmlFree(value);
+
+                value = xmlGetProp(cur_node, (const xmlChar *)"value");
+                if (value == NULL) {
+                    elog(ERROR, "Configuration tag 'setting' has a mandatory element"
+                         " 'value' that is not found");
+                    return -1;
+                }
+                cont->settings[i].value = plc_top_strdup((char*)value);
+                xmlFree(value);
+
+                i += 1;
+            }
+        }
+    }
+
     return 0;
 }
 
+/* Settings become environment variables of the client, so we allow only the
+ * names that are safe to use there */
+static bool is_valid_setting_name(const char *name) {
+    const char *c;
+
+    if (*name == '\0' || isdigit((unsigned char)*name)) {
+        return false;
+    }
+    for (c = name; *c != '\0'; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
 /* Function returns an array of plcContainer structures based on the contents
  * of passed XML document tree. Returns NULL on failure */
 static plcContainer *get_containers(xmlNode *node, int *size) {
@@ -220,6 +308,9 @@ static void free_containers(plcContainer *cont, int size) {
         if (cont[i].nSharedDirs > 0 && cont[i].sharedDirs != NULL) {
             pfree(cont[i].sharedDirs);
         }
+        if (cont[i].nSettings > 0 && cont[i].settings != NULL) {
+            pfree(cont[i].settings);
+        }
     }
     pfree(cont);
 }
@@ -240,6 +331,16 @@ static void print_containers(plcContainer *cont, int size) {
                 elog(INFO, "        access = readwrite");
             }
         }
+        for (j = 0; j < cont[i].nSettings; j++) {
+            elog(INFO, "    setting '%s' = '%s'", cont[i].settings[j].name,
+                 cont[i].settings[j].value);
+        }
+        if (cont[i].preload != NULL) {
+            elog(INFO, "    preload = '%s'", cont[i].preload);
+        }
+        if (cont[i].warmup != NULL) {
+            elog(INFO, "    warmup = '%s'", cont[i].warmup);
+        }
     }
 }
 
@@ -363,3 +464,46 @@ char *get_sharing_options(plcContainer *cont) {
     }
     return res;
 }
+
+/* Appends "name=value" JSON string to the buffer */
+static void append_environment_option(StringInfo buf, const char *name,
+                                      const char *value) {
+    const char *c;
+
+    if (buf->len > 0) {
+        appendStringInfoString(buf, ", ");
+    }
+    appendStringInfo(buf, "\"%s=", name);
+    for (c = value; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            appendStringInfoChar(buf, '\\');
+            appendStringInfoChar(buf, *c);
+        } else if ((unsigned char)*c < ' ') {
+            appendStringInfo(buf, "\\u%04x", (int)*c);
+        } else {
+            appendStringInfoChar(buf, *c);
+        }
+    }
+    appendStringInfoChar(buf, '"');
+}
+
+/* Returns the list of client settings formatted as the JSON strings of the
+ * Docker "Env" array, i.e. "name=value" separated by commas. The preload
+ * list and the warm-up script are passed the same way */
+char *get_environment_options(plcContainer *cont) {
+    StringInfoData buf;
+    int i;
+
+    initStringInfo(&buf);
+    for (i = 0; i < cont->nSettings; i++) {
+        append_environment_option(&buf, cont->settings[i].name,
+                                  cont->settings[i].value);
+    }
+    if (cont->preload != NULL) {
+        append_environment_option(&buf, "PLC_PRELOAD_MODULES", cont->preload);
+    }
+    if (cont->warmup != NULL) {
+        append_environment_option(&buf, "PLC_WARMUP_SCRIPT", cont->warmup);
+    }
+    return buf.data;
+}
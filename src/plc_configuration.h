@@ -27,6 +27,12 @@ typedef struct plcSharedDir {
     plcFsAccessMode  mode;
 } plcSharedDir;
 
+/* Client setting, passed to the container as an environment variable */
+typedef struct plcSetting {
+    char *name;
+    char *value;
+} plcSetting;
+
 typedef struct plcContainer {
     char         *name;
     char         *dockerid;
@@ -34,6 +40,10 @@ typedef struct plcContainer {
     int           memoryMb;
     int           nSharedDirs;
     plcSharedDir *sharedDirs;
+    int           nSettings;
+    plcSetting   *settings;
+    char         *preload;  /* modules imported at client start, or NULL */
+    char         *warmup;   /* script run after the import, or NULL */
 } plcContainer;
 
 /* entrypoint for all plcontainer procedures */
@@ -41,5 +51,6 @@ Datum read_plcontainer_config(PG_FUNCTION_ARGS);
 int plc_read_container_config(bool verbose);
 plcContainer *plc_get_container_config(char *name);
 char *get_sharing_options(plcContainer *cont);
+char *get_environment_options(plcContainer *cont);
 
 #endif /* PLC_CONFIGURATION_H */
@@ -58,6 +58,7 @@ static char *plc_docker_create_request =
         "    \"Tty\": false,\n"
         "    \"Cmd\": [\"%s\"],\n"
         "    \"Image\": \"%s\",\n"
+        "    \"Env\": [%s],\n"
         "    \"DisableNetwork\": false,\n"
         "    \"HostConfig\": {\n"
         "        \"Binds\": [%s],\n"
@@ -463,6 +464,7 @@ int plc_docker_create_container(int sockfd, plcContainer *cont, char **name) {
     char *apiendpoint  = NULL;
     char *response     = NULL;
     char *sharing      = NULL;
+    char *environment  = NULL;
     char *apiendpointtemplate = "/%s/containers/create";
     int   res = 0;
 
@@ -474,12 +476,14 @@ int plc_docker_create_container(int sockfd, plcContainer *cont, char **name) {
 
     /* Get Docket API "create" call JSON message body */
     sharing = get_sharing_options(cont);
+    environment = get_environment_options(cont);
     message_body = palloc(40 + strlen(plc_docker_create_request) + strlen(cont->command)
-                             + strlen(cont->dockerid) + strlen(sharing));
+                             + strlen(cont->dockerid) + strlen(environment) + strlen(sharing));
     sprintf(message_body,
             plc_docker_create_request,
             cont->command,
             cont->dockerid,
+            environment,
             sharing,
             ((long long)cont->memoryMb) * 1024 * 1024);
 
@@ -496,6 +500,7 @@ int plc_docker_create_container(int sockfd, plcContainer *cont, char **name) {
 
     pfree(apiendpoint);
     pfree(sharing);
+    pfree(environment);
     pfree(message_body);
     pfree(message);
 
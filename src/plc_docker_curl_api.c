@@ -312,6 +312,7 @@ int plc_docker_create_container(int sockfd UNUSED, plcContainer *cont, char **na
             "    \"Tty\": false,\n"
             "    \"Cmd\": [\"%s\"],\n"
             "    \"Image\": \"%s\",\n"
+            "    \"Env\": [%s],\n"
             "    \"DisableNetwork\": false,\n"
             "    \"HostConfig\": {\n"
             "        \"Binds\": [%s],\n"
@@ -320,17 +321,20 @@ int plc_docker_create_container(int sockfd UNUSED, plcContainer *cont, char **na
             "    }\n"
             "}\n";
     char *volumeShare = get_sharing_options(cont);
+    char *environment = get_environment_options(cont);
     char *messageBody = NULL;
     plcCurlBuffer *response = NULL;
     int res = 0;
 
     /* Get Docket API "create" call JSON message body */
     messageBody = palloc(40 + strlen(createRequest) + strlen(cont->command)
-                            + strlen(cont->dockerid) + strlen(volumeShare));
+                            + strlen(cont->dockerid) + strlen(environment)
+                            + strlen(volumeShare));
     sprintf(messageBody,
             createRequest,
             cont->command,
             cont->dockerid,
+            environment,
             volumeShare,
             ((long long)cont->memoryMb) * 1024 * 1024);
 
@@ -341,6 +345,7 @@ int plc_docker_create_container(int sockfd UNUSED, plcContainer *cont, char **na
     /* Free up intermediate data */
     pfree(messageBody);
     pfree(volumeShare);
+    pfree(environment);
 
     if (res == 0) {
         res = docker_parse_container_id(response->data, name);
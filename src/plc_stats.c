@@ -0,0 +1,584 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <time.h>
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "cdb/cdbvars.h"
+#include "lib/stringinfo.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+
+#include "common/comm_channel.h"
+#include "common/comm_trace.h"
+#include "common/messages/messages.h"
+#include "containers.h"
+#include "plcontainer.h"
+#include "plc_stats.h"
+
+typedef struct plcClientCounter {
+    char      *container;
+    char      *name;
+    long long  value;
+} plcClientCounter;
+
+typedef struct plcClientFunctionStats {
+    char             *container;
+    plcFunctionStats  stats;
+} plcClientFunctionStats;
+
+typedef struct plcTraceRecord {
+    int            thread;      // 0 for the backend, container slot + 1 for the clients
+    char          *threadName;
+    int            seq;         // position of the event in the process trace
+    plcTraceEvent  event;
+} plcTraceRecord;
+
+/* Number of functions the statistics table is initially sized for */
+#define PLC_FUNCTION_STATS_SIZE 128
+
+static HTAB *plcFunctionStatsTable = NULL;
+
+static plcMessage *plc_client_request(plcConn *conn, plcMessage *req);
+static plcMsgStats *plc_request_client_stats(plcConn *conn);
+static plcMsgTrace *plc_request_client_trace(plcConn *conn);
+static plcTraceRecord *plc_add_trace_records(plcTraceRecord *records, int *nrecords,
+                                             int thread, char *threadName,
+                                             plcTraceEvent *events, int nevents);
+static void plc_check_call_depth(void);
+static char *plc_format_time(long long usec);
+
+PG_FUNCTION_INFO_V1(plcontainer_client_counters);
+PG_FUNCTION_INFO_V1(plcontainer_client_stats);
+PG_FUNCTION_INFO_V1(plcontainer_local_function_stats);
+PG_FUNCTION_INFO_V1(plcontainer_local_trace);
+PG_FUNCTION_INFO_V1(plcontainer_local_trace_events);
+PG_FUNCTION_INFO_V1(plcontainer_json_string);
+
+int64 plc_stats_clock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+plcFunctionCallStats *plc_function_call_stats(Oid funcOid) {
+    plcFunctionCallStats *stats;
+    bool                  found;
+
+    if (plcFunctionStatsTable == NULL) {
+        HASHCTL ctl;
+
+        MemSet(&ctl, 0, sizeof(ctl));
+        ctl.keysize = sizeof(Oid);
+        ctl.entrysize = sizeof(plcFunctionCallStats);
+        ctl.hash = oid_hash;
+        plcFunctionStatsTable = hash_create("PL/Container function statistics",
+                                       PLC_FUNCTION_STATS_SIZE, &ctl,
+                                       HASH_ELEM | HASH_FUNCTION);
+    }
+
+    stats = (plcFunctionCallStats*)hash_search(plcFunctionStatsTable, &funcOid,
+                                               HASH_ENTER, &found);
+    if (!found) {
+        MemSet(stats, 0, sizeof(plcFunctionCallStats));
+        stats->funcOid = funcOid;
+    }
+    return stats;
+}
+
+/*
+ * Sends the request to the client and receives the answer of the same type.
+ * Containers are busy while a function runs, so it can be done only between
+ * the function calls. Clients of the text protocol do not answer the requests
+ * and are skipped by the callers
+ */
+static plcMessage *plc_client_request(plcConn *conn, plcMessage *req) {
+    plcMessage  *answer = NULL;
+    int          res;
+
+    res = plcontainer_channel_send(conn, req);
+    if (res < 0) {
+        elog(ERROR, "Error sending data to the client, %d", res);
+    }
+    res = plcontainer_channel_receive(conn, &answer);
+    if (res < 0) {
+        elog(ERROR, "Error receiving data from the client, %d", res);
+    }
+    if (answer->msgtype != req->msgtype) {
+        elog(ERROR, "Received message type '%c' from the client instead of '%c'",
+                    answer->msgtype, req->msgtype);
+    }
+    return answer;
+}
+
+static plcMsgStats *plc_request_client_stats(plcConn *conn) {
+    plcMsgStats  req;
+
+    req.msgtype = MT_STATS;
+    req.ncounters = 0;
+    req.names = NULL;
+    req.values = NULL;
+    req.nfunctions = 0;
+    req.functions = NULL;
+    return (plcMsgStats*)plc_client_request(conn, (plcMessage*)&req);
+}
+
+static plcMsgTrace *plc_request_client_trace(plcConn *conn) {
+    plcMsgTrace  req;
+
+    req.msgtype = MT_TRACE;
+    req.nevents = 0;
+    req.events = NULL;
+    return (plcMsgTrace*)plc_client_request(conn, (plcMessage*)&req);
+}
+
+/* Appends the events of one process, the event names are copied */
+static plcTraceRecord *plc_add_trace_records(plcTraceRecord *records, int *nrecords,
+                                             int thread, char *threadName,
+                                             plcTraceEvent *events, int nevents) {
+    int i;
+
+    if (nevents == 0) {
+        return records;
+    }
+    records = (records == NULL)
+        ? palloc((*nrecords + nevents) * sizeof(plcTraceRecord))
+        : repalloc(records, (*nrecords + nevents) * sizeof(plcTraceRecord));
+    for (i = 0; i < nevents; i++) {
+        plcTraceRecord *record = &records[*nrecords + i];
+
+        record->thread = thread;
+        record->threadName = pstrdup(threadName);
+        record->seq = i;
+        record->event = events[i];
+        record->event.name = pstrdup(events[i].name);
+    }
+    *nrecords += nevents;
+    return records;
+}
+
+static void plc_check_call_depth(void) {
+    if (plcontainer_call_depth > 0) {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("Client statistics cannot be requested from "
+                        "PL/Container function")));
+    }
+}
+
+/* Microseconds reported by the client as milliseconds */
+static char *plc_format_time(long long usec) {
+    char *res = palloc(32);
+
+    snprintf(res, 32, "%.3f", (double)usec / 1000.0);
+    return res;
+}
+
+Datum plcontainer_client_counters(PG_FUNCTION_ARGS) {
+    FuncCallContext  *funcctx;
+    plcClientCounter *counters;
+
+    if (SRF_IS_FIRSTCALL()) {
+        MemoryContext  oldcontext;
+        TupleDesc      tupdesc;
+        plcMsgStats   *stats;
+        plcConn       *conn;
+        char          *name;
+        int            ncounters = 0;
+        int            slot;
+        int            i;
+
+        plc_check_call_depth();
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE) {
+            elog(ERROR, "Return type must be a row type");
+        }
+        funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+
+        counters = NULL;
+        for (slot = 0; slot < CONTAINER_NUMBER; slot++) {
+            conn = get_container_conn(slot, &name);
+            if (conn == NULL || conn->version < PLC_PROTOCOL_VERSION_TYPED) {
+                continue;
+            }
+
+            stats = plc_request_client_stats(conn);
+            if (stats->ncounters > 0) {
+                counters = (counters == NULL)
+                    ? palloc((ncounters + stats->ncounters) * sizeof(plcClientCounter))
+                    : repalloc(counters, (ncounters + stats->ncounters) * sizeof(plcClientCounter));
+                for (i = 0; i < stats->ncounters; i++) {
+                    counters[ncounters].container = pstrdup(name);
+                    counters[ncounters].name = pstrdup(stats->names[i]);
+                    counters[ncounters].value = stats->values[i];
+                    ncounters++;
+                }
+            }
+            free_stats(stats);
+        }
+
+        funcctx->user_fctx = counters;
+        funcctx->max_calls = ncounters;
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    counters = (plcClientCounter*)funcctx->user_fctx;
+
+    if (funcctx->call_cntr < funcctx->max_calls) {
+        plcClientCounter *counter = &counters[funcctx->call_cntr];
+        char             *values[3];
+        char              value[32];
+        HeapTuple         tuple;
+
+        snprintf(value, sizeof(value), "%lld", counter->value);
+        values[0] = counter->container;
+        values[1] = counter->name;
+        values[2] = value;
+        tuple = BuildTupleFromCStrings(funcctx->attinmeta, values);
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+    }
+
+    SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * Execution profiles of the functions run by the clients, with the times in
+ * milliseconds and the histogram of the call times
+ */
+Datum plcontainer_client_stats(PG_FUNCTION_ARGS) {
+    FuncCallContext        *funcctx;
+    plcClientFunctionStats *functions;
+
+    if (SRF_IS_FIRSTCALL()) {
+        MemoryContext  oldcontext;
+        TupleDesc      tupdesc;
+        plcMsgStats   *stats;
+        plcConn       *conn;
+        char          *name;
+        int            nfunctions = 0;
+        int            slot;
+        int            i;
+
+        plc_check_call_depth();
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE) {
+            elog(ERROR, "Return type must be a row type");
+        }
+        funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+
+        functions = NULL;
+        for (slot = 0; slot < CONTAINER_NUMBER; slot++) {
+            conn = get_container_conn(slot, &name);
+            if (conn == NULL || conn->version < PLC_PROTOCOL_VERSION_TYPED) {
+                continue;
+            }
+
+            stats = plc_request_client_stats(conn);
+            if (stats->nfunctions > 0) {
+                functions = (functions == NULL)
+                    ? palloc((nfunctions + stats->nfunctions) * sizeof(plcClientFunctionStats))
+                    : repalloc(functions, (nfunctions + stats->nfunctions) * sizeof(plcClientFunctionStats));
+                for (i = 0; i < stats->nfunctions; i++) {
+                    functions[nfunctions].container = pstrdup(name);
+                    functions[nfunctions].stats = stats->functions[i];
+                    nfunctions++;
+                }
+            }
+            free_stats(stats);
+        }
+
+        funcctx->user_fctx = functions;
+        funcctx->max_calls = nfunctions;
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    functions = (plcClientFunctionStats*)funcctx->user_fctx;
+
+    if (funcctx->call_cntr < funcctx->max_calls) {
+        plcFunctionStats *stats = &functions[funcctx->call_cntr].stats;
+        char             *values[10];
+        char              oid[16];
+        char              calls[32];
+        char              spiCalls[32];
+        StringInfoData    histogram;
+        HeapTuple         tuple;
+        int               i;
+
+        snprintf(oid, sizeof(oid), "%u", stats->objectid);
+        snprintf(calls, sizeof(calls), "%lld", stats->calls);
+        snprintf(spiCalls, sizeof(spiCalls), "%lld", stats->spiCalls);
+        initStringInfo(&histogram);
+        appendStringInfoChar(&histogram, '{');
+        for (i = 0; i < PLC_STATS_HISTOGRAM_BUCKETS; i++) {
+            appendStringInfo(&histogram, i > 0 ? ",%lld" : "%lld", stats->histogram[i]);
+        }
+        appendStringInfoChar(&histogram, '}');
+
+        values[0] = functions[funcctx->call_cntr].container;
+        values[1] = oid;
+        /* The function might have been dropped since it was called */
+        values[2] = get_func_name((Oid)stats->objectid);
+        values[3] = calls;
+        values[4] = plc_format_time(stats->argumentsTime);
+        values[5] = plc_format_time(stats->executionTime);
+        values[6] = plc_format_time(stats->resultsTime);
+        values[7] = spiCalls;
+        values[8] = plc_format_time(stats->spiTime);
+        values[9] = histogram.data;
+        tuple = BuildTupleFromCStrings(funcctx->attinmeta, values);
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+    }
+
+    SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * Statistics of the calls made by this backend. Segments report the calls
+ * made by the QEs of the session, plcontainer_function_stats() SQL function
+ * collects them from all the segments with gp_dist_random()
+ */
+Datum plcontainer_local_function_stats(PG_FUNCTION_ARGS) {
+    FuncCallContext      *funcctx;
+    plcFunctionCallStats *functions;
+
+    if (SRF_IS_FIRSTCALL()) {
+        MemoryContext         oldcontext;
+        TupleDesc             tupdesc;
+        HASH_SEQ_STATUS       status;
+        plcFunctionCallStats *stats;
+        int                   nfunctions = 0;
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE) {
+            elog(ERROR, "Return type must be a row type");
+        }
+        funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+
+        functions = NULL;
+        if (plcFunctionStatsTable != NULL) {
+            functions = palloc((hash_get_num_entries(plcFunctionStatsTable) + 1)
+                               * sizeof(plcFunctionCallStats));
+            hash_seq_init(&status, plcFunctionStatsTable);
+            while ((stats = (plcFunctionCallStats*)hash_seq_search(&status)) != NULL) {
+                functions[nfunctions++] = *stats;
+            }
+        }
+
+        funcctx->user_fctx = functions;
+        funcctx->max_calls = nfunctions;
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    functions = (plcFunctionCallStats*)funcctx->user_fctx;
+
+    if (funcctx->call_cntr < funcctx->max_calls) {
+        plcFunctionCallStats *stats = &functions[funcctx->call_cntr];
+        char                 *values[13];
+        char                  segment[16];
+        char                  oid[16];
+        char                  calls[32];
+        char                  bytesSent[32];
+        char                  bytesReceived[32];
+        char                  spiCalls[32];
+        char                  logMessages[32];
+        HeapTuple             tuple;
+
+        snprintf(segment, sizeof(segment), "%d", GpIdentity.segindex);
+        snprintf(oid, sizeof(oid), "%u", stats->funcOid);
+        snprintf(calls, sizeof(calls), INT64_FORMAT, stats->calls);
+        snprintf(bytesSent, sizeof(bytesSent), INT64_FORMAT, stats->bytesSent);
+        snprintf(bytesReceived, sizeof(bytesReceived), INT64_FORMAT, stats->bytesReceived);
+        snprintf(spiCalls, sizeof(spiCalls), INT64_FORMAT, stats->spiCalls);
+        snprintf(logMessages, sizeof(logMessages), INT64_FORMAT, stats->logMessages);
+
+        values[0] = segment;
+        values[1] = oid;
+        values[2] = get_func_name(stats->funcOid);
+        values[3] = calls;
+        values[4] = plc_format_time(stats->totalTime);
+        values[5] = plc_format_time(stats->maxTime);
+        values[6] = plc_format_time(stats->encodeTime);
+        values[7] = plc_format_time(stats->receiveTime);
+        values[8] = plc_format_time(stats->decodeTime);
+        values[9] = bytesSent;
+        values[10] = bytesReceived;
+        values[11] = spiCalls;
+        values[12] = logMessages;
+        tuple = BuildTupleFromCStrings(funcctx->attinmeta, values);
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+    }
+
+    SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * Tracing is switched for the backend running the function, clients follow
+ * it with the next call they get. plcontainer_trace() SQL function switches
+ * it on all the segments as well
+ */
+Datum plcontainer_local_trace(PG_FUNCTION_ARGS) {
+    plc_trace_enabled = PG_GETARG_BOOL(0) ? 1 : 0;
+    PG_RETURN_TEXT_P(cstring_to_text(plc_trace_enabled ? "on" : "off"));
+}
+
+/*
+ * Events recorded by this backend and the clients in its containers, each
+ * container is reported as a separate thread of the backend.
+ * plcontainer_trace_dump() SQL function converts them to Chrome trace JSON
+ */
+Datum plcontainer_local_trace_events(PG_FUNCTION_ARGS) {
+    FuncCallContext *funcctx;
+    plcTraceRecord  *records;
+
+    if (SRF_IS_FIRSTCALL()) {
+        MemoryContext  oldcontext;
+        TupleDesc      tupdesc;
+        plcTraceEvent *events;
+        plcMsgTrace   *trace;
+        plcConn       *conn;
+        char          *name;
+        int            nrecords = 0;
+        int            nevents;
+        int            slot;
+
+        plc_check_call_depth();
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE) {
+            elog(ERROR, "Return type must be a row type");
+        }
+        funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+
+        events = plc_trace_events(&nevents);
+        records = plc_add_trace_records(NULL, &nrecords, 0, "backend",
+                                        events, nevents);
+        pfree(events);
+
+        for (slot = 0; slot < CONTAINER_NUMBER; slot++) {
+            conn = get_container_conn(slot, &name);
+            if (conn == NULL || conn->version < PLC_PROTOCOL_VERSION_TYPED) {
+                continue;
+            }
+
+            trace = plc_request_client_trace(conn);
+            records = plc_add_trace_records(records, &nrecords, slot + 1, name,
+                                            trace->events, trace->nevents);
+            free_trace(trace);
+        }
+
+        funcctx->user_fctx = records;
+        funcctx->max_calls = nrecords;
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    records = (plcTraceRecord*)funcctx->user_fctx;
+
+    if (funcctx->call_cntr < funcctx->max_calls) {
+        plcTraceRecord *record = &records[funcctx->call_cntr];
+        char           *values[8];
+        char            segment[16];
+        char            pid[16];
+        char            thread[16];
+        char            seq[16];
+        char            phase[2];
+        char            ts[32];
+        HeapTuple       tuple;
+
+        snprintf(segment, sizeof(segment), "%d", GpIdentity.segindex);
+        snprintf(pid, sizeof(pid), "%d", MyProcPid);
+        snprintf(thread, sizeof(thread), "%d", record->thread);
+        snprintf(seq, sizeof(seq), "%d", record->seq);
+        snprintf(ts, sizeof(ts), "%lld", record->event.ts);
+        phase[0] = record->event.phase;
+        phase[1] = '\0';
+
+        values[0] = segment;
+        values[1] = pid;
+        values[2] = thread;
+        values[3] = record->threadName;
+        values[4] = seq;
+        values[5] = record->event.name;
+        values[6] = phase;
+        values[7] = ts;
+        tuple = BuildTupleFromCStrings(funcctx->attinmeta, values);
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+    }
+
+    SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * Text quoted for the use as JSON string value. Quotes, backslashes and the
+ * control characters, which are not allowed raw in JSON strings, are escaped
+ */
+Datum plcontainer_json_string(PG_FUNCTION_ARGS) {
+    text          *value = PG_GETARG_TEXT_P(0);
+    char          *data = VARDATA(value);
+    int            len = VARSIZE(value) - VARHDRSZ;
+    StringInfoData buf;
+    int            i;
+
+    initStringInfo(&buf);
+    appendStringInfoChar(&buf, '"');
+    for (i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+
+        switch (c) {
+            case '"':
+                appendStringInfoString(&buf, "\\\"");
+                break;
+            case '\\':
+                appendStringInfoString(&buf, "\\\\");
+                break;
+            case '\b':
+                appendStringInfoString(&buf, "\\b");
+                break;
+            case '\f':
+                appendStringInfoString(&buf, "\\f");
+                break;
+            case '\n':
+                appendStringInfoString(&buf, "\\n");
+                break;
+            case '\r':
+                appendStringInfoString(&buf, "\\r");
+                break;
+            case '\t':
+                appendStringInfoString(&buf, "\\t");
+                break;
+            default:
+                if (c < 0x20) {
+                    appendStringInfo(&buf, "\\u%04x", (unsigned int)c);
+                } else {
+                    appendStringInfoChar(&buf, (char)c);
+                }
+                break;
+        }
+    }
+    appendStringInfoChar(&buf, '"');
+
+    PG_RETURN_TEXT_P(cstring_to_text(buf.data));
+}
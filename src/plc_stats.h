@@ -0,0 +1,57 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef PLC_STATS_H
+#define PLC_STATS_H
+
+#include "postgres.h"
+#include "fmgr.h"
+
+/*
+ * Statistics of the calls of the function made by this backend, times are in
+ * microseconds
+ */
+typedef struct plcFunctionCallStats {
+    Oid    funcOid;        // hash key
+    int64  calls;
+    int64  totalTime;      // from the start of the call till the result is received
+    int64  maxTime;
+    int64  encodeTime;     // creating and sending the call request
+    int64  receiveTime;    // waiting for the messages from the client
+    int64  decodeTime;     // converting the result to the datums
+    int64  bytesSent;
+    int64  bytesReceived;
+    int64  spiCalls;
+    int64  logMessages;
+} plcFunctionCallStats;
+
+/* Monotonic clock for the statistics in microseconds */
+int64 plc_stats_clock(void);
+
+/* Statistics entry of the function, created on the first call */
+plcFunctionCallStats *plc_function_call_stats(Oid funcOid);
+
+/* Statistics of the functions called by this backend */
+Datum plcontainer_local_function_stats(PG_FUNCTION_ARGS);
+
+/* Counters of the clients running in the containers started by the session */
+Datum plcontainer_client_counters(PG_FUNCTION_ARGS);
+
+/* Execution profiles of the functions run by these clients */
+Datum plcontainer_client_stats(PG_FUNCTION_ARGS);
+
+/* Switches the tracing of the calls made by this backend and its clients */
+Datum plcontainer_local_trace(PG_FUNCTION_ARGS);
+
+/* Trace events recorded by this backend and its clients */
+Datum plcontainer_local_trace_events(PG_FUNCTION_ARGS);
+
+/* Text quoted and escaped for the use as JSON string value */
+Datum plcontainer_json_string(PG_FUNCTION_ARGS);
+
+#endif /* PLC_STATS_H */
@@ -10,13 +10,18 @@
 /* Greenplum headers */
 #include "postgres.h"
 #include "fmgr.h"
+#include "access/heapam.h"
 #include "access/transam.h"
 #include "access/tupmacs.h"
 #include "executor/spi.h"
+#include "mb/pg_wchar.h"
 #include "parser/parse_type.h"
 #include "utils/fmgroids.h"
+#include "utils/memutils.h"
 #include "utils/array.h"
+#include "utils/date.h"
 #include "utils/lsyscache.h"
+#include "utils/timestamp.h"
 #include "utils/typcache.h"
 
 #include "plcontainer.h"
@@ -26,6 +31,7 @@
 
 static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type,
                                  bool isArrayElement, bool isUDTElement);
+static bool plc_type_use_binary_io(Oid typeOid, Form_pg_type typeStruct);
 
 static char *plc_datum_as_int1(Datum input, plcTypeInfo *type);
 static char *plc_datum_as_int2(Datum input, plcTypeInfo *type);
@@ -35,8 +41,18 @@ static char *plc_datum_as_float4(Datum input, plcTypeInfo *type);
 static char *plc_datum_as_float8(Datum input, plcTypeInfo *type);
 static char *plc_datum_as_float8_numeric(Datum input, plcTypeInfo *type);
 static char *plc_datum_as_text(Datum input, plcTypeInfo *type);
+static char *plc_datum_as_text_varlena(Datum input, plcTypeInfo *type);
 static char *plc_datum_as_bytea(Datum input, plcTypeInfo *type);
+static char *plc_datum_as_binary(Datum input, plcTypeInfo *type);
+static char *plc_datum_as_timestamp(Datum input, plcTypeInfo *type);
+static char *plc_datum_as_date(Datum input, plcTypeInfo *type);
+static char *plc_datum_as_time(Datum input, plcTypeInfo *type);
+static char *plc_datum_as_interval(Datum input, plcTypeInfo *type);
+#ifdef UUIDOID
+static char *plc_datum_as_uuid(Datum input, plcTypeInfo *type);
+#endif
 static char *plc_datum_as_array(Datum input, plcTypeInfo *type);
+static bool plc_is_raw_fixed_width(plcTypeInfo *type);
 static void plc_backend_array_free(plcIterator *iter);
 static rawdata *plc_backend_array_next(plcIterator *self);
 static char *plc_datum_as_udt(Datum input, plcTypeInfo *type);
@@ -49,10 +65,23 @@ static Datum plc_datum_from_float4(char *input, plcTypeInfo *type);
 static Datum plc_datum_from_float8(char *input, plcTypeInfo *type);
 static Datum plc_datum_from_float8_numeric(char *input, plcTypeInfo *type);
 static Datum plc_datum_from_text(char *input, plcTypeInfo *type);
+#if defined(JSONOID) || defined(JSONBOID)
 static Datum plc_datum_from_text_ptr(char *input, plcTypeInfo *type);
+#endif
+static Datum plc_datum_from_text_varlena(char *input, plcTypeInfo *type);
 static Datum plc_datum_from_bytea(char *input, plcTypeInfo *type);
-static Datum plc_datum_from_bytea_ptr(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_binary(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_binary_ptr(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_temporal_text(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_timestamp(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_date(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_time(char *input, plcTypeInfo *type);
+static Datum plc_datum_from_interval(char *input, plcTypeInfo *type);
+#ifdef UUIDOID
+static Datum plc_datum_from_uuid(char *input, plcTypeInfo *type);
+#endif
 static Datum plc_datum_from_array(char *input, plcTypeInfo *type);
+static ArrayType *plc_varlena_array_from_blob(plcArray *arr, plcTypeInfo *subType, int *lbs);
 static Datum plc_datum_from_udt(char *input, plcTypeInfo *type);
 static Datum plc_datum_from_udt_ptr(char *input, plcTypeInfo *type);
 
@@ -60,14 +89,12 @@ static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeIn
     HeapTuple     typeTup;
     Form_pg_type  typeStruct;
     char          dummy_delim;
-    Oid           typioparam;
 
     typeTup = SearchSysCache(TYPEOID, typeOid, 0, 0, 0);
     if (!HeapTupleIsValid(typeTup))
         elog(ERROR, "cache lookup failed for type %u", typeOid);
 
     typeStruct = (Form_pg_type)GETSTRUCT(typeTup);
-    ReleaseSysCache(typeTup);
 
     type->typeOid = typeOid;
     type->output  = typeStruct->typoutput;
@@ -75,7 +102,7 @@ static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeIn
     get_type_io_data(typeOid, IOFunc_input,
                      &type->typlen, &type->typbyval, &type->typalign,
                      &dummy_delim,
-                     &typioparam, &type->input);
+                     &type->typioparam, &type->input);
     type->typmod = typeStruct->typtypmod;
     type->nSubTypes = 0;
     type->subTypes = NULL;
@@ -88,6 +115,11 @@ static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeIn
     type->typrel_xmin = InvalidTransactionId;
     ItemPointerSetInvalid(&type->typrel_tid);
     type->typeName = NULL;
+    type->pgTypeName = NULL;
+    type->tupdesc = NULL;
+    type->nNonDropped = 0;
+    type->values = NULL;
+    type->nulls = NULL;
 
     switch(typeOid) {
         case BOOLOID:
@@ -125,19 +157,60 @@ static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeIn
             type->outfunc = plc_datum_as_float8_numeric;
             type->infunc = plc_datum_from_float8_numeric;
             break;
+        /* Plain text types are copied to and from varlena directly */
+        case TEXTOID:
+        case VARCHAROID:
+            type->type = PLC_DATA_TEXT;
+            type->outfunc = plc_datum_as_text_varlena;
+            type->infunc = plc_datum_from_text_varlena;
+            break;
         case BYTEAOID:
             type->type = PLC_DATA_BYTEA;
             type->outfunc = plc_datum_as_bytea;
-            if (!isArrayElement) {
-                type->infunc = plc_datum_from_bytea;
-            } else {
-                type->infunc = plc_datum_from_bytea_ptr;
-            }
+            type->infunc = plc_datum_from_bytea;
             break;
-        /* All the other types are passed through in-out functions to translate
-         * them to text before sending and after receiving */
-        default:
-            type->type = PLC_DATA_TEXT;
+        case TIMESTAMPOID:
+            type->type = PLC_DATA_TIMESTAMP;
+            type->outfunc = plc_datum_as_timestamp;
+            type->infunc = plc_datum_from_timestamp;
+            break;
+        case TIMESTAMPTZOID:
+            type->type = PLC_DATA_TIMESTAMPTZ;
+            type->outfunc = plc_datum_as_timestamp;
+            type->infunc = plc_datum_from_timestamp;
+            break;
+        case DATEOID:
+            type->type = PLC_DATA_DATE;
+            type->outfunc = plc_datum_as_date;
+            type->infunc = plc_datum_from_date;
+            break;
+        case TIMEOID:
+            type->type = PLC_DATA_TIME;
+            type->outfunc = plc_datum_as_time;
+            type->infunc = plc_datum_from_time;
+            break;
+        case INTERVALOID:
+            type->type = PLC_DATA_INTERVAL;
+            type->outfunc = plc_datum_as_interval;
+            type->infunc = plc_datum_from_interval;
+            break;
+#ifdef UUIDOID
+        case UUIDOID:
+            type->type = PLC_DATA_UUID;
+            type->outfunc = plc_datum_as_uuid;
+            type->infunc = plc_datum_from_uuid;
+            break;
+#endif
+#ifdef JSONOID
+        case JSONOID:
+#endif
+#ifdef JSONBOID
+        case JSONBOID:
+#endif
+#if defined(JSONOID) || defined(JSONBOID)
+            /* JSON documents are passed as text, but tagged so that the client
+             * could parse them into native objects */
+            type->type = PLC_DATA_JSON;
             type->outfunc = plc_datum_as_text;
             if (!isArrayElement) {
                 type->infunc = plc_datum_from_text;
@@ -145,6 +218,28 @@ static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeIn
                 type->infunc = plc_datum_from_text_ptr;
             }
             break;
+#endif
+        /* All the other types are passed in their binary send/receive format
+         * when the type supports it, or through in-out functions to translate
+         * them to text before sending and after receiving otherwise */
+        default:
+            if (plc_type_use_binary_io(typeOid, typeStruct)) {
+                type->type = PLC_DATA_BINARY;
+                type->outfunc = plc_datum_as_binary;
+                if (!isArrayElement) {
+                    type->infunc = plc_datum_from_binary;
+                } else {
+                    type->infunc = plc_datum_from_binary_ptr;
+                }
+                fmgr_info_cxt(typeStruct->typsend, &type->send_finfo, TopMemoryContext);
+                fmgr_info_cxt(typeStruct->typreceive, &type->recv_finfo, TopMemoryContext);
+                type->pgTypeName = plc_top_strdup(NameStr(typeStruct->typname));
+                break;
+            }
+            type->type = PLC_DATA_TEXT;
+            type->outfunc = plc_datum_as_text;
+            type->infunc = plc_datum_from_text;
+            break;
     }
 
     /* Processing arrays here */
@@ -159,7 +254,8 @@ static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeIn
 
     /* Processing composite types - only first level is supported */
     if (!isUDTElement) {
-        TupleDesc desc;
+        TupleDesc     desc;
+        MemoryContext oldContext;
 
         if (typeOid == RECORDOID) {
             if (fcinfo == NULL || get_call_result_type(fcinfo, NULL, &desc) != TYPEFUNC_COMPOSITE) {
@@ -219,19 +315,74 @@ static void fill_type_info_inner(FunctionCallInfo fcinfo, Oid typeOid, plcTypeIn
             type->subTypes = (plcTypeInfo*)plc_top_alloc(type->nSubTypes * sizeof(plcTypeInfo));
             memset(type->subTypes, 0, type->nSubTypes * sizeof(plcTypeInfo));
 
+            // Keep our own copy of the row descriptor for the lifetime of the type info
+            oldContext = MemoryContextSwitchTo(TopMemoryContext);
+            type->tupdesc = CreateTupleDescCopy(desc);
+            MemoryContextSwitchTo(oldContext);
+            type->values = (Datum*)plc_top_alloc(type->nSubTypes * sizeof(Datum));
+            type->nulls = (bool*)plc_top_alloc(type->nSubTypes * sizeof(bool));
+
             // Fill all the subtypes
             for (i = 0; i < desc->natts; i++) {
                 type->subTypes[i].attisdropped = desc->attrs[i]->attisdropped;
                 if (!type->subTypes[i].attisdropped) {
                     /* We support the case with array of UDTs, each of which contains another array */
                     fill_type_info_inner(fcinfo, desc->attrs[i]->atttypid, &type->subTypes[i], false, true);
+                    type->nNonDropped += 1;
                 }
                 type->subTypes[i].typeName = plc_top_strdup(NameStr(desc->attrs[i]->attname));
+                type->values[i] = (Datum) 0;
+                type->nulls[i] = true;
             }
 
             ReleaseTupleDesc(desc);
         }
     }
+
+    ReleaseSysCache(typeTup);
+}
+
+/*
+ * Binary I/O is used only for plain base (and range) types with both send and
+ * receive functions. Character types, for which text is the natural client
+ * representation, domains, which must have their constraints checked by the
+ * input function, enums and pseudo-types keep using the text I/O.
+ */
+static bool plc_type_use_binary_io(Oid typeOid, Form_pg_type typeStruct) {
+    if (typeStruct->typtype != TYPTYPE_BASE
+#ifdef TYPTYPE_RANGE
+            && typeStruct->typtype != TYPTYPE_RANGE
+#endif
+            ) {
+        return false;
+    }
+
+    if (!OidIsValid(typeStruct->typsend) || !OidIsValid(typeStruct->typreceive)) {
+        return false;
+    }
+
+    /* Arrays are processed separately */
+    if (typeStruct->typelem != 0 && typeStruct->typoutput == F_ARRAY_OUT) {
+        return false;
+    }
+
+    switch (typeOid) {
+        case TEXTOID:
+        case VARCHAROID:
+        case BPCHAROID:
+        case NAMEOID:
+        case CHAROID:
+        case UNKNOWNOID:
+        case REFCURSOROID:
+#ifdef XMLOID
+        case XMLOID:
+#endif
+            return false;
+        default:
+            break;
+    }
+
+    return true;
 }
 
 void fill_type_info(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type) {
@@ -246,6 +397,11 @@ void copy_type_info(plcType *type, plcTypeInfo *ptype) {
     } else {
         type->typeName = NULL;
     }
+    if (ptype->type == PLC_DATA_BINARY) {
+        type->pgTypeName = pstrdup(ptype->pgTypeName);
+    } else {
+        type->pgTypeName = NULL;
+    }
     if (ptype->nSubTypes > 0) {
         int i, j;
 
@@ -274,6 +430,16 @@ void free_type_info(plcTypeInfo *type) {
         pfree(type->typeName);
     }
 
+    if (type->pgTypeName != NULL) {
+        pfree(type->pgTypeName);
+    }
+
+    if (type->tupdesc != NULL) {
+        FreeTupleDesc(type->tupdesc);
+        pfree(type->values);
+        pfree(type->nulls);
+    }
+
     for (i = 0; i < type->nSubTypes; i++) {
         free_type_info(&type->subTypes[i]);
     }
@@ -283,6 +449,36 @@ void free_type_info(plcTypeInfo *type) {
     }
 }
 
+/*
+ * Switches the types the clients of the text protocol do not know to be
+ * passed as text through the in-out functions, the way all the types but
+ * the numbers, text and bytea were passed before the typed protocol
+ */
+void plc_type_info_use_text(plcTypeInfo *type) {
+    int i;
+
+    switch (type->type) {
+        case PLC_DATA_TIMESTAMP:
+        case PLC_DATA_TIMESTAMPTZ:
+        case PLC_DATA_DATE:
+        case PLC_DATA_TIME:
+        case PLC_DATA_INTERVAL:
+        case PLC_DATA_UUID:
+        case PLC_DATA_JSON:
+        case PLC_DATA_BINARY:
+            type->type = PLC_DATA_TEXT;
+            type->outfunc = plc_datum_as_text;
+            type->infunc = plc_datum_from_text;
+            break;
+        default:
+            break;
+    }
+
+    for (i = 0; i < type->nSubTypes; i++) {
+        plc_type_info_use_text(&type->subTypes[i]);
+    }
+}
+
 static char *plc_datum_as_int1(Datum input, plcTypeInfo *type UNUSED) {
     char *out = (char*)pmalloc(1);
     *((char*)out) = DatumGetBool(input);
@@ -328,10 +524,21 @@ static char *plc_datum_as_float8_numeric(Datum input, plcTypeInfo *type UNUSED)
 }
 
 static char *plc_datum_as_text(Datum input, plcTypeInfo *type) {
-    return DatumGetCString(OidFunctionCall3(type->output,
-                                            input,
-                                            type->typelem,
-                                            type->typmod));
+    char *str;
+    char *out;
+
+    str = DatumGetCString(OidFunctionCall3(type->output,
+                                           input,
+                                           type->typelem,
+                                           type->typmod));
+    out = plc_alloc_text(str, strlen(str));
+    pfree(str);
+    return out;
+}
+
+static char *plc_datum_as_text_varlena(Datum input, plcTypeInfo *type UNUSED) {
+    text *txt = DatumGetTextP(input);
+    return plc_alloc_text(VARDATA(txt), VARSIZE(txt) - VARHDRSZ);
 }
 
 static char *plc_datum_as_bytea(Datum input, plcTypeInfo *type) {
@@ -343,6 +550,82 @@ static char *plc_datum_as_bytea(Datum input, plcTypeInfo *type) {
     return out;
 }
 
+static char *plc_datum_as_binary(Datum input, plcTypeInfo *type) {
+    bytea *bin = SendFunctionCall(&type->send_finfo, input);
+    int len = VARSIZE(bin) - VARHDRSZ;
+    char *out = (char*)pmalloc(len + 5);
+    *((int*)out) = len + 1;
+    out[4] = PLC_BINARY_FORMAT_BINARY;
+    memcpy(out + 5, VARDATA(bin), len);
+    pfree(bin);
+    return out;
+}
+
+/* Timestamps and timestamptz are sent as int64 microseconds since the
+ * PostgreSQL epoch, timestamptz value is always in UTC */
+static char *plc_datum_as_timestamp(Datum input, plcTypeInfo *type UNUSED) {
+    char *out = (char*)pmalloc(8);
+#ifdef HAVE_INT64_TIMESTAMP
+    *((int64*)out) = DatumGetTimestamp(input);
+#else
+    *((int64*)out) = (int64)rint(DatumGetTimestamp(input) * USECS_PER_SEC);
+#endif
+    return out;
+}
+
+static char *plc_datum_as_date(Datum input, plcTypeInfo *type UNUSED) {
+    char *out = (char*)pmalloc(4);
+    *((int32*)out) = DatumGetDateADT(input);
+    return out;
+}
+
+static char *plc_datum_as_time(Datum input, plcTypeInfo *type UNUSED) {
+    char *out = (char*)pmalloc(8);
+#ifdef HAVE_INT64_TIMESTAMP
+    *((int64*)out) = DatumGetTimeADT(input);
+#else
+    *((int64*)out) = (int64)rint(DatumGetTimeADT(input) * USECS_PER_SEC);
+#endif
+    return out;
+}
+
+static char *plc_datum_as_interval(Datum input, plcTypeInfo *type UNUSED) {
+    Interval    *span = DatumGetIntervalP(input);
+    plcInterval *out = (plcInterval*)pmalloc(sizeof(plcInterval));
+#ifdef HAVE_INT64_TIMESTAMP
+    out->time = span->time;
+#else
+    out->time = (int64)rint(span->time * USECS_PER_SEC);
+#endif
+    out->day = span->day;
+    out->month = span->month;
+    out->format = PLC_BINARY_FORMAT_BINARY;
+    return (char*)out;
+}
+
+#ifdef UUIDOID
+static char *plc_datum_as_uuid(Datum input, plcTypeInfo *type UNUSED) {
+    char *out = (char*)pmalloc(PLC_UUID_LEN);
+    memcpy(out, DatumGetPointer(input), PLC_UUID_LEN);
+    return out;
+}
+#endif
+
+/* Whether the in-memory representation of the type matches the one we send,
+ * which is true for the fixed-width types we copy as is */
+static bool plc_is_raw_fixed_width(plcTypeInfo *type) {
+    return type->outfunc == plc_datum_as_int1
+        || type->outfunc == plc_datum_as_int2
+        || type->outfunc == plc_datum_as_int4
+        || type->outfunc == plc_datum_as_int8
+        || type->outfunc == plc_datum_as_float4
+        || type->outfunc == plc_datum_as_float8
+#ifdef UUIDOID
+        || type->outfunc == plc_datum_as_uuid
+#endif
+        ;
+}
+
 static char *plc_datum_as_array(Datum input, plcTypeInfo *type) {
     ArrayType          *array = DatumGetArrayTypeP(input);
     plcIterator        *iter;
@@ -371,6 +654,13 @@ static char *plc_datum_as_array(Datum input, plcTypeInfo *type) {
     iter->next = plc_backend_array_next;
     iter->cleanup = plc_backend_array_free;
 
+    /* Values of the array without nulls that are stored in the same way we
+     * send them go to the client right from the array data */
+    iter->values = NULL;
+    if (pos->bitmap == NULL && plc_is_raw_fixed_width(&type->subTypes[0])) {
+        iter->values = ARR_DATA_PTR(array);
+    }
+
     return (char*)iter;
 }
 
@@ -421,43 +711,53 @@ static rawdata *plc_backend_array_next(plcIterator *self) {
     return res;
 }
 
-/*
-HeapTupleData rec_data;
-rec_data.t_len = HeapTupleHeaderGetDatumLength(rec_header);
-ItemPointerSetInvalid(&(rec_data.t_self));
-rec_data.t_tableOid = InvalidOid;
-rec_data.t_data = rec_header;
-vattr = heap_getattr(&rec_data, (i + 1), type->tupleDesc, &is_null);
-*/
 static char *plc_datum_as_udt(Datum input, plcTypeInfo *type) {
     HeapTupleHeader rec_header;
+    HeapTupleData   tuple;
+    TupleDesc       desc;
     plcUDT         *res;
     int             i, j;
-    int             nNonDropped = 0;
 
-    for (i = 0; i < type->nSubTypes; i++) {
-        if (!type->subTypes[i].attisdropped) {
-            nNonDropped += 1;
+    res = plc_alloc_udt(type->nNonDropped);
+
+    rec_header = DatumGetHeapTupleHeader(input);
+
+    /* Anonymous records might come with a row type different from the cached one */
+    desc = type->tupdesc;
+    if (HeapTupleHeaderGetTypeId(rec_header) != desc->tdtypeid
+            || HeapTupleHeaderGetTypMod(rec_header) != desc->tdtypmod) {
+        desc = lookup_rowtype_tupdesc(HeapTupleHeaderGetTypeId(rec_header),
+                                      HeapTupleHeaderGetTypMod(rec_header));
+        if (desc->natts != type->nSubTypes) {
+            ReleaseTupleDesc(desc);
+            elog(ERROR, "row type of the value does not match the expected row type");
         }
     }
 
-    res = plc_alloc_udt(nNonDropped);
+    /* Extract all the attributes at once */
+    tuple.t_len = HeapTupleHeaderGetDatumLength(rec_header);
+    ItemPointerSetInvalid(&(tuple.t_self));
+    tuple.t_data = rec_header;
+    heap_deform_tuple(&tuple, desc, type->values, type->nulls);
 
-    rec_header = DatumGetHeapTupleHeader(input);
-    for (i = 0, j = 0; i < type->nSubTypes; i++) {
-        Datum  vattr;
-        bool   is_null;
+    if (desc != type->tupdesc) {
+        ReleaseTupleDesc(desc);
+    }
 
+    for (i = 0, j = 0; i < type->nSubTypes; i++) {
         if (!type->subTypes[i].attisdropped) {
-            vattr = GetAttributeByNum(rec_header, (i + 1), &is_null);
-            if (is_null) {
+            if (type->nulls[i]) {
                 res->data[j].isnull = true;
                 res->data[j].value = NULL;
             } else {
                 res->data[j].isnull = false;
-                res->data[j].value = type->subTypes[i].outfunc(vattr, &type->subTypes[i]);
+                res->data[j].value = type->subTypes[i].outfunc(type->values[i], &type->subTypes[i]);
             }
             j += 1;
+        } else {
+            /* Old rows might still contain the values of dropped attributes */
+            type->nulls[i] = true;
+            type->values[i] = (Datum) 0;
         }
     }
 
@@ -495,16 +795,34 @@ static Datum plc_datum_from_float8_numeric(char *input, plcTypeInfo *type UNUSED
 
 static Datum plc_datum_from_text(char *input, plcTypeInfo *type) {
     return OidFunctionCall3(type->input,
-                            CStringGetDatum(input),
+                            CStringGetDatum(input + 4),
                             type->typelem,
                             type->typmod);
 }
 
+#if defined(JSONOID) || defined(JSONBOID)
 static Datum plc_datum_from_text_ptr(char *input, plcTypeInfo *type) {
-    return OidFunctionCall3(type->input,
-                            CStringGetDatum( *((char**)input) ),
-                            type->typelem,
-                            type->typmod);
+    return plc_datum_from_text( *((char**)input), type );
+}
+#endif
+
+static Datum plc_datum_from_text_varlena(char *input, plcTypeInfo *type UNUSED) {
+    int   size = *((int*)input);
+    char *zero;
+    text *result;
+
+    /* Input function would stop at the first zero byte, so do we */
+    zero = memchr(input + 4, '\0', size);
+    if (zero != NULL) {
+        size = zero - (input + 4);
+    }
+    /* and check the encoding of the value like textin does */
+    pg_verifymbstr(input + 4, size, false);
+
+    result = palloc(size + VARHDRSZ);
+    SET_VARSIZE(result, size + VARHDRSZ);
+    memcpy(VARDATA(result), input + 4, size);
+    return PointerGetDatum(result);
 }
 
 static Datum plc_datum_from_bytea(char *input, plcTypeInfo *type) {
@@ -516,9 +834,116 @@ static Datum plc_datum_from_bytea(char *input, plcTypeInfo *type) {
     return PointerGetDatum(result);
 }
 
-static Datum plc_datum_from_bytea_ptr(char *input, plcTypeInfo *type) {
-    return plc_datum_from_bytea( *((char**)input), type );
+/* Binary value consists of the format byte followed by the representation of
+ * the value in this format, the whole thing is stored the same way as bytea */
+static Datum plc_datum_from_binary(char *input, plcTypeInfo *type) {
+    int   size = *((int*)input) - 1;
+    char  format;
+    char *data;
+    Datum result;
+
+    if (size < 0) {
+        elog(ERROR, "received binary value of type \"%s\" without format", type->pgTypeName);
+    }
+    format = input[4];
+
+    /* Both input and receive functions expect the data to be null-terminated */
+    data = palloc(size + 1);
+    memcpy(data, input + 5, size);
+    data[size] = '\0';
+
+    if (format == PLC_BINARY_FORMAT_BINARY) {
+        StringInfoData buf;
+
+        buf.data = data;
+        buf.len = size;
+        buf.maxlen = size + 1;
+        buf.cursor = 0;
+        result = ReceiveFunctionCall(&type->recv_finfo, &buf, type->typioparam, type->typmod);
+        if (buf.cursor != buf.len) {
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                     errmsg("incorrect binary data format for type \"%s\"", type->pgTypeName)));
+        }
+    } else if (format == PLC_BINARY_FORMAT_TEXT) {
+        result = OidFunctionCall3(type->input,
+                                  CStringGetDatum(data),
+                                  type->typioparam,
+                                  type->typmod);
+    } else {
+        elog(ERROR, "unknown format '%c' of binary value of type \"%s\"", format, type->pgTypeName);
+    }
+
+    return result;
+}
+
+static Datum plc_datum_from_binary_ptr(char *input, plcTypeInfo *type) {
+    return plc_datum_from_binary( *((char**)input), type );
+}
+
+/* Date or time value the client passed as text goes to the type input
+ * function, so that it is read in the session TimeZone and DateStyle */
+static Datum plc_datum_from_temporal_text(char *input, plcTypeInfo *type) {
+    return OidFunctionCall3(type->input,
+                            CStringGetDatum(input + 4),
+                            type->typelem,
+                            type->typmod);
+}
+
+static Datum plc_datum_from_timestamp(char *input, plcTypeInfo *type) {
+    if (plc_is_temporal_text(type->type, input)) {
+        return plc_datum_from_temporal_text(plc_temporal_text(type->type, input), type);
+    }
+#ifdef HAVE_INT64_TIMESTAMP
+    return TimestampGetDatum(*((int64*)input));
+#else
+    return TimestampGetDatum(((double)*((int64*)input)) / USECS_PER_SEC);
+#endif
+}
+
+static Datum plc_datum_from_date(char *input, plcTypeInfo *type) {
+    if (plc_is_temporal_text(type->type, input)) {
+        return plc_datum_from_temporal_text(plc_temporal_text(type->type, input), type);
+    }
+    return DateADTGetDatum(*((int32*)input));
+}
+
+static Datum plc_datum_from_time(char *input, plcTypeInfo *type) {
+    if (plc_is_temporal_text(type->type, input)) {
+        return plc_datum_from_temporal_text(plc_temporal_text(type->type, input), type);
+    }
+#ifdef HAVE_INT64_TIMESTAMP
+    return TimeADTGetDatum(*((int64*)input));
+#else
+    return TimeADTGetDatum(((double)*((int64*)input)) / USECS_PER_SEC);
+#endif
+}
+
+static Datum plc_datum_from_interval(char *input, plcTypeInfo *type) {
+    plcInterval *iv = (plcInterval*)input;
+    Interval    *span;
+
+    if (plc_is_temporal_text(type->type, input)) {
+        return plc_datum_from_temporal_text(plc_temporal_text(type->type, input), type);
+    }
+    span = (Interval*)palloc(sizeof(Interval));
+#ifdef HAVE_INT64_TIMESTAMP
+    span->time = iv->time;
+#else
+    span->time = ((double)iv->time) / USECS_PER_SEC;
+#endif
+    span->day = iv->day;
+    span->month = iv->month;
+    return IntervalPGetDatum(span);
+}
+
+#ifdef UUIDOID
+static Datum plc_datum_from_uuid(char *input, plcTypeInfo *type UNUSED) {
+    char *uuid = (char*)palloc(PLC_UUID_LEN);
+    memcpy(uuid, input, PLC_UUID_LEN);
+    return PointerGetDatum(uuid);
 }
+#endif
 
 static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
     Datum         dvalue;
@@ -526,9 +951,9 @@ static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
     ArrayType    *array = NULL;
     int          *lbs = NULL;
     int           i;
-    MemoryContext oldContext;
     plcArray     *arr;
     char         *ptr;
+    char         *value;
     int           len;
     plcTypeInfo  *subType;
 
@@ -538,19 +963,33 @@ static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
     for (i = 0; i < arr->meta->ndims; i++)
         lbs[i] = 1;
 
+    /* Plain text and bytea arrays are built right from the received blob */
+    if (arr->offsets != NULL && (subType->infunc == plc_datum_from_text_varlena
+                                 || subType->infunc == plc_datum_from_bytea)) {
+        array = plc_varlena_array_from_blob(arr, subType, lbs);
+        pfree(lbs);
+        return PointerGetDatum(array);
+    }
+
     elems = palloc(arr->meta->size * sizeof(Datum));
     ptr = arr->data;
     len = plc_get_type_length(subType->type);
     for (i = 0; i < arr->meta->size; i++) {
-        if (arr->nulls[i] == 0) {
-            elems[i] = subType->infunc(ptr, subType);
-        } else {
+        if (arr->nulls[i] != 0) {
             elems[i] = (Datum)0;
+        } else if (arr->offsets != NULL) {
+            value = plc_alloc_text(arr->data + arr->offsets[i],
+                                   arr->offsets[i + 1] - arr->offsets[i]);
+            elems[i] = subType->infunc(value, subType);
+            pfree(value);
+        } else if (arr->texts != NULL && arr->texts[i] != NULL) {
+            elems[i] = plc_datum_from_temporal_text(arr->texts[i], subType);
+        } else {
+            elems[i] = subType->infunc(ptr, subType);
         }
         ptr += len;
     }
 
-    oldContext = MemoryContextSwitchTo(pl_container_caller_context);
     array = construct_md_array(elems,
                                arr->nulls,
                                arr->meta->ndims,
@@ -562,7 +1001,6 @@ static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
                                subType->typalign);
 
     dvalue = PointerGetDatum(array);
-    MemoryContextSwitchTo(oldContext);
 
     pfree(lbs);
     pfree(elems);
@@ -570,39 +1008,109 @@ static Datum plc_datum_from_array(char *input, plcTypeInfo *type) {
     return dvalue;
 }
 
+/*
+ * Builds the array of text or bytea elements in a single pass over the
+ * contiguous blob: the size of the result is known from the offsets, so each
+ * element is copied straight into its place without intermediate datums
+ */
+static ArrayType *plc_varlena_array_from_blob(plcArray *arr, plcTypeInfo *subType, int *lbs) {
+    ArrayType *array;
+    int       *sizes;
+    int        ndims = arr->meta->ndims;
+    int        nitems = arr->meta->size;
+    int        nbytes = 0;
+    int        dataoffset = 0;
+    bool       hasnulls = false;
+    bool       istext = (subType->infunc == plc_datum_from_text_varlena);
+    char      *elem;
+    char      *zero;
+    char      *ptr;
+    bits8     *bitmap;
+    int        bitmask;
+    int        i;
+
+    sizes = (int*)palloc(nitems * sizeof(int));
+    for (i = 0; i < nitems; i++) {
+        if (arr->nulls[i] != 0) {
+            hasnulls = true;
+            continue;
+        }
+        elem = arr->data + arr->offsets[i];
+        sizes[i] = arr->offsets[i + 1] - arr->offsets[i];
+        /* Same as for the single text value, stop at the first zero byte */
+        if (istext && (zero = memchr(elem, '\0', sizes[i])) != NULL) {
+            sizes[i] = zero - elem;
+        }
+        if (istext) {
+            pg_verifymbstr(elem, sizes[i], false);
+        }
+        nbytes += sizes[i] + VARHDRSZ;
+        nbytes = att_align_nominal(nbytes, subType->typalign);
+        if (!AllocSizeIsValid(nbytes)) {
+            elog(ERROR, "array size exceeds the maximum allowed (%d)", (int)MaxAllocSize);
+        }
+    }
+
+    if (hasnulls) {
+        dataoffset = ARR_OVERHEAD_WITHNULLS(ndims, nitems);
+        nbytes += dataoffset;
+    } else {
+        nbytes += ARR_OVERHEAD_NONULLS(ndims);
+    }
+
+    array = (ArrayType*)palloc0(nbytes);
+    SET_VARSIZE(array, nbytes);
+    array->ndim = ndims;
+    array->dataoffset = dataoffset;
+    array->elemtype = subType->typeOid;
+    memcpy(ARR_DIMS(array), arr->meta->dims, ndims * sizeof(int));
+    memcpy(ARR_LBOUND(array), lbs, ndims * sizeof(int));
+
+    ptr = ARR_DATA_PTR(array);
+    bitmap = ARR_NULLBITMAP(array);
+    bitmask = 1;
+    for (i = 0; i < nitems; i++) {
+        if (arr->nulls[i] == 0) {
+            if (bitmap != NULL) {
+                *bitmap |= bitmask;
+            }
+            SET_VARSIZE(ptr, sizes[i] + VARHDRSZ);
+            memcpy(VARDATA(ptr), arr->data + arr->offsets[i], sizes[i]);
+            ptr = (char*)att_align_nominal(ptr + sizes[i] + VARHDRSZ, subType->typalign);
+        }
+        if (bitmap != NULL) {
+            bitmask <<= 1;
+            if (bitmask == 0x100) {
+                bitmap++;
+                bitmask = 1;
+            }
+        }
+    }
+
+    pfree(sizes);
+    return array;
+}
+
 static Datum plc_datum_from_udt(char *input, plcTypeInfo *type) {
-    TupleDesc      desc;
     HeapTuple      tuple;
-    Datum         *values;
-    bool          *nulls;
-    volatile int   i, j;
-    MemoryContext  oldContext;
+    int            i, j;
     plcUDT        *udt = (plcUDT*)input;
 
-    /* Build tuple */
-    values = palloc(sizeof(Datum) * type->nSubTypes);
-    nulls = palloc(sizeof(bool) * type->nSubTypes);
+    /* Build tuple, dropped attributes stay null as set on type creation */
     for (i = 0, j = 0; i < type->nSubTypes; ++i) {
         if (!type->subTypes[i].attisdropped) {
             if (udt->data[j].isnull) {
-                nulls[i] = true;
-                values[i] = (Datum) 0;
+                type->nulls[i] = true;
+                type->values[i] = (Datum) 0;
             } else {
-                nulls[i] = false;
-                values[i] = type->subTypes[j].infunc(udt->data[j].value, &type->subTypes[j]);
+                type->nulls[i] = false;
+                type->values[i] = type->subTypes[i].infunc(udt->data[j].value, &type->subTypes[i]);
             }
             j += 1;
         }
     }
 
-    oldContext = MemoryContextSwitchTo(pl_container_caller_context);
-    desc = lookup_rowtype_tupdesc(type->typeOid, type->typmod);
-    tuple = heap_form_tuple(desc, values, nulls);
-    ReleaseTupleDesc(desc);
-    MemoryContextSwitchTo(oldContext);
-
-    pfree(values);
-    pfree(nulls);
+    tuple = heap_form_tuple(type->tupdesc, type->values, type->nulls);
 
     return HeapTupleGetDatum(tuple);
 }
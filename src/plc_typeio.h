@@ -27,13 +27,19 @@ struct plcTypeInfo {
     plcTypeInfo    *subTypes;
 
     /* Custom input and output functions used for most common data types that
-     * allow binary data transfer */
+     * allow binary data transfer. Input functions build the datum in the
+     * current memory context */
     plcDatumOutput  outfunc;
     plcDatumInput   infunc;
 
     /* GPDB in- and out- functions to transform custom types to text and back */
     RegProcedure    output, input;
 
+    /* Binary send and receive functions for the types passed as PLC_DATA_BINARY */
+    FmgrInfo        send_finfo, recv_finfo;
+    Oid             typioparam;
+    char           *pgTypeName;
+
     /* Information used for type input/output operations */
     Oid             typeOid;
     Oid             typelem;
@@ -50,6 +56,13 @@ struct plcTypeInfo {
     TransactionId   typrel_xmin;
     ItemPointerData typrel_tid;
     char           *typeName;
+
+    /* Row descriptor and buffers for deforming and forming the rows, dropped
+     * attributes are always null in the buffers */
+    TupleDesc       tupdesc;
+    int             nNonDropped;
+    Datum          *values;
+    bool           *nulls;
 };
 
 typedef struct plcPgArrayPosition {
@@ -61,6 +74,7 @@ typedef struct plcPgArrayPosition {
 void fill_type_info(FunctionCallInfo fcinfo, Oid typeOid, plcTypeInfo *type);
 void copy_type_info(plcType *type, plcTypeInfo *ptype);
 void free_type_info(plcTypeInfo *type);
+void plc_type_info_use_text(plcTypeInfo *type);
 char *fill_type_value(Datum funcArg, plcTypeInfo *argType);
 
 #endif /* PLC_TYPEIO_H */
@@ -0,0 +1,93 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "postgres.h"
+#if PG_VERSION_NUM >= 100000
+#include "pgstat.h"
+#endif
+#include "utils/ps_status.h"
+
+#include "plc_wait.h"
+
+/* Maximum length of the process title activity kept during the wait */
+#define PLC_WAIT_ACTIVITY_SIZE 256
+
+static const char *plcWaitNames[] = {
+    NULL,
+    "starting container",
+    "waiting for ping",
+    "sending arguments",
+    "waiting for result",
+    "serving SPI"
+};
+
+static plcWaitState plcWaitCurrent = PLC_WAIT_NONE;
+static char         plcWaitActivity[PLC_WAIT_ACTIVITY_SIZE];
+
+static void plc_wait_report(plcWaitState state);
+
+/*
+ * Servers with wait events show the backend waiting for an extension in
+ * pg_stat_activity. The state itself is appended to the activity shown in
+ * the process title, which is the only place older servers can show it
+ */
+static void plc_wait_report(plcWaitState state) {
+    char title[PLC_WAIT_ACTIVITY_SIZE + 64];
+
+#if PG_VERSION_NUM >= 100000
+    if (state == PLC_WAIT_NONE) {
+        pgstat_report_wait_end();
+    } else {
+        pgstat_report_wait_start(PG_WAIT_EXTENSION);
+    }
+#endif
+
+    if (state == PLC_WAIT_NONE) {
+        snprintf(title, sizeof(title), "%s", plcWaitActivity);
+    } else {
+        snprintf(title, sizeof(title), "%s plcontainer %s", plcWaitActivity,
+                 plcWaitNames[state]);
+    }
+#if PG_VERSION_NUM >= 130000
+    set_ps_display(title);
+#else
+    set_ps_display(title, false);
+#endif
+}
+
+plcWaitState plc_wait_start(plcWaitState state) {
+    plcWaitState previous = plcWaitCurrent;
+    const char  *activity;
+    int          len;
+
+    /* Activity of the query is kept to be restored when the wait is over */
+    if (previous == PLC_WAIT_NONE) {
+        activity = get_ps_display(&len);
+        if (len >= PLC_WAIT_ACTIVITY_SIZE) {
+            len = PLC_WAIT_ACTIVITY_SIZE - 1;
+        }
+        memcpy(plcWaitActivity, activity, len);
+        plcWaitActivity[len] = '\0';
+    }
+
+    plcWaitCurrent = state;
+    plc_wait_report(state);
+    return previous;
+}
+
+void plc_wait_end(plcWaitState previous) {
+    plcWaitCurrent = previous;
+    plc_wait_report(previous);
+}
+
+plcWaitState plc_wait_state(void) {
+    return plcWaitCurrent;
+}
@@ -0,0 +1,31 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef PLC_WAIT_H
+#define PLC_WAIT_H
+
+/* What the backend is doing while it does not run the query itself */
+typedef enum {
+    PLC_WAIT_NONE = 0,
+    PLC_WAIT_CONTAINER_START,
+    PLC_WAIT_PING,
+    PLC_WAIT_SEND_ARGUMENTS,
+    PLC_WAIT_RESULT,
+    PLC_WAIT_SPI
+} plcWaitState;
+
+/* Reports the state of the backend, returns the state it replaces */
+plcWaitState plc_wait_start(plcWaitState state);
+
+/* Restores the state returned by plc_wait_start() */
+void plc_wait_end(plcWaitState previous);
+
+/* State reported at the moment */
+plcWaitState plc_wait_state(void);
+
+#endif /* PLC_WAIT_H */
@@ -17,12 +17,15 @@
 
 /* PLContainer Headers */
 #include "common/comm_channel.h"
+#include "common/comm_trace.h"
 #include "common/messages/messages.h"
 #include "message_fns.h"
 #include "sqlhandler.h"
 #include "containers.h"
 #include "plc_typeio.h"
 #include "plc_configuration.h"
+#include "plc_stats.h"
+#include "plc_wait.h"
 #include "plcontainer.h"
 
 #ifdef PG_MODULE_MAGIC
@@ -31,20 +34,28 @@ PG_MODULE_MAGIC;
 
 PG_FUNCTION_INFO_V1(plcontainer_call_handler);
 
+int plcontainer_call_depth = 0;
+
 static Datum plcontainer_call_hook(PG_FUNCTION_ARGS);
 static plcProcResult *plcontainer_get_result(FunctionCallInfo  fcinfo,
                                              plcProcInfo      *pinfo);
+static plcConn *plcontainer_open_conn(plcConn *conn);
+static void plcontainer_call_done(plcFunctionCallStats *stats, plcConn *conn,
+                                  int64 start, int64 bytesSent, int64 bytesReceived);
 static Datum plcontainer_process_result(FunctionCallInfo  fcinfo,
                                         plcProcInfo      *pinfo,
                                         plcProcResult    *presult);
 static void plcontainer_process_exception(plcMsgError *msg);
-static void plcontainer_process_sql(plcMsgSQL *msg, plcConn* conn);
+static void plcontainer_send_sql_answer(plcConn* conn, plcMessage *res);
+static void plcontainer_process_sql(plcMsgSQL *msg, plcConn* conn, plcProcInfo *pinfo);
 static void plcontainer_process_log(plcMsgLog *log);
 
 Datum plcontainer_call_handler(PG_FUNCTION_ARGS) {
     Datum datumreturn = (Datum) 0;
     MemoryContext oldMC = NULL;
     int ret;
+    int subxactDepth;
+    plcWaitState wait;
 
     /* TODO: handle trigger requests as well */
     if (CALLED_AS_TRIGGER(fcinfo)) {
@@ -66,12 +77,23 @@ Datum plcontainer_call_handler(PG_FUNCTION_ARGS) {
      * requesting the query termination. In this case we should forcefully
      * kill the container and reset its information
      */
+    subxactDepth = get_subtransaction_depth();
+    wait = plc_wait_state();
+    plcontainer_call_depth++;
     PG_TRY();
     {
         datumreturn = plcontainer_call_hook(fcinfo);
+
+        /* Subtransactions the client has not finished are rolled back */
+        release_subtransactions(subxactDepth, false);
     }
     PG_CATCH();
     {
+        plcontainer_call_depth--;
+        /* Wait state of the failed call is not left for the caller */
+        plc_wait_end(wait);
+        release_subtransactions(subxactDepth, true);
+
         /* If the reason is Cancel or Termination */
         if (InterruptPending || QueryCancelPending || QueryFinishPending) {
             //elog(DEBUG1, "Terminating containers due to user request");
@@ -80,6 +102,7 @@ Datum plcontainer_call_handler(PG_FUNCTION_ARGS) {
         PG_RE_THROW();
     }
     PG_END_TRY();
+    plcontainer_call_depth--;
 
     /* Return to old memory context */
     ret = SPI_finish();
@@ -98,6 +121,7 @@ static Datum plcontainer_call_hook(PG_FUNCTION_ARGS) {
     FuncCallContext *volatile funcctx = NULL;
     MemoryContext             oldcontext = NULL;
     plcProcResult            *presult = NULL;
+    int64                     start;
 
     /* By default we return NULL */
     fcinfo->isnull = true;
@@ -143,7 +167,11 @@ static Datum plcontainer_call_hook(PG_FUNCTION_ARGS) {
     }
 
     /* Process the result message from client */
+    plc_trace_begin("result decode");
+    start = plc_stats_clock();
     result = plcontainer_process_result(fcinfo, pinfo, presult);
+    plc_function_call_stats(pinfo->funcOid)->decodeTime += plc_stats_clock() - start;
+    plc_trace_end("result decode");
 
     presult->resrow += 1;
     MemoryContextSwitchTo(oldcontext);
@@ -161,69 +189,154 @@ static Datum plcontainer_call_hook(PG_FUNCTION_ARGS) {
 static plcProcResult *plcontainer_get_result(FunctionCallInfo  fcinfo,
                                              plcProcInfo      *pinfo) {
     char          *name;
-    plcConn       *conn;
+    plcConn       *volatile conn = NULL;
     int            message_type;
     plcMsgCallreq *req    = NULL;
     plcProcResult *result = NULL;
-
-    req = plcontainer_create_call(fcinfo, pinfo);
-    name = parse_container_meta(req->proc.src);
-    conn = find_container(name);
-    if (conn == NULL) {
-        plcContainer *cont = NULL;
-        cont = plc_get_container_config(name);
-        if (cont == NULL) {
-            elog(ERROR, "Container '%s' is not defined in configuration "
-                        "and cannot be used", name);
-        } else {
-            conn = start_container(cont);
+    plcFunctionCallStats *stats;
+    int64          start;
+    int64          mark;
+    volatile int64 bytesSent = 0;
+    volatile int64 bytesReceived = 0;
+    plcWaitState   wait;
+    int            i;
+
+    stats = plc_function_call_stats(pinfo->funcOid);
+    stats->calls += 1;
+    start = plc_stats_clock();
+
+    /* Time and traffic of the failed calls are counted as well */
+    PG_TRY();
+    {
+        name = parse_container_meta(pinfo->src);
+        conn = find_container(name);
+        if (conn == NULL) {
+            plcContainer *cont = NULL;
+            cont = plc_get_container_config(name);
+            if (cont == NULL) {
+                elog(ERROR, "Container '%s' is not defined in configuration "
+                            "and cannot be used", name);
+            } else {
+                conn = start_container(cont);
+            }
         }
-    }
-    pfree(name);
-
-    if (conn != NULL) {
-        plcontainer_channel_send(conn, (plcMessage*)req);
-        free_callreq(req, true, true);
-
-        while (1) {
-            int res = 0;
-            plcMessage *answer;
-
-            res = plcontainer_channel_receive(conn, &answer);
-            if (res < 0) {
-                elog(ERROR, "Error receiving data from the client, %d", res);
-                break;
+        pfree(name);
+
+        if (conn != NULL) {
+            bytesSent = conn->bytesSent;
+            bytesReceived = conn->bytesReceived;
+
+            /* Client of the text protocol gets the types it does not know as text */
+            if (conn->version < PLC_PROTOCOL_VERSION_TYPED) {
+                plc_type_info_use_text(&pinfo->rettype);
+                for (i = 0; i < pinfo->nargs; i++) {
+                    plc_type_info_use_text(&pinfo->argtypes[i]);
+                }
             }
 
-            message_type = answer->msgtype;
-            switch (message_type) {
-                case MT_RESULT:
-                    result = (plcProcResult*)pmalloc(sizeof(plcProcResult));
-                    result->resmsg = (plcMsgResult*)answer;
-                    result->resrow = 0;
+            mark = plc_stats_clock();
+            req = plcontainer_create_call(fcinfo, pinfo);
+            wait = plc_wait_start(PLC_WAIT_SEND_ARGUMENTS);
+            plcontainer_channel_send(conn, (plcMessage*)req);
+            plc_wait_end(wait);
+            free_callreq(req, true, true);
+            stats->encodeTime += plc_stats_clock() - mark;
+
+            while (1) {
+                int res = 0;
+                plcMessage *answer;
+
+                plc_trace_begin("wait result");
+                mark = plc_stats_clock();
+                wait = plc_wait_start(PLC_WAIT_RESULT);
+                res = plcontainer_channel_receive(conn, &answer);
+                plc_wait_end(wait);
+                stats->receiveTime += plc_stats_clock() - mark;
+                plc_trace_end("wait result");
+                if (res < 0) {
+                    elog(ERROR, "Error receiving data from the client, %d", res);
                     break;
-                case MT_EXCEPTION:
-                    plcontainer_process_exception((plcMsgError*)answer);
-                    break;
-                case MT_SQL:
-                    plcontainer_process_sql((plcMsgSQL*)answer, conn);
-                    break;
-                case MT_LOG:
-                    plcontainer_process_log((plcMsgLog*)answer);
-                    break;
-                default:
-                    elog(ERROR, "Received unhandled message with type id %d "
-                    "from client", message_type);
+                }
+
+                message_type = answer->msgtype;
+                switch (message_type) {
+                    case MT_RESULT:
+                        result = (plcProcResult*)pmalloc(sizeof(plcProcResult));
+                        result->resmsg = (plcMsgResult*)answer;
+                        result->resrow = 0;
+                        break;
+                    case MT_EXCEPTION:
+                        plcontainer_process_exception((plcMsgError*)answer);
+                        break;
+                    case MT_SQL:
+                        stats->spiCalls += 1;
+                        plc_trace_begin("SPI");
+                        wait = plc_wait_start(PLC_WAIT_SPI);
+                        plcontainer_process_sql((plcMsgSQL*)answer, conn, pinfo);
+                        plc_wait_end(wait);
+                        plc_trace_end("SPI");
+                        break;
+                    case MT_LOG:
+                        stats->logMessages += 1;
+                        plcontainer_process_log((plcMsgLog*)answer);
+                        break;
+                    default:
+                        elog(ERROR, "Received unhandled message with type id %d "
+                        "from client", message_type);
+                        break;
+                }
+
+                if (message_type != MT_SQL && message_type != MT_LOG)
                     break;
             }
-
-            if (message_type != MT_SQL && message_type != MT_LOG)
-                break;
         }
     }
+    PG_CATCH();
+    {
+        /* Connection might be already closed by the nested call canceled */
+        plcontainer_call_done(stats, plcontainer_open_conn(conn), start,
+                              bytesSent, bytesReceived);
+        PG_RE_THROW();
+    }
+    PG_END_TRY();
+
+    plcontainer_call_done(stats, conn, start, bytesSent, bytesReceived);
     return result;
 }
 
+/* Returns the connection if it is still open, NULL otherwise */
+static plcConn *plcontainer_open_conn(plcConn *conn) {
+    char *name;
+    int   i;
+
+    for (i = 0; conn != NULL && i < CONTAINER_NUMBER; i++) {
+        if (get_container_conn(i, &name) == conn) {
+            return conn;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Adds the time and the traffic of the call to the statistics of the
+ * function. Nested calls of the functions in the same container are included
+ */
+static void plcontainer_call_done(plcFunctionCallStats *stats, plcConn *conn,
+                                  int64 start, int64 bytesSent, int64 bytesReceived) {
+    int64 elapsed;
+
+    if (conn != NULL) {
+        stats->bytesSent += conn->bytesSent - bytesSent;
+        stats->bytesReceived += conn->bytesReceived - bytesReceived;
+    }
+
+    elapsed = plc_stats_clock() - start;
+    stats->totalTime += elapsed;
+    if (elapsed > stats->maxTime) {
+        stats->maxTime = elapsed;
+    }
+}
+
 /*
  * Processing client results message
  */
@@ -232,6 +345,7 @@ static Datum plcontainer_process_result(FunctionCallInfo  fcinfo,
                                         plcProcResult    *presult) {
     Datum         result = (Datum) 0;
     plcMsgResult *resmsg = presult->resmsg;
+    MemoryContext oldcontext;
 
     if (resmsg->cols > 1) {
         elog(ERROR, "Functions returning multiple columns are not supported yet");
@@ -250,9 +364,15 @@ static Datum plcontainer_process_result(FunctionCallInfo  fcinfo,
         return result;
     }
 
+    /*
+     * The value is returned to the caller, so it is built in the context of
+     * the caller, which for the set returning function is reset every row
+     */
     if (resmsg->data[presult->resrow][0].isnull == 0) {
         fcinfo->isnull = false;
+        oldcontext = MemoryContextSwitchTo(pl_container_caller_context);
         result = pinfo->rettype.infunc(resmsg->data[presult->resrow][0].value, &pinfo->rettype);
+        MemoryContextSwitchTo(oldcontext);
     }
 
     return result;
@@ -270,16 +390,7 @@ static void plcontainer_process_log(plcMsgLog *log) {
 /*
  * Processing client SQL query message
  */
-static void plcontainer_process_sql(plcMsgSQL *msg, plcConn* conn) {
-    plcMessage *res;
-    volatile MemoryContext oldcontext;
-    volatile ResourceOwner oldowner;
-
-    oldcontext = CurrentMemoryContext;
-    oldowner = CurrentResourceOwner;
-    MemoryContextSwitchTo(pl_container_caller_context);
-
-    res = handle_sql_message(msg);
+static void plcontainer_send_sql_answer(plcConn* conn, plcMessage *res) {
     if (res != NULL) {
         plcontainer_channel_send(conn, res);
         switch (res->msgtype) {
@@ -295,9 +406,49 @@ static void plcontainer_process_sql(plcMsgSQL *msg, plcConn* conn) {
                       errmsg( "Returning message type '%c' from SPI call is not implemented", res->msgtype)));
         }
     }
+}
+
+static void plcontainer_process_sql(plcMsgSQL *msg, plcConn* conn, plcProcInfo *pinfo) {
+    plcMessage *res;
+    plcSqlType  sqltype = msg->sqltype;
+    volatile MemoryContext oldcontext;
+    volatile ResourceOwner oldowner;
+    int i;
+
+    oldcontext = CurrentMemoryContext;
+    oldowner = CurrentResourceOwner;
+    MemoryContextSwitchTo(pl_container_caller_context);
+
+    if (sqltype == SQL_TYPE_BATCH) {
+        /*
+         * Statements of the batch are executed in order, and the result of
+         * each of them is sent right away, the client reads them all after
+         * sending the batch
+         */
+        for (i = 0; i < msg->nbatch; i++) {
+            if (msg->batch[i]->sqltype != SQL_TYPE_STATEMENT
+                    && msg->batch[i]->sqltype != SQL_TYPE_PEXECUTE) {
+                ereport(ERROR,
+                      (errcode(ERRCODE_RAISE_EXCEPTION),
+                      errmsg("SQL message type %d is not allowed in the batch",
+                             (int)msg->batch[i]->sqltype)));
+            }
+            res = handle_sql_message(msg->batch[i], conn, pinfo->statementSubxacts);
+            plcontainer_send_sql_answer(conn, res);
+        }
+    } else {
+        res = handle_sql_message(msg, conn, pinfo->statementSubxacts);
+        plcontainer_send_sql_answer(conn, res);
+    }
+    free_sql(msg, false, false);
 
     MemoryContextSwitchTo(oldcontext);
-    CurrentResourceOwner = oldowner;
+
+    /* Explicit subtransaction keeps its resource owner till it ends */
+    if (sqltype != SQL_TYPE_SUBXACT_BEGIN && sqltype != SQL_TYPE_SUBXACT_COMMIT
+            && sqltype != SQL_TYPE_SUBXACT_ROLLBACK) {
+        CurrentResourceOwner = oldowner;
+    }
 
     /*
      * AtEOSubXact_SPI() should not have popped any SPI context, but just
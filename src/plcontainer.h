@@ -15,6 +15,9 @@
 
 MemoryContext pl_container_caller_context;
 
+/* Number of PL/Container function calls in progress in this backend */
+extern int plcontainer_call_depth;
+
 /* entrypoint for all plcontainer procedures */
 Datum plcontainer_call_handler(PG_FUNCTION_ARGS);
 
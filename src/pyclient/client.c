@@ -32,18 +32,25 @@ int main(int argc UNUSED, char **argv UNUSED) {
     assert(sizeof(float) == 4);
     assert(sizeof(double) == 8);
 
-    // Bind the socket and start listening the port
-    sock = start_listener();
+    // Python client handles all the types of the typed protocol
+    plc_protocol_version = PLC_PROTOCOL_VERSION_TYPED;
 
-    // Initialize Python
+    // Initialize Python and import the configured modules before listening
+    // the port, so the backend connects to the client that is ready
     status = python_init();
+    if (status == 0) {
+        python_preload();
+    }
+
+    // Bind the socket and start listening the port
+    sock = start_listener();
 
     #ifdef _DEBUG_CLIENT
         // In debug mode we have a cycle of connections with infinite wait time
         while (true) {
             conn = connection_init(sock);
             if (status == 0) {
-                receive_loop(handle_call, conn);
+                receive_loop(handle_call, handle_stats, conn);
             } else {
                 plc_raise_delayed_error();
                 return -1;
@@ -55,7 +62,7 @@ int main(int argc UNUSED, char **argv UNUSED) {
         connection_wait(sock);
         conn = connection_init(sock);
         if (status == 0) {
-            receive_loop(handle_call, conn);
+            receive_loop(handle_call, handle_stats, conn);
         } else {
             plc_raise_delayed_error();
         }
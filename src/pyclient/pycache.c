@@ -8,64 +8,218 @@
 
 #include <Python.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "pycache.h"
 #include "pyconversions.h"
 #include "common/comm_utils.h"
 
-static plcPyFunction **plcPyFuncCache = NULL;
+/*
+ * Cached functions are kept in the hash table by objectid, and in the list
+ * ordered by the time of the last use for the eviction
+ */
+typedef struct plcPyCacheEntry {
+    plcPyFunction          *func;
+    size_t                  size;
+    struct plcPyCacheEntry *hashNext;
+    struct plcPyCacheEntry *lruPrev;
+    struct plcPyCacheEntry *lruNext;
+} plcPyCacheEntry;
+
+static plcPyCacheEntry **plcPyFuncCache = NULL;
+static plcPyCacheEntry  *plcPyFuncLruHead = NULL;
+static plcPyCacheEntry  *plcPyFuncLruTail = NULL;
+static long long         plcPyFuncCacheMaxSize = 0;
+static long long         plcPyFuncCacheMaxMemory = 0;
+static plcPyFunctionCacheStats plcPyFuncCacheStats;
 
-static void plc_py_function_cache_up(int index);
+static void plc_py_function_cache_init(void);
+static plcPyCacheEntry **plc_py_function_cache_bucket(unsigned int objectid);
+static plcPyCacheEntry *plc_py_function_cache_find(unsigned int objectid);
+static size_t plc_py_function_size(plcPyFunction *func);
+static void plc_py_function_cache_unlink(plcPyCacheEntry *entry);
+static void plc_py_function_cache_push(plcPyCacheEntry *entry);
+static void plc_py_function_cache_evict(void);
 
-/* Move up the cache item */
-static void plc_py_function_cache_up(int index) {
-    plcPyFunction *tmp;
+/* Cache limits are taken from PLC_FUNCTION_CACHE_SIZE and
+ * PLC_FUNCTION_CACHE_MEMORY_MB settings */
+static void plc_py_function_cache_init(void) {
+    const char *value;
     int i;
-    if (index > 0) {
-        tmp = plcPyFuncCache[index];
-        for (i = index; i > 0; i--) {
-            plcPyFuncCache[i] = plcPyFuncCache[i-1];
+
+    plcPyFuncCache = malloc(PLC_PY_FUNCTION_CACHE_BUCKETS * sizeof(plcPyCacheEntry*));
+    for (i = 0; i < PLC_PY_FUNCTION_CACHE_BUCKETS; i++) {
+        plcPyFuncCache[i] = NULL;
+    }
+    memset(&plcPyFuncCacheStats, 0, sizeof(plcPyFuncCacheStats));
+
+    value = getenv("PLC_FUNCTION_CACHE_SIZE");
+    plcPyFuncCacheMaxSize = (value != NULL) ? atoll(value) : 0;
+    if (plcPyFuncCacheMaxSize <= 0) {
+        plcPyFuncCacheMaxSize = PLC_PY_FUNCTION_CACHE_SIZE;
+    }
+    value = getenv("PLC_FUNCTION_CACHE_MEMORY_MB");
+    plcPyFuncCacheMaxMemory = (value != NULL) ? atoll(value) * 1024 * 1024 : 0;
+}
+
+static plcPyCacheEntry **plc_py_function_cache_bucket(unsigned int objectid) {
+    /* Knuth's multiplicative hash spreads the sequential objectids */
+    unsigned int hash = objectid * 2654435761U;
+
+    return &plcPyFuncCache[(hash >> 16) & (PLC_PY_FUNCTION_CACHE_BUCKETS - 1)];
+}
+
+static plcPyCacheEntry *plc_py_function_cache_find(unsigned int objectid) {
+    plcPyCacheEntry *entry;
+
+    for (entry = *plc_py_function_cache_bucket(objectid); entry != NULL;
+            entry = entry->hashNext) {
+        if (entry->func->objectid == objectid) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Approximate memory used by the function: its structures, the source and
+ * the code compiled from it, which is accounted as the source size again
+ */
+static size_t plc_py_function_size(plcPyFunction *func) {
+    return sizeof(plcPyCacheEntry) + sizeof(plcPyFunction)
+           + func->nargs * sizeof(plcPyType)
+           + strlen(func->proc.name) + 2 * strlen(func->proc.src);
+}
+
+static void plc_py_function_cache_unlink(plcPyCacheEntry *entry) {
+    if (entry->lruPrev != NULL) {
+        entry->lruPrev->lruNext = entry->lruNext;
+    } else {
+        plcPyFuncLruHead = entry->lruNext;
+    }
+    if (entry->lruNext != NULL) {
+        entry->lruNext->lruPrev = entry->lruPrev;
+    } else {
+        plcPyFuncLruTail = entry->lruPrev;
+    }
+    entry->lruPrev = NULL;
+    entry->lruNext = NULL;
+}
+
+/* Puts the entry to the head of the list as the most recently used */
+static void plc_py_function_cache_push(plcPyCacheEntry *entry) {
+    entry->lruPrev = NULL;
+    entry->lruNext = plcPyFuncLruHead;
+    if (plcPyFuncLruHead != NULL) {
+        plcPyFuncLruHead->lruPrev = entry;
+    }
+    plcPyFuncLruHead = entry;
+    if (plcPyFuncLruTail == NULL) {
+        plcPyFuncLruTail = entry;
+    }
+}
+
+/*
+ * Removes the least recently used functions while the cache is over its
+ * limits. The functions being executed, which is the case for nested calls,
+ * are kept
+ */
+static void plc_py_function_cache_evict(void) {
+    plcPyCacheEntry  *entry = plcPyFuncLruTail;
+    plcPyCacheEntry  *prev;
+    plcPyCacheEntry **link;
+
+    while (entry != NULL
+            && (plcPyFuncCacheStats.entries > plcPyFuncCacheMaxSize
+                || (plcPyFuncCacheMaxMemory > 0
+                    && plcPyFuncCacheStats.memory > plcPyFuncCacheMaxMemory))) {
+        prev = entry->lruPrev;
+        if (entry->func->executing == 0) {
+            for (link = plc_py_function_cache_bucket(entry->func->objectid);
+                    *link != entry; link = &(*link)->hashNext) {
+            }
+            *link = entry->hashNext;
+            plc_py_function_cache_unlink(entry);
+
+            plcPyFuncCacheStats.entries -= 1;
+            plcPyFuncCacheStats.memory -= entry->size;
+            plcPyFuncCacheStats.evictions += 1;
+            plc_py_free_function(entry->func);
+            free(entry);
         }
-        plcPyFuncCache[0] = tmp;
+        entry = prev;
     }
 }
 
 plcPyFunction *plc_py_function_cache_get(unsigned int objectid) {
-    int i;
-    plcPyFunction *resFunc = NULL;
-    /* Initialize all the elements with nulls initially */
+    plcPyCacheEntry *entry;
+
     if (plcPyFuncCache == NULL) {
-        plcPyFuncCache = malloc(PLC_PY_FUNCTION_CACHE_SIZE * sizeof(plcPyFunction));
-        for (i = 0; i < PLC_PY_FUNCTION_CACHE_SIZE; i++) {
-            plcPyFuncCache[i] = NULL;
-        }
+        plc_py_function_cache_init();
     }
-    for (i = 0; i < PLC_PY_FUNCTION_CACHE_SIZE; i++) {
-        if (plcPyFuncCache[i] != NULL &&
-                plcPyFuncCache[i]->objectid == objectid) {
-            resFunc = plcPyFuncCache[i];
-            plc_py_function_cache_up(i);
-            break;
-        }
+
+    entry = plc_py_function_cache_find(objectid);
+    if (entry == NULL) {
+        plcPyFuncCacheStats.misses += 1;
+        return NULL;
+    }
+
+    plcPyFuncCacheStats.hits += 1;
+    if (entry != plcPyFuncLruHead) {
+        plc_py_function_cache_unlink(entry);
+        plc_py_function_cache_push(entry);
     }
-    return resFunc;
+    return entry->func;
 }
 
+/*
+ * Adds the function to the cache. When the function with the same objectid
+ * is already cached it is replaced, and the new version of the function keeps
+ * its SD dictionary. The replaced function that is being executed, which is
+ * the case when it is changed by the nested call, is freed by its last call
+ */
 void plc_py_function_cache_put(plcPyFunction *func) {
-    int i;
-    plcPyFunction *oldFunc;
-    oldFunc = plc_py_function_cache_get(func->objectid);
-    /* If the function is not cached already */
-    if (oldFunc == NULL) {
-        /* If the last element exists we need to free its memory */
-        if (plcPyFuncCache[PLC_PY_FUNCTION_CACHE_SIZE-1] != NULL) {
-            plc_py_free_function(plcPyFuncCache[PLC_PY_FUNCTION_CACHE_SIZE-1]);
-        }
-        /* Move our LRU cache right */
-        for (i = PLC_PY_FUNCTION_CACHE_SIZE-1; i > 0; i--) {
-            plcPyFuncCache[i] = plcPyFuncCache[i-1];
+    plcPyCacheEntry  *entry;
+    plcPyCacheEntry **bucket;
+
+    if (plcPyFuncCache == NULL) {
+        plc_py_function_cache_init();
+    }
+
+    entry = plc_py_function_cache_find(func->objectid);
+    if (entry != NULL) {
+        if (entry->func != func) {
+            Py_DECREF(func->pySD);
+            func->pySD = entry->func->pySD;
+            Py_INCREF(func->pySD);
+            if (entry->func->executing > 0) {
+                entry->func->replaced = 1;
+            } else {
+                plc_py_free_function(entry->func);
+            }
+            entry->func = func;
         }
+        plcPyFuncCacheStats.memory -= entry->size;
+        plc_py_function_cache_unlink(entry);
     } else {
-        plc_py_free_function(oldFunc);
+        entry = malloc(sizeof(plcPyCacheEntry));
+        entry->func = func;
+        bucket = plc_py_function_cache_bucket(func->objectid);
+        entry->hashNext = *bucket;
+        *bucket = entry;
+        plcPyFuncCacheStats.entries += 1;
+    }
+    entry->size = plc_py_function_size(func);
+    plcPyFuncCacheStats.memory += entry->size;
+    plc_py_function_cache_push(entry);
+
+    plc_py_function_cache_evict();
+}
+
+void plc_py_function_cache_stats(plcPyFunctionCacheStats *stats) {
+    if (plcPyFuncCache == NULL) {
+        plc_py_function_cache_init();
     }
-    plcPyFuncCache[0] = func;
+    *stats = plcPyFuncCacheStats;
 }
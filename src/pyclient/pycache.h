@@ -12,9 +12,22 @@
 #include <Python.h>
 #include "pyconversions.h"
 
-#define PLC_PY_FUNCTION_CACHE_SIZE 20
+/* Default maximum number of cached functions, PLC_FUNCTION_CACHE_SIZE setting */
+#define PLC_PY_FUNCTION_CACHE_SIZE 1000
+
+/* Number of hash table buckets, power of 2 */
+#define PLC_PY_FUNCTION_CACHE_BUCKETS 256
+
+typedef struct plcPyFunctionCacheStats {
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long entries;
+    long long memory;
+} plcPyFunctionCacheStats;
 
 plcPyFunction *plc_py_function_cache_get(unsigned int objectid);
 void plc_py_function_cache_put(plcPyFunction *func);
+void plc_py_function_cache_stats(plcPyFunctionCacheStats *stats);
 
 #endif /* PLC_PYCACHE_H */
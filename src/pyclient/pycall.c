@@ -6,29 +6,42 @@
  *------------------------------------------------------------------------------
  */
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include "common/comm_channel.h"
 #include "common/comm_utils.h"
 #include "common/comm_connectivity.h"
+#include "common/comm_trace.h"
 #include "pycall.h"
 #include "pyerror.h"
 #include "pyconversions.h"
 #include "pylogging.h"
 #include "pyspi.h"
 #include "pycache.h"
+#include "pyprofile.h"
 
 #include <Python.h>
 
 plcConn* plcconn_global = NULL;
+int plc_log_level = 0;
+plcPyFunction *plc_py_current_function = NULL;
 
 static char *create_python_func(plcMsgCallreq *req);
 static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc);
 static int process_call_results(plcConn *conn, PyObject *retval, plcPyFunction *pyfunc);
 static int fill_rawdata(rawdata *res, PyObject *retval, plcPyFunction *pyfunc);
+static int bind_function_sd(PyObject *sd);
+static plcPyFunction *compile_python_function(plcMsgCallreq *req);
+static void call_python_function(plcPyFunction *pyfunc, plcConn *conn,
+                                 plcFunctionStats *stats, long long start);
 
 static PyObject *PyMainModule = NULL;
+static PyObject *PyMainDict = NULL;
+/* SD dictionary currently set in the main module */
+static PyObject *PyBoundSD = NULL;
 static PyMethodDef moddef[] = {
     /*
      * logging methods
@@ -44,7 +57,19 @@ static PyMethodDef moddef[] = {
     /*
      * query execution
      */
-    {"execute", plpy_execute, METH_O,      NULL},
+    {"execute", plpy_execute, METH_VARARGS, NULL},
+    {"prepare", plpy_prepare, METH_VARARGS, NULL},
+    {"cursor", plpy_cursor, METH_VARARGS, NULL},
+    {"subtransaction", plpy_subtransaction, METH_NOARGS, NULL},
+    {"insert", plpy_insert, METH_VARARGS, NULL},
+    {"execute_many", plpy_execute_many, METH_VARARGS, NULL},
+    {"execute_async", plpy_execute_async, METH_VARARGS, NULL},
+
+    /*
+     * type conversions
+     */
+    {"register_binary_type", (PyCFunction)(void(*)(void))plpy_register_binary_type,
+                             METH_VARARGS | METH_KEYWORDS, NULL},
 
     {NULL, NULL, 0, NULL}
 };
@@ -103,72 +128,195 @@ int python_init() {
     }
     Py_DECREF(gd);
 
+    /* Borrowed reference, the main module is never unloaded */
+    PyMainDict = dict;
+
     return 0;
 }
 
-void handle_call(plcMsgCallreq *req, plcConn *conn) {
-    PyObject      *retval = NULL;
-    PyObject      *dict = NULL;
-    PyObject      *args = NULL;
-    plcPyFunction *pyfunc = NULL;
+/* Seconds elapsed since the passed time */
+static double python_elapsed(struct timeval *start) {
+    struct timeval now;
 
-    /*
-     * Keep our connection for future calls from Python back to us.
-     */
-    plcconn_global   = conn;
-    plc_sending_data = 0;
-    plc_is_execution_terminated = 0;
+    gettimeofday(&now, NULL);
+    return (double)(now.tv_sec - start->tv_sec)
+           + (double)(now.tv_usec - start->tv_usec) / 1000000.0;
+}
 
-    dict = PyModule_GetDict(PyMainModule); // Returns borrowed reference
-    if (dict == NULL) {
-        raise_execution_error("Cannot get '__main__' module contents in Python");
-        return;
+/*
+ * Runs the warm-up script from PLC_WARMUP_SCRIPT file. The script runs with
+ * its own globals and GD, before any connection is accepted, so it cannot
+ * access the database through plpy. Returns -1 if the script cannot be read
+ * or fails
+ */
+static int python_warmup(const char *path) {
+    FILE     *file;
+    char     *src;
+    long      len;
+    PyObject *dict;
+    PyObject *globals;
+    PyObject *res;
+    int       status = 0;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        lprintf(WARNING, "Cannot open warm-up script '%s': %s", path, strerror(errno));
+        return -1;
     }
 
-    pyfunc = plc_py_function_cache_get(req->objectid);
-
-    if (pyfunc == NULL || req->hasChanged) {
-        char     *func;
-        PyObject *val;
+    if (fseek(file, 0, SEEK_END) != 0 || (len = ftell(file)) < 0
+            || fseek(file, 0, SEEK_SET) != 0) {
+        lprintf(WARNING, "Cannot read warm-up script '%s': %s", path, strerror(errno));
+        fclose(file);
+        return -1;
+    }
+    src = pmalloc(len + 1);
+    len = (long)fread(src, 1, len, file);
+    src[len] = '\0';
+    fclose(file);
 
-        /* Parse request to get funcion structure */
-        pyfunc = plc_py_init_function(req);
+    dict = PyModule_GetDict(PyMainModule);
+    globals = PyDict_New();
+    PyDict_SetItemString(globals, "__builtins__", PyDict_GetItemString(dict, "__builtins__"));
+    PyDict_SetItemString(globals, "GD", PyDict_GetItemString(dict, "GD"));
+
+    res = PyRun_String(src, Py_file_input, globals, globals);
+    if (res == NULL) {
+        lprintf(WARNING, "Warm-up script '%s' failed:", path);
+        PyErr_Print();
+        status = -1;
+    }
+    Py_XDECREF(res);
+    Py_DECREF(globals);
+    pfree(src);
+    return status;
+}
 
-        /* Modify function code for compiling it into Python object */
-        func = create_python_func(req);
-        if (func == NULL) {
-            return;
+/*
+ * Imports the modules listed in PLC_PRELOAD_MODULES setting, separated with
+ * commas, so the functions importing them do not pay for it on the first call,
+ * and runs the warm-up script set with PLC_WARMUP_SCRIPT. A module that cannot
+ * be imported is only reported in the log, the function importing it gets the
+ * error itself
+ */
+void python_preload(void) {
+    const char    *value = getenv("PLC_PRELOAD_MODULES");
+    const char    *warmup = getenv("PLC_WARMUP_SCRIPT");
+    char          *names;
+    char          *name;
+    char          *saveptr = NULL;
+    PyObject      *module;
+    int            nmodules = 0;
+    struct timeval start;
+
+    if (value != NULL && value[0] != '\0') {
+        gettimeofday(&start, NULL);
+        names = pstrdup(value);
+        for (name = strtok_r(names, ", \t\n", &saveptr); name != NULL;
+                name = strtok_r(NULL, ", \t\n", &saveptr)) {
+            module = PyImport_ImportModule(name);
+            if (module == NULL) {
+                lprintf(WARNING, "Cannot preload module '%s'", name);
+                PyErr_Clear();
+                continue;
+            }
+            Py_DECREF(module);
+            nmodules++;
         }
+        pfree(names);
+        lprintf(NOTICE, "Preloaded %d modules in %.3f seconds", nmodules,
+                python_elapsed(&start));
+    }
 
-        /* The function will be in the dictionary because it was wrapped with "def proc_name:... " */
-        val = PyRun_String(func, Py_single_input, dict, dict); // Returns new reference
-        if (val == NULL) {
-            raise_execution_error("Cannot compile function in Python");
-            return;
+    if (warmup != NULL && warmup[0] != '\0') {
+        gettimeofday(&start, NULL);
+        if (python_warmup(warmup) == 0) {
+            lprintf(NOTICE, "Warm-up script '%s' finished in %.3f seconds", warmup,
+                    python_elapsed(&start));
         }
-        Py_DECREF(val);
-        free(func);
+    }
+}
 
-        /* get the function from the global dictionary, returns borrowed reference */
-        val = PyDict_GetItemString(dict, req->proc.name);
-        if (!PyCallable_Check(val)) {
-            raise_execution_error("Object produced by function is not callable");
-            return;
-        }
+/*
+ * Sets SD dictionary of the function to the main module. Consecutive calls of
+ * the same function find it already set
+ */
+static int bind_function_sd(PyObject *sd) {
+    PyObject *prev = PyBoundSD;
+
+    if (sd == PyBoundSD) {
+        return 0;
+    }
+    if (PyDict_SetItemString(PyMainDict, "SD", sd) < 0) {
+        return -1;
+    }
+    Py_INCREF(sd);
+    PyBoundSD = sd;
+    Py_XDECREF(prev);
+    return 0;
+}
 
-        pyfunc->pyfunc = val;
+/*
+ * Compiles the function of the call request, returns NULL if it cannot be
+ * compiled. The function is not put into the cache yet
+ */
+static plcPyFunction *compile_python_function(plcMsgCallreq *req) {
+    plcPyFunction *pyfunc;
+    char          *func;
+    PyObject      *val;
+    PyObject      *dict = PyMainDict;
+
+    /* Modify function code for compiling it into Python object */
+    func = create_python_func(req);
+    if (func == NULL) {
+        return NULL;
+    }
 
-        plc_py_function_cache_put(pyfunc);
-    } else {
-        pyfunc->call = req;
+    /* The function will be in the dictionary because it was wrapped with "def proc_name:... " */
+    val = PyRun_String(func, Py_single_input, dict, dict); // Returns new reference
+    free(func);
+    if (val == NULL) {
+        raise_execution_error("Cannot compile function in Python");
+        return NULL;
     }
+    Py_DECREF(val);
 
-    if (PyDict_SetItemString(dict, "SD", pyfunc->pySD) < 0) {
+    /*
+     * get the function from the global dictionary, returns borrowed reference.
+     * Another function of the same name replaces it there, so the function
+     * keeps its own reference
+     */
+    val = PyDict_GetItemString(dict, req->proc.name);
+    if (val == NULL || !PyCallable_Check(val)) {
+        raise_execution_error("Object produced by function is not callable");
+        return NULL;
+    }
+
+    /* Parse request to get funcion structure */
+    pyfunc = plc_py_init_function(req);
+    Py_INCREF(val);
+    pyfunc->pyfunc = val;
+    return pyfunc;
+}
+
+static void call_python_function(plcPyFunction *pyfunc, plcConn *conn,
+                                 plcFunctionStats *stats, long long start) {
+    PyObject      *retval = NULL;
+    PyObject      *args = NULL;
+    long long      mark;
+    long long      now;
+    long long      spiTime;
+
+    if (bind_function_sd(pyfunc->pySD) < 0) {
         raise_execution_error("Cannot set SD dictionary to main module");
         return;
     }
 
+    plc_trace_begin("arguments");
+    mark = plc_py_profile_clock();
     args = arguments_to_pytuple(pyfunc);
+    stats->argumentsTime += plc_py_profile_clock() - mark;
+    plc_trace_end("arguments");
     if (args == NULL) {
         raise_execution_error("Cannot convert input arguments to Python tuple");
         return;
@@ -176,22 +324,126 @@ void handle_call(plcMsgCallreq *req, plcConn *conn) {
 
     /* call the function */
     plc_is_execution_terminated = 0;
+    plc_py_profile_current = stats;
+    spiTime = stats->spiTime;
+    plc_trace_begin("python execute");
+    mark = plc_py_profile_clock();
     retval = PyObject_Call(pyfunc->pyfunc, args, NULL); // returns new reference
+    now = plc_py_profile_clock();
+    plc_trace_end("python execute");
+    stats->executionTime += now - mark - (stats->spiTime - spiTime);
     if (retval == NULL || PyErr_Occurred()) {
-        Py_XDECREF(args);
         raise_execution_error("Exception occurred in Python during function execution");
+        Py_XDECREF(retval);
+        Py_XDECREF(args);
         return;
     }
 
+    /* Results returned by generators run the function code, including SPI */
+    spiTime = stats->spiTime;
     if (plc_is_execution_terminated == 0) {
+        plc_trace_begin("results");
         process_call_results(conn, retval, pyfunc);
+        plc_trace_end("results");
     }
+    mark = plc_py_profile_clock();
+    stats->resultsTime += mark - now - (stats->spiTime - spiTime);
+    plc_py_profile_call_done(stats, mark - start);
 
-    pyfunc->call = NULL;
     Py_XDECREF(args);
     Py_XDECREF(retval);
+}
+
+void handle_call(plcMsgCallreq *req, plcConn *conn) {
+    plcPyFunction *pyfunc = NULL;
+    plcMsgCallreq *outerCall;
+    plcPyFunction *outerFunction;
+    PyObject      *outerSD;
+    plcFunctionStats *outerStats;
+    plcFunctionStats *stats;
+    long long      start = plc_py_profile_clock();
+    int            compiled = 0;
 
-    return;
+    /*
+     * Keep our connection for future calls from Python back to us.
+     */
+    plcconn_global   = conn;
+    plc_sending_data = 0;
+    plc_is_execution_terminated = 0;
+    plc_log_level    = req->logLevel;
+    plc_trace_enabled = req->trace;
+
+    stats = plc_py_profile_function(req->objectid);
+    stats->calls += 1;
+
+    pyfunc = plc_py_function_cache_get(req->objectid);
+    if (pyfunc == NULL || req->hasChanged) {
+        pyfunc = compile_python_function(req);
+        if (pyfunc == NULL) {
+            return;
+        }
+        compiled = 1;
+    }
+
+    /*
+     * The function being executed is not evicted from the cache, so it is
+     * marked before it is put there. The nested call restores the request,
+     * SD, profiling and the current function of the calling function on
+     * return, whatever way the call ends
+     */
+    outerCall = pyfunc->call;
+    pyfunc->call = req;
+    pyfunc->executing += 1;
+    if (compiled) {
+        plc_py_function_cache_put(pyfunc);
+    }
+    outerSD = PyBoundSD;
+    Py_XINCREF(outerSD);
+    outerStats = plc_py_profile_current;
+    outerFunction = plc_py_current_function;
+    plc_py_current_function = pyfunc;
+
+    call_python_function(pyfunc, conn, stats, start);
+
+    plc_py_current_function = outerFunction;
+    plc_py_profile_current = outerStats;
+    if (outerSD != NULL) {
+        bind_function_sd(outerSD);
+        Py_DECREF(outerSD);
+    }
+    pyfunc->executing -= 1;
+    pyfunc->call = outerCall;
+    if (pyfunc->executing == 0 && pyfunc->replaced) {
+        plc_py_free_function(pyfunc);
+    }
+}
+
+void handle_stats(plcMsgStats *req UNUSED, plcConn *conn) {
+    static char *names[] = {
+        "function_cache_hits",
+        "function_cache_misses",
+        "function_cache_evictions",
+        "function_cache_entries",
+        "function_cache_memory"
+    };
+    long long               values[5];
+    plcPyFunctionCacheStats cache;
+    plcMsgStats             res;
+
+    plc_py_function_cache_stats(&cache);
+    values[0] = cache.hits;
+    values[1] = cache.misses;
+    values[2] = cache.evictions;
+    values[3] = cache.entries;
+    values[4] = cache.memory;
+
+    res.msgtype = MT_STATS;
+    res.ncounters = 5;
+    res.names = names;
+    res.values = values;
+    res.functions = plc_py_profile_all(&res.nfunctions);
+    plcontainer_channel_send(conn, (plcMessage*)&res);
+    pfree(res.functions);
 }
 
 static char *create_python_func(plcMsgCallreq *req) {
@@ -269,23 +521,28 @@ static char *create_python_func(plcMsgCallreq *req) {
     return mrc;
 }
 
+/*
+ * Builds the input tuple of the function: the list of all the arguments
+ * followed by the named ones. The list is built only when the function source
+ * refers to it, otherwise None is passed in its place
+ */
 static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc) {
     PyObject *args;
-    PyObject *arglist;
+    PyObject *arglist = NULL;
     int i;
-    int notnull = 0;
     int pos;
 
-    /* Amount of elements that have names and should make it to the input tuple */
-    for (i = 0; i < pyfunc->nargs; i++) {
-        if (pyfunc->args[i].argName != NULL) {
-            notnull += 1;
-        }
-    }
-
     /* Creating a tuple that would be input to the function and list of arguments */
-    args = PyTuple_New(notnull + 1);
-    arglist = PyList_New(pyfunc->nargs);
+    args = PyTuple_New(pyfunc->nNamedArgs + 1);
+    if (args == NULL) {
+        return NULL;
+    }
+    if (pyfunc->usesArgs) {
+        arglist = PyList_New(pyfunc->nargs);
+    } else {
+        Py_INCREF(Py_None);
+        arglist = Py_None;
+    }
 
     /* First element of the argument list is the full list of arguments */
     PyTuple_SetItem(args, 0, arglist); // steals the reference to arglist
@@ -293,6 +550,11 @@ static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc) {
     for (i = 0; i < pyfunc->nargs; i++) {
         PyObject *arg = NULL;
 
+        /* Unnamed argument is only reachable through the list */
+        if (!pyfunc->usesArgs && pyfunc->args[i].argName == NULL) {
+            continue;
+        }
+
         /* Get the argument from the callreq structure */
         if (pyfunc->call->args[i].data.isnull) {
             Py_INCREF(Py_None);
@@ -329,7 +591,9 @@ static PyObject *arguments_to_pytuple(plcPyFunction *pyfunc) {
         }
 
         /* All the arguments, including unnamed, are passed to the arguments array */
-        if (PyList_SetItem(arglist, i, arg) != 0) { // steals the reference to arg
+        if (!pyfunc->usesArgs) {
+            Py_DECREF(arg);
+        } else if (PyList_SetItem(arglist, i, arg) != 0) { // steals the reference to arg
             raise_execution_error("Appending Python list element %d for argument '%s' has failed",
                                   i, pyfunc->args[i].argName);
             return NULL;
@@ -350,6 +614,7 @@ static int process_call_results(plcConn *conn, PyObject *retval, plcPyFunction *
     res->types    = malloc(1 * sizeof(plcType));
     res->data     = NULL;
     res->exception_callback = plc_error_callback;
+    res->sharedTypes = 0;
     plc_py_copy_type(&res->types[0], &pyfunc->res);
 
     /* Now we support only functions returning single column */
@@ -409,6 +674,9 @@ static int process_call_results(plcConn *conn, PyObject *retval, plcPyFunction *
 
     /* If the output operation succeeded we send the result back */
     if (retcode == 0) {
+        /* Answer to the statement in flight must not follow the result */
+        plc_future_complete_pending();
+
         /* We manually state that we are sending the data to avoid message interleaving */
         plc_sending_data = 1;
         plcontainer_channel_send(conn, (plcMessage*)res);
@@ -24,6 +24,8 @@
 
     // Strings are now unicode
     #define PyString_FromString(x) PyUnicode_FromString(x)
+    #define PyString_FromStringAndSize(x, n) PyUnicode_FromStringAndSize(x, n)
+    #define PyString_InternFromString(x) PyUnicode_InternFromString(x)
     #define PyString_AsString(x)   PyUnicode_AsUTF8(x)
     #define PyString_Check(x)      (PyUnicode_Check(x) || PyBytes_Check(x))
 #else
@@ -38,14 +40,26 @@
 // Global connection object
 extern plcConn* plcconn_global;
 
+// Function of the innermost call in progress
+extern plcPyFunction *plc_py_current_function;
+
 // Global execution termination flag
 int plc_is_execution_terminated;
 int plc_sending_data;
 
+// Lowest level of the log messages output by the backend
+extern int plc_log_level;
+
 // Initialization of Python module
 int python_init(void);
 
+// Import of the modules configured to be loaded at start
+void python_preload(void);
+
 // Processing of the Greenplum function call
 void handle_call(plcMsgCallreq *req, plcConn* conn);
 
+// Processing of the statistics request
+void handle_stats(plcMsgStats *req, plcConn* conn);
+
 #endif /* PLC_PYCALL_H */
@@ -13,6 +13,9 @@
 #include "common/comm_utils.h"
 
 #include <Python.h>
+#include <datetime.h>
+#include <ctype.h>
+#include <strings.h>
 
 static PyObject *plc_pyobject_from_int1(char *input, plcPyType *type);
 static PyObject *plc_pyobject_from_int2(char *input, plcPyType *type);
@@ -21,14 +24,25 @@ static PyObject *plc_pyobject_from_int8(char *input, plcPyType *type);
 static PyObject *plc_pyobject_from_float4(char *input, plcPyType *type);
 static PyObject *plc_pyobject_from_float8(char *input, plcPyType *type);
 static PyObject *plc_pyobject_from_text(char *input, plcPyType *type);
-static PyObject *plc_pyobject_from_text_ptr(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_array_slice(plcArray *arr, int i, plcPyType *type);
 static PyObject *plc_pyobject_from_array_dim(plcArray *arr, plcPyType *type,
                     int *idx, int *ipos, char **pos, int vallen, int dim);
 static PyObject *plc_pyobject_from_array(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_array_numpy(char *input, plcPyType *type);
 static PyObject *plc_pyobject_from_udt(char *input, plcPyType *type);
 static PyObject *plc_pyobject_from_udt_ptr(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_udt_tuple(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_udt_tuple_ptr(char *input, plcPyType *type);
 static PyObject *plc_pyobject_from_bytea(char *input, plcPyType *type);
-static PyObject *plc_pyobject_from_bytea_ptr(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_timestamp(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_date(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_time(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_interval(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_uuid(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_json(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_json_ptr(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_binary(char *input, plcPyType *type);
+static PyObject *plc_pyobject_from_binary_ptr(char *input, plcPyType *type);
 
 static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type);
 static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type);
@@ -40,8 +54,17 @@ static int plc_pyobject_as_text(PyObject *input, char **output, plcPyType *type)
 static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type);
 static int plc_pyobject_as_udt(PyObject *input, char **output, plcPyType *type);
 static int plc_pyobject_as_bytea(PyObject *input, char **output, plcPyType *type);
-
+static int plc_pyobject_as_timestamp(PyObject *input, char **output, plcPyType *type);
+static int plc_pyobject_as_date(PyObject *input, char **output, plcPyType *type);
+static int plc_pyobject_as_time(PyObject *input, char **output, plcPyType *type);
+static int plc_pyobject_as_interval(PyObject *input, char **output, plcPyType *type);
+static int plc_pyobject_as_uuid(PyObject *input, char **output, plcPyType *type);
+static int plc_pyobject_as_json(PyObject *input, char **output, plcPyType *type);
+static int plc_pyobject_as_binary(PyObject *input, char **output, plcPyType *type);
+
+static int plc_pyobject_as_array_buffer(PyObject *input, char **output, plcPyType *type);
 static void plc_pyobject_iter_free (plcIterator *iter);
+static void plc_pyobject_buffer_iter_free (plcIterator *iter);
 static rawdata *plc_pyobject_as_array_next (plcIterator *iter);
 
 static plcPyInputFunc plc_get_input_function(plcDatatype dt, bool isArrayElement);
@@ -73,11 +96,18 @@ static PyObject *plc_pyobject_from_float8(char *input, plcPyType *type UNUSED) {
 }
 
 static PyObject *plc_pyobject_from_text(char *input, plcPyType *type UNUSED) {
-    return PyString_FromString( input );
+    return PyString_FromStringAndSize( input + 4, *((int*)input) );
 }
 
-static PyObject *plc_pyobject_from_text_ptr(char *input, plcPyType *type UNUSED) {
-    return PyString_FromString( *((char**)input) );
+/* Text and bytea arrays come as a single blob, elements are sliced out of it */
+static PyObject *plc_pyobject_from_array_slice(plcArray *arr, int i, plcPyType *type) {
+    char *data = arr->data + arr->offsets[i];
+    int   len = arr->offsets[i + 1] - arr->offsets[i];
+
+    if (type->type == PLC_DATA_BYTEA) {
+        return PyBytes_FromStringAndSize(data, len);
+    }
+    return PyString_FromStringAndSize(data, len);
 }
 
 static PyObject *plc_pyobject_from_array_dim(plcArray *arr,
@@ -92,6 +122,8 @@ static PyObject *plc_pyobject_from_array_dim(plcArray *arr,
         if (arr->nulls[*ipos] != 0) {
             res = Py_None;
             Py_INCREF(Py_None);
+        } else if (arr->offsets != NULL) {
+            res = plc_pyobject_from_array_slice(arr, *ipos, type);
         } else {
             res = type->conv.inputfunc(*pos, type);
         }
@@ -136,29 +168,222 @@ static PyObject *plc_pyobject_from_array (char *input, plcPyType *type) {
     return res;
 }
 
+/* NumPy support. The module is loaded on the first use only, so that the
+ * clients without it installed keep working with plain lists */
+
+static PyObject *plc_numpy_module = NULL;
+static int       plc_numpy_loaded = 0; // 1 - loaded, -1 - not available
+
+static PyObject *plc_get_numpy_module(void) {
+    if (plc_numpy_loaded == 0) {
+        plc_numpy_module = PyImport_ImportModule("numpy");
+        if (plc_numpy_module == NULL) {
+            PyErr_Clear();
+            plc_numpy_loaded = -1;
+        } else {
+            plc_numpy_loaded = 1;
+        }
+    }
+    return plc_numpy_module;
+}
+
+/* Data type of numpy array matching the array element, NULL if not numeric */
+static const char *plc_get_numpy_dtype(plcDatatype type) {
+    switch (type) {
+        case PLC_DATA_INT1:   return "bool";
+        case PLC_DATA_INT2:   return "int16";
+        case PLC_DATA_INT4:   return "int32";
+        case PLC_DATA_INT8:   return "int64";
+        case PLC_DATA_FLOAT4: return "float32";
+        case PLC_DATA_FLOAT8: return "float64";
+        default:              return NULL;
+    }
+}
+
+/* Python object owning the memory of the received array, it is the base of
+ * the numpy array created on top of it with no copying */
+typedef struct plcPyArrayBuffer {
+    PyObject_HEAD
+    char       *data;
+    Py_ssize_t  len;
+} plcPyArrayBuffer;
+
+static void plc_array_buffer_dealloc(PyObject *self) {
+    pfree(((plcPyArrayBuffer*)self)->data);
+    PyObject_Del(self);
+}
+
+static int plc_array_buffer_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+    plcPyArrayBuffer *buf = (plcPyArrayBuffer*)self;
+    return PyBuffer_FillInfo(view, self, buf->data, buf->len, 0, flags);
+}
+
+#if PY_MAJOR_VERSION < 3
+static Py_ssize_t plc_array_buffer_getreadbuf(PyObject *self, Py_ssize_t segment, void **ptr) {
+    if (segment != 0) {
+        PyErr_SetString(PyExc_SystemError, "accessing non-existent buffer segment");
+        return -1;
+    }
+    *ptr = ((plcPyArrayBuffer*)self)->data;
+    return ((plcPyArrayBuffer*)self)->len;
+}
+
+static Py_ssize_t plc_array_buffer_getsegcount(PyObject *self, Py_ssize_t *lenp) {
+    if (lenp != NULL) {
+        *lenp = ((plcPyArrayBuffer*)self)->len;
+    }
+    return 1;
+}
+
+static Py_ssize_t plc_array_buffer_getcharbuf(PyObject *self, Py_ssize_t segment, char **ptr) {
+    return plc_array_buffer_getreadbuf(self, segment, (void**)ptr);
+}
+#endif
+
+static PyBufferProcs plc_array_buffer_procs = {
+#if PY_MAJOR_VERSION < 3
+    plc_array_buffer_getreadbuf,             /* bf_getreadbuffer */
+    plc_array_buffer_getreadbuf,             /* bf_getwritebuffer */
+    plc_array_buffer_getsegcount,            /* bf_getsegcount */
+    plc_array_buffer_getcharbuf,             /* bf_getcharbuffer */
+#endif
+    plc_array_buffer_getbuffer,              /* bf_getbuffer */
+    NULL                                     /* bf_releasebuffer */
+};
+
+static PyTypeObject plc_array_buffer_type;
+
+static int plc_array_buffer_type_ready(void) {
+    if (plc_array_buffer_type.tp_flags & Py_TPFLAGS_READY) {
+        return 0;
+    }
+
+    /* Static type object lives forever, so it starts with a reference */
+#if PY_MAJOR_VERSION < 3
+    plc_array_buffer_type.ob_refcnt = 1;
+#else
+    plc_array_buffer_type.ob_base.ob_base.ob_refcnt = 1;
+#endif
+    plc_array_buffer_type.tp_name = "plpy.ArrayBuffer";
+    plc_array_buffer_type.tp_basicsize = sizeof(plcPyArrayBuffer);
+    plc_array_buffer_type.tp_dealloc = plc_array_buffer_dealloc;
+    plc_array_buffer_type.tp_as_buffer = &plc_array_buffer_procs;
+#if PY_MAJOR_VERSION < 3
+    plc_array_buffer_type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER;
+#else
+    plc_array_buffer_type.tp_flags = Py_TPFLAGS_DEFAULT;
+#endif
+    return PyType_Ready(&plc_array_buffer_type);
+}
+
+/* Whether the values of the given type can be represented as numpy array */
+bool plc_py_numpy_supported(plcDatatype type) {
+    return plc_get_numpy_dtype(type) != NULL && plc_get_numpy_module() != NULL;
+}
+
+/* One-dimensional numpy array on top of the given values, the memory is taken
+ * over by the array and is freed with it */
+PyObject *plc_py_numpy_from_data(char *data, int size, plcDatatype type) {
+    plcPyArrayBuffer *buf;
+    PyObject         *res;
+
+    if (plc_array_buffer_type_ready() < 0) {
+        pfree(data);
+        return NULL;
+    }
+
+    buf = PyObject_New(plcPyArrayBuffer, &plc_array_buffer_type);
+    if (buf == NULL) {
+        pfree(data);
+        return NULL;
+    }
+    buf->data = data;
+    buf->len = (Py_ssize_t)size * plc_get_type_length(type);
+
+    res = PyObject_CallMethod(plc_get_numpy_module(), "frombuffer", "Os",
+                              (PyObject*)buf, plc_get_numpy_dtype(type));
+    Py_DECREF(buf);
+    return res;
+}
+
+/* Numeric arrays without nulls become numpy arrays sharing the memory of the
+ * received array, which is taken over from it. All the other arrays, as well
+ * as all the arrays when numpy is not available, become lists */
+static PyObject *plc_pyobject_from_array_numpy(char *input, plcPyType *type) {
+    plcArray         *arr = (plcArray*)input;
+    bool              numpy = false;
+    PyObject         *res;
+    PyObject         *shape;
+    PyObject         *reshaped;
+    int               i;
+
+    if (arr->meta->size > 0 && arr->data != NULL) {
+        numpy = plc_py_numpy_supported(arr->meta->type);
+        for (i = 0; i < arr->meta->size && numpy; i++) {
+            if (arr->nulls[i] != 0) {
+                numpy = false;
+            }
+        }
+    }
+    if (!numpy) {
+        return plc_pyobject_from_array(input, type);
+    }
+
+    res = plc_py_numpy_from_data(arr->data, arr->meta->size, arr->meta->type);
+    arr->data = NULL;
+    if (res == NULL || arr->meta->ndims == 1) {
+        return res;
+    }
+
+    shape = PyTuple_New(arr->meta->ndims);
+    for (i = 0; i < arr->meta->ndims; i++) {
+        PyTuple_SetItem(shape, i, PyInt_FromLong(arr->meta->dims[i]));
+    }
+    reshaped = PyObject_CallMethod(res, "reshape", "(O)", shape);
+    Py_DECREF(shape);
+    Py_DECREF(res);
+    return reshaped;
+}
+
+/* Number of the first unnamed field of the UDT, used in error messages */
+static int plc_py_unnamed_field(plcPyType *type) {
+    int i;
+
+    for (i = 0; i < type->nSubTypes; i++) {
+        if (type->subTypes[i].typeName == NULL) {
+            break;
+        }
+    }
+    return i;
+}
+
 static PyObject *plc_pyobject_from_udt(char *input, plcPyType *type) {
     plcUDT *udt;
     int i;
     PyObject *res = NULL;
     PyObject *obj = NULL;
 
+    if (type->keys == NULL) {
+        raise_execution_error("Field %d of the input UDT is unnamed and cannot be converted to Python dict key",
+                              plc_py_unnamed_field(type));
+        return NULL;
+    }
+
     udt = (plcUDT*)input;
     res = PyDict_New();
 
     for (i = 0; i < type->nSubTypes; i++) {
-        if (type->subTypes[i].typeName != NULL) {
-            if (udt->data[i].isnull) {
-                PyDict_SetItemString(res, type->subTypes[i].typeName, Py_None);
-            } else {
-                obj = type->subTypes[i].conv.inputfunc(udt->data[i].value,
-                                                       &type->subTypes[i]);
-                PyDict_SetItemString(res, type->subTypes[i].typeName, obj);
-                Py_XDECREF(obj);
-            }
+        if (udt->data[i].isnull) {
+            PyDict_SetItem(res, PyTuple_GET_ITEM(type->keys, i), Py_None);
         } else {
-            raise_execution_error("Field %d of the input UDT is unnamed and cannot be converted to Python dict key", i);
-            res = NULL;
-            break;
+            obj = type->subTypes[i].conv.inputfunc(udt->data[i].value,
+                                                   &type->subTypes[i]);
+            if (obj == NULL) {
+                Py_DECREF(res);
+                return NULL;
+            }
+            PyDict_SetItem(res, PyTuple_GET_ITEM(type->keys, i), obj);
+            Py_DECREF(obj);
         }
     }
 
@@ -169,16 +394,764 @@ static PyObject *plc_pyobject_from_udt_ptr(char *input, plcPyType *type) {
     return plc_pyobject_from_udt(*((char**)input), type);
 }
 
+/*
+ * Creates namedtuple type with the given field names. Names that are not
+ * valid Python identifiers are replaced with positional ones, and so is the
+ * type name
+ */
+static PyObject *plc_py_create_row_type(const char *name, PyObject *keys) {
+    PyObject *module;
+    PyObject *namedtuple;
+    PyObject *kwargs;
+    PyObject *args;
+    PyObject *res = NULL;
+
+    module = PyImport_ImportModule("collections");
+    if (module == NULL) {
+        return NULL;
+    }
+    namedtuple = PyObject_GetAttrString(module, "namedtuple");
+    Py_DECREF(module);
+    if (namedtuple == NULL) {
+        return NULL;
+    }
+
+    kwargs = Py_BuildValue("{s:O}", "rename", Py_True);
+    if (kwargs != NULL) {
+        args = Py_BuildValue("(sO)", name == NULL ? "record" : name, keys);
+        if (args != NULL) {
+            res = PyObject_Call(namedtuple, args, kwargs);
+            Py_DECREF(args);
+        }
+        if (res == NULL && name != NULL) {
+            PyErr_Clear();
+            args = Py_BuildValue("(sO)", "record", keys);
+            if (args != NULL) {
+                res = PyObject_Call(namedtuple, args, kwargs);
+                Py_DECREF(args);
+            }
+        }
+        Py_DECREF(kwargs);
+    }
+    Py_DECREF(namedtuple);
+
+    return res;
+}
+
+/*
+ * Allocates an instance of the namedtuple type directly, the same way
+ * tuple.__new__ does for subclasses, to avoid calling its Python-level
+ * constructor for every value. Items are set with PyTuple_SET_ITEM
+ */
+static PyObject *plc_py_new_row(PyObject *rowType, int size) {
+    PyTypeObject *tp = (PyTypeObject*)rowType;
+    return tp->tp_alloc(tp, size);
+}
+
+static PyObject *plc_pyobject_from_udt_tuple(char *input, plcPyType *type) {
+    plcUDT *udt;
+    int i;
+    PyObject *res = NULL;
+    PyObject *obj = NULL;
+
+    if (type->keys == NULL) {
+        raise_execution_error("Field %d of the input UDT is unnamed and cannot be converted to Python dict key",
+                              plc_py_unnamed_field(type));
+        return NULL;
+    }
+    if (type->rowType == NULL) {
+        type->rowType = plc_py_create_row_type(type->typeName, type->keys);
+        if (type->rowType == NULL) {
+            raise_execution_error("Cannot create namedtuple type for UDT \"%s\"", type->typeName);
+            return NULL;
+        }
+    }
+
+    udt = (plcUDT*)input;
+    res = plc_py_new_row(type->rowType, type->nSubTypes);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < type->nSubTypes; i++) {
+        if (udt->data[i].isnull) {
+            Py_INCREF(Py_None);
+            obj = Py_None;
+        } else {
+            obj = type->subTypes[i].conv.inputfunc(udt->data[i].value,
+                                                   &type->subTypes[i]);
+            if (obj == NULL) {
+                Py_DECREF(res);
+                return NULL;
+            }
+        }
+        PyTuple_SET_ITEM(res, i, obj);
+    }
+
+    return res;
+}
+
+static PyObject *plc_pyobject_from_udt_tuple_ptr(char *input, plcPyType *type) {
+    return plc_pyobject_from_udt_tuple(*((char**)input), type);
+}
+
 static PyObject *plc_pyobject_from_bytea(char *input, plcPyType *type UNUSED) {
     return PyBytes_FromStringAndSize(input + 4, *((int*)input));
 }
 
-static PyObject *plc_pyobject_from_bytea_ptr(char *input, plcPyType *type) {
-    return plc_pyobject_from_bytea(*((char**)input), type);
+/* Date and time support */
+
+#define PLC_POSTGRES_EPOCH_JDATE 2451545 /* date2j(2000, 1, 1) */
+#define PLC_USECS_PER_SEC  1000000LL
+#define PLC_USECS_PER_DAY  86400000000LL
+
+/* Infinite timestamps and dates, same values as in the backend */
+#define PLC_DT_NOBEGIN      (-0x7FFFFFFFFFFFFFFFLL - 1)
+#define PLC_DT_NOEND        0x7FFFFFFFFFFFFFFFLL
+#define PLC_DATEVAL_NOBEGIN (-0x7FFFFFFF - 1)
+#define PLC_DATEVAL_NOEND   0x7FFFFFFF
+
+/* Accessors for timedelta fields appeared only in Python 3.3 */
+#ifndef PyDateTime_DELTA_GET_DAYS
+#define PyDateTime_DELTA_GET_DAYS(o)         (((PyDateTime_Delta*)(o))->days)
+#define PyDateTime_DELTA_GET_SECONDS(o)      (((PyDateTime_Delta*)(o))->seconds)
+#define PyDateTime_DELTA_GET_MICROSECONDS(o) (((PyDateTime_Delta*)(o))->microseconds)
+#endif
+
+static int plc_datetime_init(void) {
+    if (PyDateTimeAPI == NULL) {
+        PyDateTime_IMPORT;
+        if (PyDateTimeAPI == NULL) {
+            raise_execution_error("Cannot import Python datetime module");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Julian day conversions, same algorithm as the backend uses */
+static int plc_date2j(int y, int m, int d) {
+    int julian;
+    int century;
+
+    if (m > 2) {
+        m += 1;
+        y += 4800;
+    } else {
+        m += 13;
+        y += 4799;
+    }
+
+    century = y / 100;
+    julian = y * 365 - 32167;
+    julian += y / 4 - century + century / 4;
+    julian += 7834 * m / 256 + d;
+
+    return julian;
+}
+
+static void plc_j2date(int jd, int *year, int *month, int *day) {
+    unsigned int julian;
+    unsigned int quad;
+    unsigned int extra;
+    int          y;
+
+    julian = jd;
+    julian += 32044;
+    quad = julian / 146097;
+    extra = (julian - quad * 146097) * 4 + 3;
+    julian += 60 + quad * 3 + extra / 146097;
+    quad = julian / 1461;
+    julian -= quad * 1461;
+    y = julian * 4 / 1461;
+    julian = ((y != 0) ? ((julian + 305) % 365) : ((julian + 306) % 366)) + 123;
+    y += quad * 4;
+    *year = y - 4800;
+    quad = julian * 2141 / 65536;
+    *day = julian - 7834 * quad / 256;
+    *month = (quad + 10) % 12 + 1;
+}
+
+static int plc_is_leap(int year) {
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+static int plc_days_in_month(int year, int month) {
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return (month == 2 && plc_is_leap(year)) ? 29 : days[month - 1];
+}
+
+/* Splits microseconds since the PostgreSQL epoch into date and time fields,
+ * returns -1 if the value cannot be represented by Python datetime. Finite
+ * values are split in any case */
+static int plc_timestamp_split(long long ts, int *year, int *month, int *day,
+                               int *hour, int *minute, int *second, int *usec) {
+    long long days;
+    long long time;
+
+    if (ts == PLC_DT_NOBEGIN || ts == PLC_DT_NOEND) {
+        return -1;
+    }
+    days = ts / PLC_USECS_PER_DAY;
+    time = ts % PLC_USECS_PER_DAY;
+    if (time < 0) {
+        time += PLC_USECS_PER_DAY;
+        days -= 1;
+    }
+
+    plc_j2date((int)days + PLC_POSTGRES_EPOCH_JDATE, year, month, day);
+    *hour   = (int)(time / (3600 * PLC_USECS_PER_SEC));
+    time   -= *hour * 3600 * PLC_USECS_PER_SEC;
+    *minute = (int)(time / (60 * PLC_USECS_PER_SEC));
+    time   -= *minute * 60 * PLC_USECS_PER_SEC;
+    *second = (int)(time / PLC_USECS_PER_SEC);
+    *usec   = (int)(time % PLC_USECS_PER_SEC);
+
+    /* Python supports years 1..9999 only */
+    return (days < -730119 || days > 2921939) ? -1 : 0;
+}
+
+/* Formats date and time fields the way the backend does with ISO DateStyle,
+ * timestamptz fields are in UTC. Used for the values Python datetime cannot
+ * hold, which are passed to the function as strings */
+static PyObject *plc_pystring_from_fields(int year, int month, int day, int withtime,
+                                          int hour, int minute, int second, int usec,
+                                          int withtz) {
+    char buf[64];
+    int  len;
+
+    len = sprintf(buf, "%04d-%02d-%02d", year > 0 ? year : 1 - year, month, day);
+    if (withtime) {
+        len += sprintf(buf + len, " %02d:%02d:%02d", hour, minute, second);
+        if (usec != 0) {
+            len += sprintf(buf + len, ".%06d", usec);
+            while (buf[len - 1] == '0')
+                len -= 1;
+            buf[len] = '\0';
+        }
+        if (withtz) {
+            len += sprintf(buf + len, "+00");
+        }
+    }
+    if (year <= 0) {
+        sprintf(buf + len, " BC");
+    }
+    return PyString_FromString(buf);
+}
+
+static long long plc_timestamp_join(int year, int month, int day,
+                                    int hour, int minute, int second, int usec) {
+    long long days = plc_date2j(year, month, day) - PLC_POSTGRES_EPOCH_JDATE;
+    return ((days * 24 + hour) * 60 + minute) * 60 * PLC_USECS_PER_SEC
+           + second * PLC_USECS_PER_SEC + usec;
+}
+
+/* Returns a malloc'ed copy of Python string or unicode object, NULL otherwise */
+static char *plc_pystring_as_cstring(PyObject *input) {
+    char *res = NULL;
+
+    if (PyUnicode_Check(input)) {
+        PyObject *bytes = PyUnicode_AsUTF8String(input);
+        if (bytes != NULL) {
+            res = strdup(PyBytes_AsString(bytes));
+            Py_DECREF(bytes);
+        }
+    } else if (PyBytes_Check(input)) {
+        res = strdup(PyBytes_AsString(input));
+    }
+
+    return res;
+}
+
+/* Returns text value holding the contents of Python string or unicode object,
+ * NULL for other objects */
+static char *plc_pystring_as_text(PyObject *input) {
+    char       *str;
+    Py_ssize_t  len;
+
+    if (PyUnicode_Check(input)) {
+    #if PY_MAJOR_VERSION >= 3
+        str = (char*)PyUnicode_AsUTF8AndSize(input, &len);
+        if (str != NULL) {
+            return plc_alloc_text(str, (int)len);
+        }
+    #else
+        PyObject *bytes = PyUnicode_AsUTF8String(input);
+        if (bytes != NULL) {
+            char *res = plc_alloc_text(PyBytes_AS_STRING(bytes), (int)PyBytes_GET_SIZE(bytes));
+            Py_DECREF(bytes);
+            return res;
+        }
+    #endif
+    } else if (PyBytes_Check(input)) {
+        if (PyBytes_AsStringAndSize(input, &str, &len) == 0) {
+            return plc_alloc_text(str, (int)len);
+        }
+    }
+
+    return NULL;
+}
+
+static int plc_parse_digits(const char **str, int maxdigits, int *value) {
+    int n = 0;
+
+    *value = 0;
+    while (n < maxdigits && **str >= '0' && **str <= '9') {
+        *value = *value * 10 + (**str - '0');
+        *str += 1;
+        n += 1;
+    }
+    return n;
+}
+
+/* Parses "YYYY-MM-DD" of a valid date in years 1..9999 */
+static int plc_parse_iso_date(const char **str, int *year, int *month, int *day) {
+    if (plc_parse_digits(str, 4, year) != 4 || **str != '-')
+        return -1;
+    *str += 1;
+    if (plc_parse_digits(str, 2, month) != 2 || **str != '-')
+        return -1;
+    *str += 1;
+    if (plc_parse_digits(str, 2, day) != 2)
+        return -1;
+    if (*year < 1 || *month < 1 || *month > 12
+            || *day < 1 || *day > plc_days_in_month(*year, *month))
+        return -1;
+    return 0;
+}
+
+/* Parses "MM[:SS[.ffffff]]" following the hours */
+static int plc_parse_iso_minutes(const char **str, int *minute, int *second, int *usec) {
+    *second = 0;
+    *usec = 0;
+    if (plc_parse_digits(str, 2, minute) != 2)
+        return -1;
+    if (**str == ':') {
+        *str += 1;
+        if (plc_parse_digits(str, 2, second) != 2)
+            return -1;
+        if (**str == '.') {
+            int ndigits;
+            *str += 1;
+            ndigits = plc_parse_digits(str, 6, usec);
+            if (ndigits == 0)
+                return -1;
+            for (; ndigits < 6; ndigits++)
+                *usec *= 10;
+            /* Ignore digits after microseconds */
+            while (**str >= '0' && **str <= '9')
+                *str += 1;
+        }
+    }
+    if (*minute > 59 || *second > 60)
+        return -1;
+    return 0;
+}
+
+/* Parses "HH:MM[:SS[.ffffff]]", the only time allowed in hour 24 is 24:00:00 */
+static int plc_parse_iso_time(const char **str, int *hour, int *minute,
+                              int *second, int *usec) {
+    if (plc_parse_digits(str, 2, hour) < 1 || **str != ':')
+        return -1;
+    *str += 1;
+    if (plc_parse_iso_minutes(str, minute, second, usec) != 0)
+        return -1;
+    if (*hour > 24 || (*hour == 24 && (*minute != 0 || *second != 0 || *usec != 0)))
+        return -1;
+    return 0;
+}
+
+/* Parses optional "Z" or "+HH[:MM]" suffix, returns offset in seconds */
+static int plc_parse_iso_offset(const char **str, int *offset, int *hasoffset) {
+    int sign, hh, mm = 0;
+
+    *offset = 0;
+    *hasoffset = 0;
+    while (**str == ' ')
+        *str += 1;
+    if (**str == 'Z' || **str == 'z') {
+        *hasoffset = 1;
+        *str += 1;
+    } else if (**str == '+' || **str == '-') {
+        sign = (**str == '-') ? -1 : 1;
+        *str += 1;
+        if (plc_parse_digits(str, 2, &hh) != 2)
+            return -1;
+        if (**str == ':')
+            *str += 1;
+        if (**str >= '0' && **str <= '9' && plc_parse_digits(str, 2, &mm) != 2)
+            return -1;
+        *offset = sign * (hh * 3600 + mm * 60);
+        *hasoffset = 1;
+    }
+    return (**str == '\0') ? 0 : -1;
+}
+
+/* Parses ISO 8601 timestamp into microseconds since PostgreSQL epoch and the
+ * UTC offset in seconds, if the timestamp has it */
+static int plc_parse_iso_timestamp(const char *str, long long *ts,
+                                   int *offset, int *hasoffset) {
+    int year, month, day;
+    int hour = 0, minute = 0, second = 0, usec = 0;
+
+    while (*str == ' ')
+        str += 1;
+    if (plc_parse_iso_date(&str, &year, &month, &day) != 0)
+        return -1;
+    if (*str == 'T' || *str == 't' || *str == ' ') {
+        str += 1;
+        if (plc_parse_iso_time(&str, &hour, &minute, &second, &usec) != 0)
+            return -1;
+    }
+    if (plc_parse_iso_offset(&str, offset, hasoffset) != 0)
+        return -1;
+
+    *ts = plc_timestamp_join(year, month, day, hour, minute, second, usec);
+    return 0;
+}
+
+static PyObject *plc_pyobject_from_timestamp(char *input, plcPyType *type) {
+    long long ts = *((long long*)input);
+    int year, month, day, hour, minute, second, usec;
+
+    if (plc_datetime_init() != 0)
+        return NULL;
+
+    if (ts == PLC_DT_NOBEGIN) {
+        return PyString_FromString("-infinity");
+    } else if (ts == PLC_DT_NOEND) {
+        return PyString_FromString("infinity");
+    }
+    if (plc_timestamp_split(ts, &year, &month, &day,
+                            &hour, &minute, &second, &usec) != 0) {
+        return plc_pystring_from_fields(year, month, day, 1, hour, minute, second, usec,
+                                        type->type == PLC_DATA_TIMESTAMPTZ);
+    }
+
+#if PY_VERSION_HEX >= 0x03070000
+    /* timestamptz always comes in UTC, make it an aware datetime */
+    if (type->type == PLC_DATA_TIMESTAMPTZ) {
+        return PyDateTimeAPI->DateTime_FromDateAndTime(year, month, day,
+                    hour, minute, second, usec,
+                    PyDateTime_TimeZone_UTC, PyDateTimeAPI->DateTimeType);
+    }
+#else
+    (void)type;
+#endif
+    return PyDateTime_FromDateAndTime(year, month, day, hour, minute, second, usec);
+}
+
+static PyObject *plc_pyobject_from_date(char *input, plcPyType *type UNUSED) {
+    int year, month, day;
+    int days = *((int*)input);
+
+    if (plc_datetime_init() != 0)
+        return NULL;
+
+    if (days == PLC_DATEVAL_NOBEGIN) {
+        return PyString_FromString("-infinity");
+    } else if (days == PLC_DATEVAL_NOEND) {
+        return PyString_FromString("infinity");
+    }
+
+    plc_j2date(days + PLC_POSTGRES_EPOCH_JDATE, &year, &month, &day);
+    /* Python supports years 1..9999 only */
+    if (days < -730119 || days > 2921939) {
+        return plc_pystring_from_fields(year, month, day, 0, 0, 0, 0, 0, 0);
+    }
+    return PyDate_FromDate(year, month, day);
+}
+
+static PyObject *plc_pyobject_from_time(char *input, plcPyType *type UNUSED) {
+    long long time = *((long long*)input);
+    int hour, minute, second;
+
+    if (plc_datetime_init() != 0)
+        return NULL;
+
+    /* 24:00:00 is a valid value in Greenplum, but not in Python */
+    if (time == PLC_USECS_PER_DAY) {
+        return PyString_FromString("24:00:00");
+    }
+    if (time < 0 || time > PLC_USECS_PER_DAY) {
+        raise_execution_error("Time is out of range for Python time");
+        return NULL;
+    }
+
+    hour    = (int)(time / (3600 * PLC_USECS_PER_SEC));
+    time   -= hour * 3600 * PLC_USECS_PER_SEC;
+    minute  = (int)(time / (60 * PLC_USECS_PER_SEC));
+    time   -= minute * 60 * PLC_USECS_PER_SEC;
+    second  = (int)(time / PLC_USECS_PER_SEC);
+    return PyTime_FromTime(hour, minute, second, (int)(time % PLC_USECS_PER_SEC));
+}
+
+/* Text of interval in the format Greenplum outputs it, which is also read
+ * back by plc_parse_interval() */
+static PyObject *plc_pystring_from_interval(plcInterval *iv) {
+    char               buf[128];
+    int                len = 0;
+    int                years = iv->month / 12;
+    int                months = iv->month % 12;
+    unsigned long long time;
+    int                usec;
+
+    if (years != 0) {
+        len += sprintf(buf + len, "%d year%s", years, (years == 1 || years == -1) ? "" : "s");
+    }
+    if (months != 0) {
+        len += sprintf(buf + len, "%s%d mon%s", (len > 0) ? " " : "", months,
+                       (months == 1 || months == -1) ? "" : "s");
+    }
+    if (iv->day != 0) {
+        len += sprintf(buf + len, "%s%d day%s", (len > 0) ? " " : "", iv->day,
+                       (iv->day == 1 || iv->day == -1) ? "" : "s");
+    }
+    if (iv->time != 0 || len == 0) {
+        time = (iv->time < 0) ? -(unsigned long long)iv->time : (unsigned long long)iv->time;
+        usec = (int)(time % PLC_USECS_PER_SEC);
+        time /= PLC_USECS_PER_SEC;
+        len += sprintf(buf + len, "%s%s%02llu:%02d:%02d", (len > 0) ? " " : "",
+                       (iv->time < 0) ? "-" : "", time / 3600,
+                       (int)(time / 60 % 60), (int)(time % 60));
+        if (usec != 0) {
+            len += sprintf(buf + len, ".%06d", usec);
+            while (buf[len - 1] == '0')
+                len -= 1;
+            buf[len] = '\0';
+        }
+    }
+    return PyString_FromString(buf);
+}
+
+/*
+ * Interval is converted to timedelta only when it is the same value after
+ * the conversion back. timedelta has neither months nor the difference
+ * between a day and 24 hours, so intervals with months, with 24 hours and
+ * more or with negative time are passed as text instead
+ */
+static PyObject *plc_pyobject_from_interval(char *input, plcPyType *type UNUSED) {
+    plcInterval *iv = (plcInterval*)input;
+
+    if (plc_datetime_init() != 0)
+        return NULL;
+
+    if (iv->month != 0 || iv->time < 0 || iv->time >= PLC_USECS_PER_DAY
+            || iv->day > 999999999 || iv->day < -999999999) {
+        return plc_pystring_from_interval(iv);
+    }
+    return PyDelta_FromDSU(iv->day, (int)(iv->time / PLC_USECS_PER_SEC),
+                           (int)(iv->time % PLC_USECS_PER_SEC));
+}
+
+static PyObject *plc_pyobject_from_uuid(char *input, plcPyType *type UNUSED) {
+    static PyObject *uuidClass = NULL;
+    PyObject        *args;
+    PyObject        *kwargs;
+    PyObject        *bytes;
+    PyObject        *res;
+
+    if (uuidClass == NULL) {
+        PyObject *module = PyImport_ImportModule("uuid");
+        if (module == NULL) {
+            raise_execution_error("Cannot import Python uuid module");
+            return NULL;
+        }
+        uuidClass = PyObject_GetAttrString(module, "UUID");
+        Py_DECREF(module);
+        if (uuidClass == NULL) {
+            raise_execution_error("Cannot find UUID class in Python uuid module");
+            return NULL;
+        }
+    }
+
+    bytes = PyBytes_FromStringAndSize(input, PLC_UUID_LEN);
+    args = PyTuple_New(0);
+    kwargs = PyDict_New();
+    PyDict_SetItemString(kwargs, "bytes", bytes);
+    res = PyObject_Call(uuidClass, args, kwargs);
+    Py_DECREF(bytes);
+    Py_DECREF(args);
+    Py_DECREF(kwargs);
+
+    return res;
+}
+
+/* Returns borrowed reference to json.loads or json.dumps */
+static PyObject *plc_get_json_function(int dumps) {
+    static PyObject *loads = NULL;
+    static PyObject *dump = NULL;
+
+    if (loads == NULL) {
+        PyObject *module = PyImport_ImportModule("json");
+        if (module == NULL) {
+            raise_execution_error("Cannot import Python json module");
+            return NULL;
+        }
+        loads = PyObject_GetAttrString(module, "loads");
+        dump = PyObject_GetAttrString(module, "dumps");
+        Py_DECREF(module);
+        if (loads == NULL || dump == NULL) {
+            raise_execution_error("Cannot find loads and dumps in Python json module");
+            Py_XDECREF(loads);
+            Py_XDECREF(dump);
+            loads = dump = NULL;
+            return NULL;
+        }
+    }
+
+    return dumps ? dump : loads;
+}
+
+static PyObject *plc_pyobject_from_json(char *input, plcPyType *type UNUSED) {
+    PyObject *loads = plc_get_json_function(0);
+    PyObject *str;
+    PyObject *res;
+
+    if (loads == NULL)
+        return NULL;
+
+    str = PyString_FromStringAndSize(input + 4, *((int*)input));
+    if (str == NULL) {
+        raise_execution_error("Cannot convert JSON document received from Greenplum to string");
+        return NULL;
+    }
+    res = PyObject_CallFunctionObjArgs(loads, str, NULL);
+    Py_DECREF(str);
+    if (res == NULL) {
+        raise_execution_error("Cannot parse JSON document received from Greenplum");
+    }
+    return res;
+}
+
+static PyObject *plc_pyobject_from_json_ptr(char *input, plcPyType *type) {
+    return plc_pyobject_from_json(*((char**)input), type);
+}
+
+/* Types transferred in binary send/receive format */
+
+/* Dictionary of type name -> (decoder, encoder) registered with
+ * plpy.register_binary_type() */
+static PyObject *plc_binary_type_codecs = NULL;
+
+/* Returns borrowed reference to decoder or encoder of the type, NULL if none */
+static PyObject *plc_get_binary_type_function(plcPyType *type, int encoder) {
+    PyObject *codecs;
+    PyObject *func;
+
+    if (plc_binary_type_codecs == NULL || type->pgTypeName == NULL)
+        return NULL;
+
+    codecs = PyDict_GetItemString(plc_binary_type_codecs, type->pgTypeName);
+    if (codecs == NULL)
+        return NULL;
+
+    func = PyTuple_GET_ITEM(codecs, encoder ? 1 : 0);
+    return (func == Py_None) ? NULL : func;
+}
+
+PyObject *plpy_register_binary_type(PyObject *self UNUSED, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"typname", "decoder", "encoder", NULL};
+    char     *typname;
+    PyObject *decoder = Py_None;
+    PyObject *encoder = Py_None;
+    PyObject *codecs;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OO", kwlist, &typname, &decoder, &encoder)) {
+        raise_execution_error("plpy module 'register_binary_type()' expected type name, "
+                              "decoder and encoder as input");
+        return NULL;
+    }
+
+    if ((decoder != Py_None && !PyCallable_Check(decoder))
+            || (encoder != Py_None && !PyCallable_Check(encoder))) {
+        raise_execution_error("plpy module 'register_binary_type()' expected decoder and "
+                              "encoder to be callable objects or None");
+        return NULL;
+    }
+
+    if (plc_binary_type_codecs == NULL) {
+        plc_binary_type_codecs = PyDict_New();
+    }
+
+    /* Passing neither decoder nor encoder removes the registration */
+    if (decoder == Py_None && encoder == Py_None) {
+        if (PyDict_GetItemString(plc_binary_type_codecs, typname) != NULL) {
+            PyDict_DelItemString(plc_binary_type_codecs, typname);
+        }
+        Py_RETURN_NONE;
+    }
+
+    codecs = Py_BuildValue("(OO)", decoder, encoder);
+    PyDict_SetItemString(plc_binary_type_codecs, typname, codecs);
+    Py_DECREF(codecs);
+
+    Py_RETURN_NONE;
+}
+
+/* Without a decoder the value is returned as raw bytes. Python 2 gets a
+ * bytearray to distinguish it from a text string when it is returned back */
+static PyObject *plc_pyobject_from_binary(char *input, plcPyType *type) {
+    int       len = *((int*)input) - 1;
+    PyObject *decoder;
+    PyObject *raw;
+    PyObject *res;
+
+    if (input[4] == PLC_BINARY_FORMAT_TEXT) {
+        return PyString_FromStringAndSize(input + 5, len);
+    }
+
+    #if PY_MAJOR_VERSION >= 3
+        raw = PyBytes_FromStringAndSize(input + 5, len);
+    #else
+        raw = PyByteArray_FromStringAndSize(input + 5, len);
+    #endif
+
+    decoder = plc_get_binary_type_function(type, 0);
+    if (decoder == NULL || raw == NULL)
+        return raw;
+
+    res = PyObject_CallFunctionObjArgs(decoder, raw, NULL);
+    Py_DECREF(raw);
+    if (res == NULL) {
+        raise_execution_error("Exception occurred decoding value of type '%s'", type->pgTypeName);
+    }
+    return res;
+}
+
+static PyObject *plc_pyobject_from_binary_ptr(char *input, plcPyType *type) {
+    return plc_pyobject_from_binary(*((char**)input), type);
+}
+
+/* Numbers of the other types, like numpy scalars, are converted with the
+ * help of their own conversion methods */
+static int plc_pynumber_as_longlong(PyObject *input, long long *value) {
+    PyObject *num;
+
+    if (!PyNumber_Check(input) || (num = PyNumber_Long(input)) == NULL) {
+        PyErr_Clear();
+        return -1;
+    }
+    *value = PyLong_AsLongLong(num);
+    Py_DECREF(num);
+    return 0;
+}
+
+static int plc_pynumber_as_double(PyObject *input, double *value) {
+    PyObject *num;
+
+    if (!PyNumber_Check(input) || (num = PyNumber_Float(input)) == NULL) {
+        PyErr_Clear();
+        return -1;
+    }
+    *value = PyFloat_AsDouble(num);
+    Py_DECREF(num);
+    return 0;
 }
 
 static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type UNUSED) {
     int res = 0;
+    long long lvalue;
     char *out = (char*)malloc(1);
     *output = out;
     if (PyInt_Check(input))
@@ -187,6 +1160,8 @@ static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type
         *out = (char)PyLong_AsLongLong(input);
     else if (PyFloat_Check(input))
         *out = (char)PyFloat_AsDouble(input);
+    else if (plc_pynumber_as_longlong(input, &lvalue) == 0)
+        *out = (char)lvalue;
     else {
         raise_execution_error("Exception occurred transforming result object to int1");
         res = -1;
@@ -196,6 +1171,7 @@ static int plc_pyobject_as_int1(PyObject *input, char **output, plcPyType *type
 
 static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type UNUSED) {
     int res = 0;
+    long long lvalue;
     char *out = (char*)malloc(2);
     *output = out;
     if (PyInt_Check(input))
@@ -204,6 +1180,8 @@ static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type
         *((short*)out) = (short)PyLong_AsLongLong(input);
     else if (PyFloat_Check(input))
         *((short*)out) = (short)PyFloat_AsDouble(input);
+    else if (plc_pynumber_as_longlong(input, &lvalue) == 0)
+        *((short*)out) = (short)lvalue;
     else {
         raise_execution_error("Exception occurred transforming result object to int2");
         res = -1;
@@ -213,6 +1191,7 @@ static int plc_pyobject_as_int2(PyObject *input, char **output, plcPyType *type
 
 static int plc_pyobject_as_int4(PyObject *input, char **output, plcPyType *type UNUSED) {
     int res = 0;
+    long long lvalue;
     char *out = (char*)malloc(4);
     *output = out;
     if (PyInt_Check(input))
@@ -221,6 +1200,8 @@ static int plc_pyobject_as_int4(PyObject *input, char **output, plcPyType *type
         *((int*)out) = (int)PyLong_AsLongLong(input);
     else if (PyFloat_Check(input))
         *((int*)out) = (int)PyFloat_AsDouble(input);
+    else if (plc_pynumber_as_longlong(input, &lvalue) == 0)
+        *((int*)out) = (int)lvalue;
     else {
         raise_execution_error("Exception occurred transforming result object to int4");
         res = -1;
@@ -230,6 +1211,7 @@ static int plc_pyobject_as_int4(PyObject *input, char **output, plcPyType *type
 
 static int plc_pyobject_as_int8(PyObject *input, char **output, plcPyType *type UNUSED) {
     int res = 0;
+    long long lvalue;
     char *out = (char*)malloc(8);
     *output = out;
     if (PyLong_Check(input))
@@ -238,6 +1220,8 @@ static int plc_pyobject_as_int8(PyObject *input, char **output, plcPyType *type
         *((long long*)out) = (long long)PyInt_AsLong(input);
     else if (PyFloat_Check(input))
         *((long long*)out) = (long long)PyFloat_AsDouble(input);
+    else if (plc_pynumber_as_longlong(input, &lvalue) == 0)
+        *((long long*)out) = (long long)lvalue;
     else {
         raise_execution_error("Exception occurred transforming result object to int8");
         res = -1;
@@ -247,6 +1231,7 @@ static int plc_pyobject_as_int8(PyObject *input, char **output, plcPyType *type
 
 static int plc_pyobject_as_float4(PyObject *input, char **output, plcPyType *type UNUSED) {
     int res = 0;
+    double dvalue;
     char *out = (char*)malloc(4);
     *output = out;
     if (PyFloat_Check(input))
@@ -255,6 +1240,8 @@ static int plc_pyobject_as_float4(PyObject *input, char **output, plcPyType *typ
         *((float*)out) = (float)PyLong_AsLongLong(input);
     else if (PyInt_Check(input))
         *((float*)out) = (float)PyInt_AsLong(input);
+    else if (plc_pynumber_as_double(input, &dvalue) == 0)
+        *((float*)out) = (float)dvalue;
     else {
         raise_execution_error("Exception occurred transforming result object to float4");
         res = -1;
@@ -264,6 +1251,7 @@ static int plc_pyobject_as_float4(PyObject *input, char **output, plcPyType *typ
 
 static int plc_pyobject_as_float8(PyObject *input, char **output, plcPyType *type UNUSED) {
     int res = 0;
+    double dvalue;
     char *out = (char*)malloc(8);
     *output = out;
     if (PyFloat_Check(input))
@@ -272,6 +1260,8 @@ static int plc_pyobject_as_float8(PyObject *input, char **output, plcPyType *typ
         *((double*)out) = (double)PyLong_AsLongLong(input);
     else if (PyInt_Check(input))
         *((double*)out) = (double)PyInt_AsLong(input);
+    else if (plc_pynumber_as_double(input, &dvalue) == 0)
+        *((double*)out) = (double)dvalue;
     else {
         raise_execution_error("Exception occurred transforming result object to float8");
         res = -1;
@@ -282,12 +1272,24 @@ static int plc_pyobject_as_float8(PyObject *input, char **output, plcPyType *typ
 static int plc_pyobject_as_text(PyObject *input, char **output, plcPyType *type UNUSED) {
     int res = 0;
     PyObject *obj;
+
+    /* Python 3 bytes objects go through str() like all the other objects */
+    #if PY_MAJOR_VERSION >= 3
+    if (PyUnicode_Check(input)) {
+    #else
+    if (PyString_Check(input) || PyUnicode_Check(input)) {
+    #endif
+        *output = plc_pystring_as_text(input);
+        if (*output != NULL)
+            return 0;
+    }
+
     obj = PyObject_Str(input);
     if (obj != NULL) {
-        *output = strdup(PyString_AsString(obj));
+        *output = plc_pystring_as_text(obj);
         Py_DECREF(obj);
-    } else {
-        *output = NULL;
+    }
+    if (*output == NULL) {
         raise_execution_error("Exception occurred transforming result object to text");
         res = -1;
     }
@@ -350,7 +1352,111 @@ static rawdata *plc_pyobject_as_array_next (plcIterator *iter) {
         }
     }
 
-    return res;
+    return res;
+}
+
+/* Strings and byte arrays are scalar values. Encoders of binary types might
+ * accept sequences as well, so for them only lists are array dimensions */
+static bool plc_is_array_dimension(PyObject *obj, plcPyType *elemType) {
+    if (!PySequence_Check(obj) || PyString_Check(obj) || PyByteArray_Check(obj))
+        return false;
+
+    if (elemType->type == PLC_DATA_BINARY && plc_get_binary_type_function(elemType, 1) != NULL)
+        return PyList_Check(obj);
+
+    return true;
+}
+
+/* Whether the format of the buffer matches the one of the array element */
+static bool plc_is_buffer_format_of(const char *format, plcDatatype type) {
+    int one = 1;
+
+    /* Unsigned bytes are implied when the format is not given */
+    if (format == NULL) {
+        return false;
+    }
+    if (*format == '@' || *format == '=' || (*format == '<' && *((char*)&one) == 1)) {
+        format++;
+    }
+    if (format[0] == '\0' || format[1] != '\0') {
+        return false;
+    }
+
+    switch (type) {
+        case PLC_DATA_INT1:
+            return format[0] == '?';
+        case PLC_DATA_INT2:
+        case PLC_DATA_INT4:
+        case PLC_DATA_INT8:
+            return strchr("hilq", format[0]) != NULL;
+        case PLC_DATA_FLOAT4:
+            return format[0] == 'f';
+        case PLC_DATA_FLOAT8:
+            return format[0] == 'd';
+        default:
+            return false;
+    }
+}
+
+/*
+ * Contiguous buffers of numeric values matching the array element type are
+ * sent with a single copy of their memory. Returns 1 and fills the output if
+ * the object is such a buffer, 0 if it should be converted element by element
+ */
+static int plc_pyobject_as_array_buffer(PyObject *input, char **output, plcPyType *type) {
+    plcDatatype   elemType = type->subTypes[0].type;
+    plcArrayMeta *arrmeta;
+    plcIterator  *iter;
+    Py_buffer    *view;
+    int           i;
+
+    if (plc_get_numpy_dtype(elemType) == NULL || !PyObject_CheckBuffer(input)
+            || PyString_Check(input) || PyByteArray_Check(input)) {
+        return 0;
+    }
+
+    view = (Py_buffer*)pmalloc(sizeof(Py_buffer));
+    if (PyObject_GetBuffer(input, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        PyErr_Clear();
+        pfree(view);
+        return 0;
+    }
+    if (view->ndim < 1 || view->ndim > PLC_MAX_ARRAY_DIMS
+            || view->itemsize != plc_get_type_length(elemType)
+            || !plc_is_buffer_format_of(view->format, elemType)) {
+        PyBuffer_Release(view);
+        pfree(view);
+        return 0;
+    }
+
+    arrmeta = (plcArrayMeta*)pmalloc(sizeof(plcArrayMeta));
+    arrmeta->type = elemType;
+    arrmeta->ndims = view->ndim;
+    arrmeta->dims = (int*)pmalloc(view->ndim * sizeof(int));
+    arrmeta->size = 1;
+    for (i = 0; i < view->ndim; i++) {
+        arrmeta->dims[i] = (int)view->shape[i];
+        arrmeta->size *= (int)view->shape[i];
+    }
+
+    iter = (plcIterator*)pmalloc(sizeof(plcIterator));
+    iter->meta = arrmeta;
+    iter->data = (char*)input;
+    iter->position = NULL;
+    iter->payload = (char*)view;
+    iter->values = view->buf;
+    iter->next = NULL;
+    iter->cleanup = plc_pyobject_buffer_iter_free;
+
+    *output = (char*)iter;
+    return 1;
+}
+
+static void plc_pyobject_buffer_iter_free (plcIterator *iter) {
+    PyBuffer_Release((Py_buffer*)iter->payload);
+    pfree(iter->payload);
+    pfree(iter->meta->dims);
+    pfree(iter->meta);
 }
 
 static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type) {
@@ -365,12 +1471,18 @@ static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type
     int              i = 0;
     plcPyArrPointer *ptrs;
 
+    /* Objects exposing their memory, like numpy arrays, are sent right from it */
+    res = plc_pyobject_as_array_buffer(input, output, type);
+    if (res != 0) {
+        return 0;
+    }
+
     /* We allow only lists to be returned as arrays */
-    if (PySequence_Check(input) && !PyString_Check(input)) {
+    if (plc_is_array_dimension(input, &type->subTypes[0])) {
         obj = input;
         Py_INCREF(obj);
         /* We want to iterate through all iterable objects except by strings */
-        while (obj != NULL && PySequence_Check(obj) && !PyString_Check(obj)) {
+        while (obj != NULL && plc_is_array_dimension(obj, &type->subTypes[0])) {
             int len = PySequence_Length(obj);
             if (len < 0) {
                 *output = NULL;
@@ -425,6 +1537,7 @@ static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type
         /* Initializing "next" and "cleanup" functions */
         iter->next = plc_pyobject_as_array_next;
         iter->cleanup = plc_pyobject_iter_free;
+        iter->values = NULL;
 
         *output = (char*)iter;
     } else {
@@ -438,10 +1551,19 @@ static int plc_pyobject_as_array(PyObject *input, char **output, plcPyType *type
 
 static int plc_pyobject_as_udt(PyObject *input, char **output, plcPyType *type) {
     int res = 0;
+    int isdict = PyDict_Check(input);
 
     *output = NULL;
-    if (!PyDict_Check(input)) {
-        raise_execution_error("Only 'dict' object can be converted to UDT \"%s\"", type->typeName);
+    if (!isdict && !PyTuple_Check(input)) {
+        raise_execution_error("Only 'dict' or 'tuple' object can be converted to UDT \"%s\"", type->typeName);
+        res = -1;
+    } else if (isdict && type->keys == NULL) {
+        raise_execution_error("Field %d of the result UDT is unnamed and cannot be found in result dictionary",
+                              plc_py_unnamed_field(type));
+        res = -1;
+    } else if (!isdict && PyTuple_GET_SIZE(input) != type->nSubTypes) {
+        raise_execution_error("Tuple of %d elements cannot be converted to UDT \"%s\" of %d fields",
+                              (int)PyTuple_GET_SIZE(input), type->typeName, type->nSubTypes);
         res = -1;
     } else {
         int i = 0;
@@ -449,19 +1571,22 @@ static int plc_pyobject_as_udt(PyObject *input, char **output, plcPyType *type)
 
         udt = pmalloc(sizeof(plcUDT));
         udt->data = pmalloc(type->nSubTypes * sizeof(rawdata));
+        for (i = 0; i < type->nSubTypes; i++) {
+            udt->data[i].isnull = true;
+            udt->data[i].value = NULL;
+        }
         for (i = 0; i < type->nSubTypes && res == 0; i++) {
             PyObject *value = NULL;
-            value = PyDict_GetItemString(input, type->subTypes[i].typeName);
+            if (isdict) {
+                value = PyDict_GetItem(input, PyTuple_GET_ITEM(type->keys, i));
+            } else {
+                value = PyTuple_GET_ITEM(input, i);
+            }
             if (value == NULL) {
-                udt->data[i].isnull = true;
-                udt->data[i].value = NULL;
                 raise_execution_error("Cannot find key '%s' in result dictionary for converting "
                                       "it into UDT", type->subTypes[i].typeName);
                 res = -1;
-            } else if (value == Py_None) {
-                udt->data[i].isnull = true;
-                udt->data[i].value = NULL;
-            } else {
+            } else if (value != Py_None) {
                 udt->data[i].isnull = false;
                 res = type->subTypes[i].conv.outputfunc(value, &udt->data[i].value, &type->subTypes[i]);
             }
@@ -518,6 +1643,409 @@ static int plc_pyobject_as_bytea(PyObject *input, char **output, plcPyType *type
     return 0;
 }
 
+/* Value that is not converted to binary here is passed as text to the type
+ * input function in the backend, the way all the date and time values used
+ * to be passed before */
+static int plc_pyobject_as_temporal_text(PyObject *input, char **output, plcPyType *type) {
+    char *text = NULL;
+
+    if (plc_pyobject_as_text(input, &text, type) != 0)
+        return -1;
+    *output = plc_alloc_temporal_text(type->type, text + 4, *((int*)text));
+    pfree(text);
+    return 0;
+}
+
+static int plc_pyobject_as_timestamp(PyObject *input, char **output, plcPyType *type) {
+    long long ts;
+    char     *str;
+    int       offset = 0;
+    int       hasoffset = 0;
+
+    *output = NULL;
+    if (plc_datetime_init() != 0)
+        return -1;
+
+    if (PyDateTime_Check(input)) {
+        ts = plc_timestamp_join(PyDateTime_GET_YEAR(input),
+                                PyDateTime_GET_MONTH(input),
+                                PyDateTime_GET_DAY(input),
+                                PyDateTime_DATE_GET_HOUR(input),
+                                PyDateTime_DATE_GET_MINUTE(input),
+                                PyDateTime_DATE_GET_SECOND(input),
+                                PyDateTime_DATE_GET_MICROSECOND(input));
+        /* Aware datetime is shifted to UTC for timestamptz, naive one is
+         * left to the backend to be read in the session TimeZone */
+        if (type->type == PLC_DATA_TIMESTAMPTZ) {
+            PyObject *utcoffset = PyObject_CallMethod(input, "utcoffset", NULL);
+            if (utcoffset == NULL) {
+                raise_execution_error("Exception occurred getting UTC offset of datetime object");
+                return -1;
+            }
+            if (utcoffset == Py_None) {
+                Py_DECREF(utcoffset);
+                return plc_pyobject_as_temporal_text(input, output, type);
+            }
+            ts -= ((long long)PyDateTime_DELTA_GET_DAYS(utcoffset) * 86400
+                   + PyDateTime_DELTA_GET_SECONDS(utcoffset)) * PLC_USECS_PER_SEC
+                  + PyDateTime_DELTA_GET_MICROSECONDS(utcoffset);
+            Py_DECREF(utcoffset);
+        }
+    } else if (PyDate_Check(input) && type->type == PLC_DATA_TIMESTAMP) {
+        ts = plc_timestamp_join(PyDateTime_GET_YEAR(input),
+                                PyDateTime_GET_MONTH(input),
+                                PyDateTime_GET_DAY(input), 0, 0, 0, 0);
+    } else if ((str = plc_pystring_as_cstring(input)) != NULL) {
+        int res = plc_parse_iso_timestamp(str, &ts, &offset, &hasoffset);
+        free(str);
+        /* Strings other than ISO 8601 and timestamptz strings without UTC
+         * offset are read by the backend, the same way as the offset of
+         * timestamp without time zone is ignored there */
+        if (res != 0 || (type->type == PLC_DATA_TIMESTAMPTZ && !hasoffset))
+            return plc_pyobject_as_temporal_text(input, output, type);
+        if (type->type == PLC_DATA_TIMESTAMPTZ)
+            ts -= offset * PLC_USECS_PER_SEC;
+    } else {
+        return plc_pyobject_as_temporal_text(input, output, type);
+    }
+
+    *output = (char*)malloc(8);
+    *((long long*)*output) = ts;
+    return 0;
+}
+
+static int plc_pyobject_as_date(PyObject *input, char **output, plcPyType *type) {
+    int   year, month, day;
+    char *str;
+
+    *output = NULL;
+    if (plc_datetime_init() != 0)
+        return -1;
+
+    if (PyDate_Check(input)) {
+        year  = PyDateTime_GET_YEAR(input);
+        month = PyDateTime_GET_MONTH(input);
+        day   = PyDateTime_GET_DAY(input);
+    } else if ((str = plc_pystring_as_cstring(input)) != NULL) {
+        const char *pos = str;
+        int res;
+
+        while (*pos == ' ')
+            pos += 1;
+        res = plc_parse_iso_date(&pos, &year, &month, &day);
+        if (res == 0 && *pos != '\0')
+            res = -1;
+        free(str);
+        if (res != 0)
+            return plc_pyobject_as_temporal_text(input, output, type);
+    } else {
+        return plc_pyobject_as_temporal_text(input, output, type);
+    }
+
+    *output = (char*)malloc(4);
+    *((int*)*output) = plc_date2j(year, month, day) - PLC_POSTGRES_EPOCH_JDATE;
+    return 0;
+}
+
+static int plc_pyobject_as_time(PyObject *input, char **output, plcPyType *type) {
+    int   hour, minute, second, usec;
+    char *str;
+
+    *output = NULL;
+    if (plc_datetime_init() != 0)
+        return -1;
+
+    if (PyTime_Check(input)) {
+        hour   = PyDateTime_TIME_GET_HOUR(input);
+        minute = PyDateTime_TIME_GET_MINUTE(input);
+        second = PyDateTime_TIME_GET_SECOND(input);
+        usec   = PyDateTime_TIME_GET_MICROSECOND(input);
+    } else if ((str = plc_pystring_as_cstring(input)) != NULL) {
+        const char *pos = str;
+        int res;
+
+        while (*pos == ' ')
+            pos += 1;
+        res = plc_parse_iso_time(&pos, &hour, &minute, &second, &usec);
+        if (res == 0 && *pos != '\0')
+            res = -1;
+        free(str);
+        if (res != 0)
+            return plc_pyobject_as_temporal_text(input, output, type);
+    } else {
+        return plc_pyobject_as_temporal_text(input, output, type);
+    }
+
+    *output = (char*)malloc(8);
+    *((long long*)*output) = ((hour * 60LL + minute) * 60 + second) * PLC_USECS_PER_SEC + usec;
+    return 0;
+}
+
+/* Hours of interval are not limited to 24, but to what fits into int64
+ * microseconds */
+#define PLC_INTERVAL_MAX_HOURS 2562047787LL
+
+/* Parses interval string in the formats produced by Greenplum and by Python
+ * timedelta, like "1 year 2 mons 3 days 04:05:06", "@ 3 days 4 hours ago"
+ * or "3 days, 4:05:06.5". Returns -1 for anything else, which is left to
+ * the backend */
+static int plc_parse_interval(const char *str, plcInterval *iv) {
+    int found = 0;
+
+    iv->time = 0;
+    iv->day = 0;
+    iv->month = 0;
+
+    while (*str != '\0') {
+        char   *end;
+        double  value;
+        int     len;
+
+        if (*str == ' ' || *str == ',' || *str == '@') {
+            str += 1;
+            continue;
+        }
+        if (strncmp(str, "ago", 3) == 0) {
+            iv->time = -iv->time;
+            iv->day = -iv->day;
+            iv->month = -iv->month;
+            str += 3;
+            continue;
+        }
+
+        value = strtod(str, &end);
+        if (end == str)
+            return -1;
+
+        if (*end == ':') {
+            /* [-]H+:MM[:SS[.ffffff]] */
+            long long hour = 0;
+            int minute, second, usec;
+            int sign = (*str == '-') ? -1 : 1;
+            const char *pos = str;
+
+            if (*pos == '-' || *pos == '+')
+                pos += 1;
+            while (*pos >= '0' && *pos <= '9' && hour <= PLC_INTERVAL_MAX_HOURS) {
+                hour = hour * 10 + (*pos - '0');
+                pos += 1;
+            }
+            if (hour > PLC_INTERVAL_MAX_HOURS || *pos != ':')
+                return -1;
+            pos += 1;
+            if (plc_parse_iso_minutes(&pos, &minute, &second, &usec) != 0)
+                return -1;
+            iv->time += sign * (((hour * 60 + minute) * 60 + second) * PLC_USECS_PER_SEC + usec);
+            str = pos;
+            found = 1;
+            continue;
+        }
+
+        while (*end == ' ')
+            end += 1;
+        for (len = 0; end[len] >= 'a' && end[len] <= 'z'; len++);
+        if (len == 0) {
+            /* Number without unit means seconds */
+            iv->time += (long long)(value * PLC_USECS_PER_SEC);
+        } else if (strncmp(end, "year", 4) == 0 || strncmp(end, "yr", 2) == 0) {
+            iv->month += (int)(value * 12);
+        } else if (strncmp(end, "mon", 3) == 0) {
+            iv->month += (int)value;
+        } else if (strncmp(end, "week", 4) == 0) {
+            iv->day += (int)(value * 7);
+        } else if (strncmp(end, "day", 3) == 0) {
+            iv->day += (int)value;
+        } else if (strncmp(end, "hour", 4) == 0) {
+            iv->time += (long long)(value * 3600 * PLC_USECS_PER_SEC);
+        } else if (strncmp(end, "min", 3) == 0) {
+            iv->time += (long long)(value * 60 * PLC_USECS_PER_SEC);
+        } else if (strncmp(end, "sec", 3) == 0) {
+            iv->time += (long long)(value * PLC_USECS_PER_SEC);
+        } else {
+            return -1;
+        }
+        str = end + len;
+        found = 1;
+    }
+
+    return found ? 0 : -1;
+}
+
+static int plc_pyobject_as_interval(PyObject *input, char **output, plcPyType *type) {
+    plcInterval *iv;
+    char        *str;
+
+    *output = NULL;
+    if (plc_datetime_init() != 0)
+        return -1;
+
+    iv = (plcInterval*)malloc(sizeof(plcInterval));
+    if (PyDelta_Check(input)) {
+        iv->month = 0;
+        iv->day = PyDateTime_DELTA_GET_DAYS(input);
+        iv->time = PyDateTime_DELTA_GET_SECONDS(input) * PLC_USECS_PER_SEC
+                   + PyDateTime_DELTA_GET_MICROSECONDS(input);
+    } else if (PyInt_Check(input) || PyLong_Check(input) || PyFloat_Check(input)) {
+        /* Numbers are treated as number of seconds */
+        iv->month = 0;
+        iv->day = 0;
+        iv->time = (long long)(PyFloat_AsDouble(input) * PLC_USECS_PER_SEC);
+    } else if ((str = plc_pystring_as_cstring(input)) != NULL) {
+        int res = plc_parse_interval(str, iv);
+        free(str);
+        if (res != 0) {
+            free(iv);
+            return plc_pyobject_as_temporal_text(input, output, type);
+        }
+    } else {
+        free(iv);
+        return plc_pyobject_as_temporal_text(input, output, type);
+    }
+
+    iv->format = PLC_BINARY_FORMAT_BINARY;
+    *output = (char*)iv;
+    return 0;
+}
+
+static int plc_pyobject_as_uuid(PyObject *input, char **output, plcPyType *type UNUSED) {
+    char *out = (char*)malloc(PLC_UUID_LEN);
+    char *str;
+
+    *output = NULL;
+    if ((str = plc_pystring_as_cstring(input)) != NULL) {
+        /* Hex representation, with or without braces and hyphens */
+        int   ndigits = 0;
+        char *pos;
+
+        for (pos = str; *pos != '\0' && ndigits <= 2 * PLC_UUID_LEN; pos++) {
+            int digit;
+            if (*pos >= '0' && *pos <= '9')
+                digit = *pos - '0';
+            else if (*pos >= 'a' && *pos <= 'f')
+                digit = *pos - 'a' + 10;
+            else if (*pos >= 'A' && *pos <= 'F')
+                digit = *pos - 'A' + 10;
+            else if (*pos == '-' || *pos == '{' || *pos == '}')
+                continue;
+            else
+                break;
+            if (ndigits < 2 * PLC_UUID_LEN) {
+                if (ndigits % 2 == 0)
+                    out[ndigits / 2] = (char)(digit << 4);
+                else
+                    out[ndigits / 2] |= (char)digit;
+            }
+            ndigits += 1;
+        }
+        free(str);
+        if (ndigits != 2 * PLC_UUID_LEN || *pos != '\0') {
+            free(out);
+            raise_execution_error("Exception occurred transforming result object to uuid");
+            return -1;
+        }
+    } else {
+        /* uuid.UUID or any other object with "bytes" attribute */
+        PyObject *bytes = PyObject_GetAttrString(input, "bytes");
+        if (bytes == NULL || !PyBytes_Check(bytes) || PyBytes_Size(bytes) != PLC_UUID_LEN) {
+            Py_XDECREF(bytes);
+            free(out);
+            raise_execution_error("Exception occurred transforming result object to uuid");
+            return -1;
+        }
+        memcpy(out, PyBytes_AsString(bytes), PLC_UUID_LEN);
+        Py_DECREF(bytes);
+    }
+
+    *output = out;
+    return 0;
+}
+
+/* Strings are considered to be serialized JSON already, all the other objects
+ * are serialized with json.dumps() */
+static int plc_pyobject_as_json(PyObject *input, char **output, plcPyType *type UNUSED) {
+    PyObject *dumps;
+    PyObject *obj;
+
+    *output = plc_pystring_as_text(input);
+    if (*output != NULL)
+        return 0;
+
+    dumps = plc_get_json_function(1);
+    if (dumps == NULL)
+        return -1;
+
+    obj = PyObject_CallFunctionObjArgs(dumps, input, NULL);
+    if (obj == NULL) {
+        raise_execution_error("Exception occurred transforming result object to json");
+        return -1;
+    }
+    *output = plc_pystring_as_text(obj);
+    Py_DECREF(obj);
+
+    return (*output == NULL) ? -1 : 0;
+}
+
+static char *plc_binary_value(char format, const char *data, size_t len) {
+    char *res = pmalloc(len + 5);
+
+    *((int*)res) = (int)len + 1;
+    res[4] = format;
+    memcpy(res + 5, data, len);
+    return res;
+}
+
+/* Bytes returned by the encoder, or by the function itself, are passed to the
+ * type's receive function, everything else is passed as text to its input
+ * function. Python 2 str is considered binary only when it comes from encoder */
+static int plc_pyobject_as_binary(PyObject *input, char **output, plcPyType *type) {
+    PyObject *encoder;
+    PyObject *obj;
+    char     *str;
+
+    encoder = plc_get_binary_type_function(type, 1);
+    if (encoder != NULL) {
+        obj = PyObject_CallFunctionObjArgs(encoder, input, NULL);
+        if (obj == NULL) {
+            raise_execution_error("Exception occurred encoding value of type '%s'", type->pgTypeName);
+            return -1;
+        }
+    } else {
+        Py_INCREF(input);
+        obj = input;
+    }
+
+    if (PyByteArray_Check(obj)) {
+        *output = plc_binary_value(PLC_BINARY_FORMAT_BINARY,
+                                   PyByteArray_AS_STRING(obj), PyByteArray_GET_SIZE(obj));
+    #if PY_MAJOR_VERSION >= 3
+    } else if (PyBytes_Check(obj)) {
+    #else
+    } else if (PyBytes_Check(obj) && encoder != NULL) {
+    #endif
+        *output = plc_binary_value(PLC_BINARY_FORMAT_BINARY,
+                                   PyBytes_AS_STRING(obj), PyBytes_GET_SIZE(obj));
+    } else {
+        str = plc_pystring_as_cstring(obj);
+        if (str == NULL) {
+            PyObject *strobj = PyObject_Str(obj);
+            if (strobj != NULL) {
+                str = plc_pystring_as_cstring(strobj);
+                Py_DECREF(strobj);
+            }
+        }
+        if (str == NULL) {
+            Py_DECREF(obj);
+            raise_execution_error("Exception occurred transforming result object to text");
+            return -1;
+        }
+        *output = plc_binary_value(PLC_BINARY_FORMAT_TEXT, str, strlen(str));
+        free(str);
+    }
+
+    Py_DECREF(obj);
+    return 0;
+}
+
 static plcPyInputFunc plc_get_input_function(plcDatatype dt, bool isArrayElement) {
     plcPyInputFunc res = NULL;
     switch (dt) {
@@ -540,17 +2068,39 @@ static plcPyInputFunc plc_get_input_function(plcDatatype dt, bool isArrayElement
             res = plc_pyobject_from_float8;
             break;
         case PLC_DATA_TEXT:
+            res = plc_pyobject_from_text;
+            break;
+        case PLC_DATA_BYTEA:
+            res = plc_pyobject_from_bytea;
+            break;
+        case PLC_DATA_TIMESTAMP:
+        case PLC_DATA_TIMESTAMPTZ:
+            res = plc_pyobject_from_timestamp;
+            break;
+        case PLC_DATA_DATE:
+            res = plc_pyobject_from_date;
+            break;
+        case PLC_DATA_TIME:
+            res = plc_pyobject_from_time;
+            break;
+        case PLC_DATA_INTERVAL:
+            res = plc_pyobject_from_interval;
+            break;
+        case PLC_DATA_UUID:
+            res = plc_pyobject_from_uuid;
+            break;
+        case PLC_DATA_JSON:
             if (isArrayElement) {
-                res = plc_pyobject_from_text_ptr;
+                res = plc_pyobject_from_json_ptr;
             } else {
-                res = plc_pyobject_from_text;
+                res = plc_pyobject_from_json;
             }
             break;
-        case PLC_DATA_BYTEA:
+        case PLC_DATA_BINARY:
             if (isArrayElement) {
-                res = plc_pyobject_from_bytea_ptr;
+                res = plc_pyobject_from_binary_ptr;
             } else {
-                res = plc_pyobject_from_bytea;
+                res = plc_pyobject_from_binary;
             }
             break;
         case PLC_DATA_ARRAY:
@@ -598,6 +2148,28 @@ static plcPyOutputFunc plc_get_output_function(plcDatatype dt) {
         case PLC_DATA_BYTEA:
             res = plc_pyobject_as_bytea;
             break;
+        case PLC_DATA_TIMESTAMP:
+        case PLC_DATA_TIMESTAMPTZ:
+            res = plc_pyobject_as_timestamp;
+            break;
+        case PLC_DATA_DATE:
+            res = plc_pyobject_as_date;
+            break;
+        case PLC_DATA_TIME:
+            res = plc_pyobject_as_time;
+            break;
+        case PLC_DATA_INTERVAL:
+            res = plc_pyobject_as_interval;
+            break;
+        case PLC_DATA_UUID:
+            res = plc_pyobject_as_uuid;
+            break;
+        case PLC_DATA_JSON:
+            res = plc_pyobject_as_json;
+            break;
+        case PLC_DATA_BINARY:
+            res = plc_pyobject_as_binary;
+            break;
         case PLC_DATA_ARRAY:
             res = plc_pyobject_as_array;
             break;
@@ -616,11 +2188,15 @@ static void plc_parse_type(plcPyType *pytype, plcType *type, char* argName, bool
     int i = 0;
 
     pytype->typeName = (type->typeName == NULL) ? NULL : strdup(type->typeName);
+    pytype->pgTypeName = (type->type != PLC_DATA_BINARY || type->pgTypeName == NULL)
+                         ? NULL : strdup(type->pgTypeName);
     pytype->argName = (argName == NULL) ? NULL : strdup(argName);
     pytype->type = type->type;
     pytype->nSubTypes = type->nSubTypes;
     pytype->conv.inputfunc  = plc_get_input_function(pytype->type, isArrayElement);
     pytype->conv.outputfunc = plc_get_output_function(pytype->type);
+    pytype->keys = NULL;
+    pytype->rowType = NULL;
     if (pytype->nSubTypes > 0) {
         bool isArray = (type->type == PLC_DATA_ARRAY) ? true : false;
         pytype->subTypes = (plcPyType*)malloc(pytype->nSubTypes * sizeof(plcPyType));
@@ -630,6 +2206,65 @@ static void plc_parse_type(plcPyType *pytype, plcType *type, char* argName, bool
     } else {
         pytype->subTypes = NULL;
     }
+
+    /* UDT field names are interned once, not for every converted value */
+    if (pytype->type == PLC_DATA_UDT && plc_py_unnamed_field(pytype) == pytype->nSubTypes) {
+        pytype->keys = PyTuple_New(pytype->nSubTypes);
+        for (i = 0; i < pytype->nSubTypes; i++) {
+            PyTuple_SET_ITEM(pytype->keys, i,
+                             PyString_InternFromString(pytype->subTypes[i].typeName));
+        }
+    }
+}
+
+/* Switches conversion of the UDT values in the type to namedtuples */
+static void plc_py_use_udt_tuples(plcPyType *type) {
+    int i;
+
+    if (type->conv.inputfunc == plc_pyobject_from_udt) {
+        type->conv.inputfunc = plc_pyobject_from_udt_tuple;
+    } else if (type->conv.inputfunc == plc_pyobject_from_udt_ptr) {
+        type->conv.inputfunc = plc_pyobject_from_udt_tuple_ptr;
+    }
+    for (i = 0; i < type->nSubTypes; i++) {
+        plc_py_use_udt_tuples(&type->subTypes[i]);
+    }
+}
+
+/*
+ * Whether the function option is on. The option is set with "# name: value"
+ * among the comment lines on top of the function source, and defaults to the
+ * container setting passed in the environment variable
+ */
+static bool plc_py_is_option_on(const char *src, const char *name, const char *setting) {
+    const char *value = plc_get_source_option(src, name);
+
+    return plc_is_setting_on(value != NULL ? value : getenv(setting));
+}
+
+/*
+ * Whether the name appears in the source as a separate identifier. Used to
+ * find the functions that never refer to "args" list, so it is not built for
+ * every call. Functions that can access their locals indirectly are taken as
+ * referring to it
+ */
+static bool plc_py_source_uses_args(const char *src) {
+    static const char *names[] = {"args", "locals", "vars", "eval", "exec",
+                                  "_getframe", "inspect"};
+    const char *p;
+    size_t      len;
+    size_t      i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        len = strlen(names[i]);
+        for (p = strstr(src, names[i]); p != NULL; p = strstr(p + 1, names[i])) {
+            if ((p == src || !(isalnum((unsigned char)p[-1]) || p[-1] == '_'))
+                    && !(isalnum((unsigned char)p[len]) || p[len] == '_')) {
+                return true;
+            }
+        }
+    }
+    return false;
 }
 
 plcPyFunction *plc_py_init_function(plcMsgCallreq *call) {
@@ -637,7 +2272,9 @@ plcPyFunction *plc_py_init_function(plcMsgCallreq *call) {
     int i;
 
     res = (plcPyFunction*)malloc(sizeof(plcPyFunction));
-    res->call = call;
+    res->call = NULL;
+    res->executing = 0;
+    res->replaced = 0;
     res->proc.src  = strdup(call->proc.src);
     res->proc.name = strdup(call->proc.name);
     res->nargs = call->nargs;
@@ -650,27 +2287,233 @@ plcPyFunction *plc_py_init_function(plcMsgCallreq *call) {
         plc_parse_type(&res->args[i], &call->args[i].type, call->args[i].name, false);
     }
 
+    /* Numeric array arguments can be passed as numpy arrays */
+    if (plc_py_is_option_on(call->proc.src, "numpy_arrays", "PLC_NUMPY_ARRAYS")) {
+        for (i = 0; i < res->nargs; i++) {
+            if (res->args[i].type == PLC_DATA_ARRAY
+                    && plc_get_numpy_dtype(res->args[i].subTypes[0].type) != NULL) {
+                res->args[i].conv.inputfunc = plc_pyobject_from_array_numpy;
+            }
+        }
+    }
+
+    /* Composite type arguments can be passed as namedtuples instead of dicts */
+    res->namedtupleRows = plc_py_is_option_on(call->proc.src, "namedtuple_rows",
+                                              "PLC_NAMEDTUPLE_ROWS");
+    if (res->namedtupleRows) {
+        for (i = 0; i < res->nargs; i++) {
+            plc_py_use_udt_tuples(&res->args[i]);
+        }
+    }
+
+    /* plpy.execute() can return the lazy result object instead of list */
+    res->lazyRows = plc_py_is_option_on(call->proc.src, "lazy_rows", "PLC_LAZY_ROWS");
+
     plc_parse_type(&res->res, &call->retType, "result", false);
 
+    res->pyfunc = NULL;
+    res->nNamedArgs = 0;
+    for (i = 0; i < res->nargs; i++) {
+        if (res->args[i].argName != NULL) {
+            res->nNamedArgs += 1;
+        }
+    }
+    res->usesArgs = plc_py_source_uses_args(call->proc.src);
+
     return res;
 }
 
-plcPyResult *plc_init_result_conversions(plcMsgResult *res) {
-    plcPyResult *pyres = NULL;
+/* Number of distinct result descriptors whose conversions are kept */
+#define PLC_PY_RESULT_CACHE_SIZE 16
+
+static plcPyResultConv *plcPyResultCache[PLC_PY_RESULT_CACHE_SIZE];
+
+static int plc_py_string_equal(const char *a, const char *b) {
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+    return strcmp(a, b) == 0;
+}
+
+/* Whether the conversion was made for the type received from the backend */
+static int plc_py_type_matches(plcPyType *pytype, plcType *type) {
     int i;
 
-    pyres = (plcPyResult*)malloc(sizeof(plcPyResult));
-    pyres->res = res;
-    pyres->args = (plcPyType*)malloc(res->cols * sizeof(plcPyType));
+    if (pytype->type != type->type || pytype->nSubTypes != type->nSubTypes
+            || !plc_py_string_equal(pytype->typeName, type->typeName)) {
+        return 0;
+    }
+    if (type->type == PLC_DATA_BINARY && !plc_py_string_equal(pytype->pgTypeName, type->pgTypeName)) {
+        return 0;
+    }
+    for (i = 0; i < type->nSubTypes; i++) {
+        if (!plc_py_type_matches(&pytype->subTypes[i], &type->subTypes[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int plc_py_result_conv_matches(plcPyResultConv *conv, plcMsgResult *res, int namedtuples) {
+    int i;
+
+    if (conv->cols != res->cols || conv->namedtuples != namedtuples) {
+        return 0;
+    }
+    for (i = 0; i < res->cols; i++) {
+        if (!plc_py_string_equal(conv->names[i], res->names[i])
+                || !plc_py_type_matches(&conv->args[i], &res->types[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static plcPyResultConv *plc_py_result_conv_new(plcMsgResult *res, int namedtuples) {
+    plcPyResultConv *conv;
+    int i;
+
+    conv = (plcPyResultConv*)malloc(sizeof(plcPyResultConv));
+    conv->refs = 1;
+    conv->cols = res->cols;
+    conv->names = (char**)malloc((res->cols + 1) * sizeof(char*));
+    conv->args = (plcPyType*)malloc((res->cols + 1) * sizeof(plcPyType));
+    conv->keys = PyTuple_New(res->cols);
+    conv->rowType = NULL;
+    conv->namedtuples = namedtuples;
 
     for (i = 0; i < res->cols; i++) {
-        plc_parse_type(&pyres->args[i], &res->types[i], NULL, false);
+        conv->names[i] = (res->names[i] == NULL) ? NULL : strdup(res->names[i]);
+        plc_parse_type(&conv->args[i], &res->types[i], NULL, false);
+        PyTuple_SET_ITEM(conv->keys, i, PyString_InternFromString(res->names[i]));
+    }
+
+    /* Rows are returned as namedtuples when the calling function has it turned on */
+    if (namedtuples) {
+        conv->rowType = plc_py_create_row_type("row", conv->keys);
+        if (conv->rowType == NULL) {
+            PyErr_Clear();
+        }
+        for (i = 0; i < res->cols; i++) {
+            plc_py_use_udt_tuples(&conv->args[i]);
+        }
+    }
+
+    return conv;
+}
+
+static void plc_py_result_conv_release(plcPyResultConv *conv) {
+    int i;
+
+    conv->refs -= 1;
+    if (conv->refs > 0) {
+        return;
+    }
+    for (i = 0; i < conv->cols; i++) {
+        plc_py_free_type(&conv->args[i]);
+        if (conv->names[i] != NULL) {
+            free(conv->names[i]);
+        }
+    }
+    Py_XDECREF(conv->keys);
+    Py_XDECREF(conv->rowType);
+    free(conv->args);
+    free(conv->names);
+    free(conv);
+}
+
+/* Conversions for the result columns, the cache is kept in LRU order */
+static plcPyResultConv *plc_py_result_conv_get(plcMsgResult *res, int namedtuples) {
+    plcPyResultConv *conv = NULL;
+    int i;
+
+    for (i = 0; i < PLC_PY_RESULT_CACHE_SIZE && plcPyResultCache[i] != NULL; i++) {
+        if (plc_py_result_conv_matches(plcPyResultCache[i], res, namedtuples)) {
+            conv = plcPyResultCache[i];
+            break;
+        }
+    }
+
+    if (conv == NULL) {
+        conv = plc_py_result_conv_new(res, namedtuples);
+        if (i == PLC_PY_RESULT_CACHE_SIZE) {
+            i -= 1;
+            plc_py_result_conv_release(plcPyResultCache[i]);
+        }
+        /* reference of the cache */
+        conv->refs += 1;
     }
+    for (; i > 0; i--) {
+        plcPyResultCache[i] = plcPyResultCache[i - 1];
+    }
+    plcPyResultCache[0] = conv;
+
+    conv->refs += 1;
+    return conv;
+}
+
+plcPyResult *plc_init_result_conversions(plcMsgResult *res, int namedtuples) {
+    plcPyResult *pyres = NULL;
+
+    pyres = (plcPyResult*)malloc(sizeof(plcPyResult));
+    pyres->res = res;
+    pyres->conv = plc_py_result_conv_get(res, namedtuples);
+    pyres->args = pyres->conv->args;
+    pyres->keys = pyres->conv->keys;
+    pyres->rowType = pyres->conv->rowType;
 
     return pyres;
 }
 
-static void plc_py_free_type(plcPyType *type) {
+/* Conversion of a standalone value type, like the argument of the plan */
+void plc_py_parse_type(plcPyType *pytype, plcType *type) {
+    plc_parse_type(pytype, type, NULL, false);
+}
+
+/* Converts the row of the result to namedtuple or dict keyed by column names */
+PyObject *plc_pyobject_from_result_row(plcPyResult *res, int row) {
+    rawdata  *data = res->res->data[row];
+    PyObject *pyrow;
+    PyObject *pyval;
+    int       j;
+
+    if (res->rowType != NULL) {
+        pyrow = plc_py_new_row(res->rowType, res->res->cols);
+    } else {
+        pyrow = PyDict_New();
+    }
+    if (pyrow == NULL) {
+        return NULL;
+    }
+
+    for (j = 0; j < res->res->cols; j++) {
+        if (data[j].isnull) {
+            Py_INCREF(Py_None);
+            pyval = Py_None;
+        } else {
+            pyval = res->args[j].conv.inputfunc(data[j].value, &res->args[j]);
+            if (pyval == NULL) {
+                Py_DECREF(pyrow);
+                return NULL;
+            }
+        }
+
+        if (res->rowType != NULL) {
+            PyTuple_SET_ITEM(pyrow, j, pyval);
+        } else {
+            int rc = PyDict_SetItem(pyrow, PyTuple_GET_ITEM(res->keys, j), pyval);
+            Py_DECREF(pyval);
+            if (rc != 0) {
+                Py_DECREF(pyrow);
+                return NULL;
+            }
+        }
+    }
+
+    return pyrow;
+}
+
+void plc_py_free_type(plcPyType *type) {
     int i = 0;
     if (type->typeName != NULL) {
         free(type->typeName);
@@ -678,10 +2521,15 @@ static void plc_py_free_type(plcPyType *type) {
     if (type->argName != NULL) {
         free(type->argName);
     }
+    if (type->pgTypeName != NULL) {
+        free(type->pgTypeName);
+    }
     for (i = 0; i < type->nSubTypes; i++)
         plc_py_free_type(&type->subTypes[i]);
     if (type->nSubTypes > 0)
         free(type->subTypes);
+    Py_XDECREF(type->keys);
+    Py_XDECREF(type->rowType);
     return;
 }
 
@@ -690,6 +2538,7 @@ void plc_py_free_function(plcPyFunction *func) {
     for (i = 0; i < func->nargs; i++)
         plc_py_free_type(&func->args[i]);
     plc_py_free_type(&func->res);
+    Py_XDECREF(func->pyfunc);
     Py_DECREF(func->pySD);
     free(func->args);
     free(func->proc.src);
@@ -698,10 +2547,7 @@ void plc_py_free_function(plcPyFunction *func) {
 }
 
 void plc_free_result_conversions(plcPyResult *res) {
-    int i = 0;
-    for (i = 0; i < res->res->cols; i++) {
-        plc_py_free_type(&res->args[i]);
-    }
+    plc_py_result_conv_release(res->conv);
     free(res);
 }
 
@@ -709,6 +2555,7 @@ void plc_py_copy_type(plcType *type, plcPyType *pytype) {
     type->type = pytype->type;
     type->nSubTypes = pytype->nSubTypes;
     type->typeName = (pytype->typeName == NULL) ? NULL : strdup(pytype->typeName);
+    type->pgTypeName = (pytype->pgTypeName == NULL) ? NULL : strdup(pytype->pgTypeName);
     if (type->nSubTypes > 0) {
         int i = 0;
         type->subTypes = (plcType*)pmalloc(type->nSubTypes * sizeof(plcType));
@@ -43,19 +43,41 @@ struct plcPyType {
     plcDatatype    type;
     char          *argName;
     char          *typeName;
+    char          *pgTypeName;
     int            nSubTypes;
     plcPyType     *subTypes;
     plcPyTypeConv  conv;
+    PyObject      *keys;    /* tuple of interned field names for UDT */
+    PyObject      *rowType; /* namedtuple type for UDT, created on demand */
 };
 
-typedef struct plcPyResult {
-    plcMsgResult *res;
+/*
+ * Conversions of the result columns, shared by the results with the same
+ * column names and types, so that a repeated query has no type setup
+ */
+typedef struct plcPyResultConv {
+    int           refs;     /* results using it, plus one while it is cached */
+    int           cols;
+    char        **names;
     plcPyType    *args;
+    PyObject     *keys;     /* tuple of interned column names */
+    PyObject     *rowType;  /* namedtuple type for rows, NULL for dicts */
+    int           namedtuples;  /* whether rows are converted to namedtuples */
+} plcPyResultConv;
+
+typedef struct plcPyResult {
+    plcMsgResult    *res;
+    plcPyResultConv *conv;
+    plcPyType       *args;     /* taken from conv */
+    PyObject        *keys;
+    PyObject        *rowType;
 } plcPyResult;
 
 typedef struct plcPyFunction {
     plcProcSrc     proc;
-    plcMsgCallreq *call;
+    plcMsgCallreq *call;        // request of the innermost call in progress
+    int            executing;   // number of calls in progress, nested included
+    int            replaced;    // replaced in the cache while executing, freed by the last call
     PyObject      *pyProc;
     int            nargs;
     plcPyType     *args;
@@ -64,12 +86,24 @@ typedef struct plcPyFunction {
     unsigned int   objectid;
     PyObject      *pyfunc;
     PyObject      *pySD;
+    /* Invocation plan, prepared once when the function is compiled */
+    int            nNamedArgs;  // number of arguments passed by name
+    int            usesArgs;    // whether the source might refer to "args"
+    int            namedtupleRows; // whether rows are passed as namedtuples
+    int            lazyRows;    // whether plpy.execute() rows are converted on access
 } plcPyFunction;
 
 void plc_py_copy_type(plcType *type, plcPyType *pytype);
+void plc_py_parse_type(plcPyType *pytype, plcType *type);
+void plc_py_free_type(plcPyType *type);
+
+PyObject *plpy_register_binary_type(PyObject *self, PyObject *args, PyObject *kwds);
 
 plcPyFunction *plc_py_init_function(plcMsgCallreq *call);
-plcPyResult  *plc_init_result_conversions(plcMsgResult *res);
+plcPyResult  *plc_init_result_conversions(plcMsgResult *res, int namedtuples);
+PyObject *plc_pyobject_from_result_row(plcPyResult *res, int row);
+bool plc_py_numpy_supported(plcDatatype type);
+PyObject *plc_py_numpy_from_data(char *data, int size, plcDatatype type);
 void plc_py_free_function(plcPyFunction *func);
 void plc_free_result_conversions(plcPyResult *res);
 
@@ -14,6 +14,7 @@
 #include "common/comm_connectivity.h"
 #include "pycall.h"
 #include "pyerror.h"
+#include "pyspi.h"
 
 #include <Python.h>
 
@@ -140,6 +141,7 @@ void plc_raise_delayed_error() {
         if (plc_is_execution_terminated == 0 &&
                 plcconn_global != NULL &&
                 plc_sending_data == 0) {
+            plc_future_complete_pending();
             plcontainer_channel_send(plcconn_global, (plcMessage*)plcLastErrMessage);
             free_error(plcLastErrMessage);
             plcLastErrMessage = NULL;
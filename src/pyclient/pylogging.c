@@ -8,6 +8,7 @@
 
 #include "pycall.h"
 #include "pylogging.h"
+#include "pyspi.h"
 #include "common/messages/messages.h"
 #include "common/comm_channel.h"
 #include "common/comm_utils.h"
@@ -15,6 +16,7 @@
 #include <Python.h>
 
 static PyObject *plpy_output(volatile int, PyObject*, PyObject*);
+static int plpy_log_level_output(int level);
 
 PyObject *plpy_debug(PyObject *self, PyObject *args)
 {
@@ -51,6 +53,16 @@ PyObject *plpy_fatal(PyObject *self, PyObject *args)
     return plpy_output(FATAL, self, args);
 }
 
+/*
+ * Whether the message of this level would be output by the backend. LOG goes
+ * to the server log and INFO to the client regardless of the settings
+ */
+static int plpy_log_level_output(int level)
+{
+    return level >= plc_log_level || level >= ERROR
+           || level == LOG || level == INFO;
+}
+
 static PyObject *plpy_output(volatile int level, PyObject *self UNUSED, PyObject *args)
 {
     PyObject *volatile so;
@@ -59,7 +71,7 @@ static PyObject *plpy_output(volatile int level, PyObject *self UNUSED, PyObject
     plcConn           *conn = plcconn_global;
     plcMsgLog         *msg;
 
-    if (plc_is_execution_terminated == 0) {
+    if (plc_is_execution_terminated == 0 && plpy_log_level_output(level)) {
         if (PyTuple_Size(args) == 1) {
             /*
              * Treat single argument specially to avoid undesirable ('tuple',)
@@ -86,6 +98,11 @@ static PyObject *plpy_output(volatile int level, PyObject *self UNUSED, PyObject
         msg->level = level;
         msg->message = sv;
 
+        /*
+         * Log message is sent after the answer to the statement in flight. It
+         * is buffered and goes to the backend with the next message
+         */
+        plc_future_complete_pending();
         plcontainer_channel_send(conn, (plcMessage*)msg);
 
         /*
@@ -0,0 +1,90 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pyprofile.h"
+#include "common/comm_utils.h"
+
+/*
+ * Profiles are kept for every function called by the client, including the
+ * ones evicted from the function cache, so the counters are never reset
+ */
+typedef struct plcPyProfileEntry {
+    plcFunctionStats          stats;
+    struct plcPyProfileEntry *next;
+} plcPyProfileEntry;
+
+static plcPyProfileEntry *plcPyProfiles[PLC_PY_PROFILE_BUCKETS];
+static int                plcPyProfileCount = 0;
+
+plcFunctionStats *plc_py_profile_current = NULL;
+
+long long plc_py_profile_clock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+plcFunctionStats *plc_py_profile_function(unsigned int objectid) {
+    /* Knuth's multiplicative hash spreads the sequential objectids */
+    unsigned int        hash = objectid * 2654435761U;
+    plcPyProfileEntry **bucket;
+    plcPyProfileEntry  *entry;
+
+    bucket = &plcPyProfiles[(hash >> 16) & (PLC_PY_PROFILE_BUCKETS - 1)];
+    for (entry = *bucket; entry != NULL; entry = entry->next) {
+        if (entry->stats.objectid == objectid) {
+            return &entry->stats;
+        }
+    }
+
+    entry = malloc(sizeof(plcPyProfileEntry));
+    memset(&entry->stats, 0, sizeof(plcFunctionStats));
+    entry->stats.objectid = objectid;
+    entry->next = *bucket;
+    *bucket = entry;
+    plcPyProfileCount += 1;
+    return &entry->stats;
+}
+
+void plc_py_profile_call_done(plcFunctionStats *stats, long long elapsed) {
+    long long limit = 10;
+    int       i;
+
+    for (i = 0; i < PLC_STATS_HISTOGRAM_BUCKETS - 1 && elapsed >= limit; i++) {
+        limit *= 10;
+    }
+    stats->histogram[i] += 1;
+}
+
+void plc_py_profile_spi(long long elapsed, int statements) {
+    if (plc_py_profile_current != NULL) {
+        plc_py_profile_current->spiCalls += statements;
+        plc_py_profile_current->spiTime += elapsed;
+    }
+}
+
+plcFunctionStats *plc_py_profile_all(int *nfunctions) {
+    plcFunctionStats  *res;
+    plcPyProfileEntry *entry;
+    int                i;
+    int                n = 0;
+
+    res = pmalloc((plcPyProfileCount > 0 ? plcPyProfileCount : 1) * sizeof(plcFunctionStats));
+    for (i = 0; i < PLC_PY_PROFILE_BUCKETS; i++) {
+        for (entry = plcPyProfiles[i]; entry != NULL; entry = entry->next) {
+            res[n++] = entry->stats;
+        }
+    }
+    *nfunctions = n;
+    return res;
+}
@@ -0,0 +1,35 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef PLC_PYPROFILE_H
+#define PLC_PYPROFILE_H
+
+#include "common/messages/messages.h"
+
+/* Number of hash table buckets, power of 2 */
+#define PLC_PY_PROFILE_BUCKETS 256
+
+/* Profile of the function being executed, NULL between the calls */
+extern plcFunctionStats *plc_py_profile_current;
+
+/* Monotonic clock in microseconds */
+long long plc_py_profile_clock(void);
+
+/* Profile of the function, created on the first call */
+plcFunctionStats *plc_py_profile_function(unsigned int objectid);
+
+/* Accounts the completed call of the function in the histogram */
+void plc_py_profile_call_done(plcFunctionStats *stats, long long elapsed);
+
+/* Accounts the time spent sending SQL statements or waiting for their results */
+void plc_py_profile_spi(long long elapsed, int statements);
+
+/* Copy of all the profiles, to be freed by the caller */
+plcFunctionStats *plc_py_profile_all(int *nfunctions);
+
+#endif /* PLC_PYPROFILE_H */
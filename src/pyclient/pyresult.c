@@ -0,0 +1,437 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/comm_utils.h"
+#include "pycall.h"
+#include "pyerror.h"
+#include "pyresult.h"
+
+#include <Python.h>
+
+/*
+ * Result of plpy.execute() is a list of rows, which also keeps the received
+ * result set for the column accessors. The rows are converted when the result
+ * is created, unless the function turns on "lazy_rows" option
+ */
+typedef struct plcPyResultListObject {
+    PyListObject  list;
+    plcPyResult  *result;
+} plcPyResultListObject;
+
+/*
+ * Lazy result object keeps the received result set and converts the rows to
+ * Python objects on first access only. Converted rows are kept, so that the
+ * same row object is returned each time it is accessed. It is a sequence but
+ * not a list, so it cannot be extended or passed where list is required
+ */
+typedef struct plcPyResultObject {
+    PyObject_HEAD
+    plcPyResult  *result;
+    PyObject    **rows;
+} plcPyResultObject;
+
+static PyTypeObject plc_result_list_type;
+static PyTypeObject plc_result_type;
+
+static Py_ssize_t plc_result_length(PyObject *self);
+
+/* Received result of either object, NULL with exception set if there is none */
+static plcPyResult *plc_result_get(PyObject *self) {
+    plcPyResult *result;
+
+    if (Py_TYPE(self) == &plc_result_type) {
+        result = ((plcPyResultObject*)self)->result;
+    } else {
+        result = ((plcPyResultListObject*)self)->result;
+    }
+    if (result == NULL) {
+        PyErr_SetString(PyExc_ValueError, "result object has no result set");
+    }
+    return result;
+}
+
+static void plc_result_list_dealloc(PyObject *self) {
+    plcPyResult *result = ((plcPyResultListObject*)self)->result;
+
+    if (result != NULL) {
+        plcMsgResult *res = result->res;
+
+        plc_free_result_conversions(result);
+        free_result(res, false);
+    }
+    PyList_Type.tp_dealloc(self);
+}
+
+static void plc_result_dealloc(PyObject *self) {
+    plcPyResultObject *obj = (plcPyResultObject*)self;
+    plcMsgResult      *res = obj->result->res;
+    int i;
+
+    if (obj->rows != NULL) {
+        for (i = 0; i < plc_result_length(self); i++) {
+            Py_XDECREF(obj->rows[i]);
+        }
+        free(obj->rows);
+    }
+    plc_free_result_conversions(obj->result);
+    free_result(res, false);
+    PyObject_Del(self);
+}
+
+/* Result without columns has no rows, its number of rows is the number of
+ * rows processed by the statement */
+static Py_ssize_t plc_result_length(PyObject *self) {
+    plcMsgResult *res = ((plcPyResultObject*)self)->result->res;
+
+    return (res->cols > 0) ? res->rows : 0;
+}
+
+static PyObject *plc_result_item(PyObject *self, Py_ssize_t i) {
+    plcPyResultObject *obj = (plcPyResultObject*)self;
+    PyObject          *row;
+
+    if (i < 0 || i >= plc_result_length(self)) {
+        PyErr_SetString(PyExc_IndexError, "result index out of range");
+        return NULL;
+    }
+
+    if (obj->rows[i] == NULL) {
+        obj->rows[i] = plc_pyobject_from_result_row(obj->result, (int)i);
+        if (obj->rows[i] == NULL) {
+            raise_execution_error("Error converting result row %d", (int)i);
+            return NULL;
+        }
+    }
+
+    row = obj->rows[i];
+    Py_INCREF(row);
+    return row;
+}
+
+/* All the rows in the given range as list */
+static PyObject *plc_result_list(PyObject *self, Py_ssize_t start, Py_ssize_t step,
+                                 Py_ssize_t len) {
+    PyObject   *list;
+    Py_ssize_t  i;
+
+    list = PyList_New(len);
+    if (list == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < len; i++) {
+        PyObject *row = plc_result_item(self, start + i * step);
+        if (row == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, row);
+    }
+    return list;
+}
+
+static PyObject *plc_result_subscript(PyObject *self, PyObject *key) {
+    Py_ssize_t rows = plc_result_length(self);
+
+    if (PySlice_Check(key)) {
+        Py_ssize_t start, stop, step, len;
+#if PY_MAJOR_VERSION < 3
+        if (PySlice_GetIndicesEx((PySliceObject*)key, rows, &start, &stop, &step, &len) < 0) {
+#else
+        if (PySlice_GetIndicesEx(key, rows, &start, &stop, &step, &len) < 0) {
+#endif
+            return NULL;
+        }
+        return plc_result_list(self, start, step, len);
+    } else {
+        Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if (i == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (i < 0) {
+            i += rows;
+        }
+        return plc_result_item(self, i);
+    }
+}
+
+static PyObject *plc_result_repr(PyObject *self) {
+    PyObject *list;
+    PyObject *res;
+
+    list = plc_result_list(self, 0, 1, plc_result_length(self));
+    if (list == NULL) {
+        return NULL;
+    }
+    res = PyObject_Repr(list);
+    Py_DECREF(list);
+    return res;
+}
+
+static PyObject *plc_result_nrows(PyObject *self, PyObject *args UNUSED) {
+    plcPyResult *result = plc_result_get(self);
+
+    if (result == NULL) {
+        return NULL;
+    }
+    return PyInt_FromLong(result->res->rows);
+}
+
+static PyObject *plc_result_colnames(PyObject *self, PyObject *args UNUSED) {
+    plcPyResult *result = plc_result_get(self);
+    PyObject    *list;
+    int          j;
+
+    if (result == NULL) {
+        return NULL;
+    }
+    list = PyList_New(result->res->cols);
+    if (list == NULL) {
+        return NULL;
+    }
+    for (j = 0; j < result->res->cols; j++) {
+        PyObject *name = PyTuple_GET_ITEM(result->keys, j);
+        Py_INCREF(name);
+        PyList_SET_ITEM(list, j, name);
+    }
+    return list;
+}
+
+/* Number of the column given by its name or position, -1 if not found */
+static int plc_result_column_index(plcPyResult *result, PyObject *key) {
+    int j;
+
+    if (PyInt_Check(key) || PyLong_Check(key)) {
+        long index = PyLong_AsLong(key);
+        if (index < 0) {
+            index += result->res->cols;
+        }
+        if (index < 0 || index >= result->res->cols) {
+            PyErr_SetString(PyExc_IndexError, "column index out of range");
+            return -1;
+        }
+        return (int)index;
+    }
+
+    for (j = 0; j < result->res->cols; j++) {
+        int cmp = PyObject_RichCompareBool(PyTuple_GET_ITEM(result->keys, j), key, Py_EQ);
+        if (cmp < 0) {
+            return -1;
+        }
+        if (cmp > 0) {
+            return j;
+        }
+    }
+    PyErr_SetObject(PyExc_KeyError, key);
+    return -1;
+}
+
+/*
+ * Converts a single column of the result. Numeric columns without NULLs are
+ * returned as numpy arrays when numpy is available, all the other columns
+ * are returned as lists
+ */
+static PyObject *plc_result_convert_column(plcPyResult *result, int j) {
+    plcMsgResult *res = result->res;
+    plcPyType    *type = &result->args[j];
+    PyObject     *list;
+    int           i;
+
+    if (res->rows > 0 && plc_py_numpy_supported(type->type)) {
+        int   len = plc_get_type_length(type->type);
+        char *data;
+
+        for (i = 0; i < res->rows; i++) {
+            if (res->data[i][j].isnull) {
+                break;
+            }
+        }
+        if (i == res->rows) {
+            data = pmalloc((size_t)res->rows * len);
+            for (i = 0; i < res->rows; i++) {
+                memcpy(data + (size_t)i * len, res->data[i][j].value, len);
+            }
+            return plc_py_numpy_from_data(data, res->rows, type->type);
+        }
+    }
+
+    list = PyList_New(res->rows);
+    if (list == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < res->rows; i++) {
+        PyObject *value;
+
+        if (res->data[i][j].isnull) {
+            Py_INCREF(Py_None);
+            value = Py_None;
+        } else {
+            value = type->conv.inputfunc(res->data[i][j].value, type);
+            if (value == NULL) {
+                Py_DECREF(list);
+                return NULL;
+            }
+        }
+        PyList_SET_ITEM(list, i, value);
+    }
+    return list;
+}
+
+static PyObject *plc_result_column(PyObject *self, PyObject *key) {
+    plcPyResult *result = plc_result_get(self);
+    int          j;
+
+    if (result == NULL) {
+        return NULL;
+    }
+    j = plc_result_column_index(result, key);
+    if (j < 0) {
+        return NULL;
+    }
+    return plc_result_convert_column(result, j);
+}
+
+/* Dictionary of all the columns, which can be passed to pandas.DataFrame */
+static PyObject *plc_result_columns(PyObject *self, PyObject *args UNUSED) {
+    plcPyResult *result = plc_result_get(self);
+    PyObject    *dict;
+    int          j;
+
+    if (result == NULL) {
+        return NULL;
+    }
+    dict = PyDict_New();
+    if (dict == NULL) {
+        return NULL;
+    }
+    for (j = 0; j < result->res->cols; j++) {
+        PyObject *column = plc_result_convert_column(result, j);
+        if (column == NULL || PyDict_SetItem(dict, PyTuple_GET_ITEM(result->keys, j), column) != 0) {
+            Py_XDECREF(column);
+            Py_DECREF(dict);
+            return NULL;
+        }
+        Py_DECREF(column);
+    }
+    return dict;
+}
+
+static PyMethodDef plc_result_methods[] = {
+    {"nrows",    plc_result_nrows,    METH_NOARGS, NULL},
+    {"colnames", plc_result_colnames, METH_NOARGS, NULL},
+    {"column",   plc_result_column,   METH_O,      NULL},
+    {"columns",  plc_result_columns,  METH_NOARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PySequenceMethods plc_result_as_sequence;
+static PyMappingMethods  plc_result_as_mapping;
+
+static int plc_result_type_ready(void) {
+    if (plc_result_type.tp_flags & Py_TPFLAGS_READY) {
+        return 0;
+    }
+
+    plc_result_as_sequence.sq_length = plc_result_length;
+    plc_result_as_sequence.sq_item = plc_result_item;
+    plc_result_as_mapping.mp_length = plc_result_length;
+    plc_result_as_mapping.mp_subscript = plc_result_subscript;
+
+    /* Static type objects live forever, so they start with a reference */
+#if PY_MAJOR_VERSION < 3
+    plc_result_list_type.ob_refcnt = 1;
+    plc_result_type.ob_refcnt = 1;
+#else
+    plc_result_list_type.ob_base.ob_base.ob_refcnt = 1;
+    plc_result_type.ob_base.ob_base.ob_refcnt = 1;
+#endif
+    /* Everything else, including the garbage collection, comes from list */
+    plc_result_list_type.tp_name = "plpy.PLyResult";
+    plc_result_list_type.tp_basicsize = sizeof(plcPyResultListObject);
+    plc_result_list_type.tp_dealloc = plc_result_list_dealloc;
+    plc_result_list_type.tp_methods = plc_result_methods;
+    plc_result_list_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    plc_result_list_type.tp_base = &PyList_Type;
+    if (PyType_Ready(&plc_result_list_type) < 0) {
+        return -1;
+    }
+
+    plc_result_type.tp_name = "plpy.PLyLazyResult";
+    plc_result_type.tp_basicsize = sizeof(plcPyResultObject);
+    plc_result_type.tp_dealloc = plc_result_dealloc;
+    plc_result_type.tp_repr = plc_result_repr;
+    plc_result_type.tp_as_sequence = &plc_result_as_sequence;
+    plc_result_type.tp_as_mapping = &plc_result_as_mapping;
+    plc_result_type.tp_methods = plc_result_methods;
+    plc_result_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    return PyType_Ready(&plc_result_type);
+}
+
+/* The result is freed if the object cannot be created */
+static void plc_pyresult_free(plcPyResult *result) {
+    plcMsgResult *res = result->res;
+
+    raise_execution_error("Cannot allocate new result object in Python");
+    plc_free_result_conversions(result);
+    free_result(res, false);
+}
+
+/* Result list with all the rows converted */
+static PyObject *plc_pyresult_list_new(plcPyResult *result) {
+    plcPyResultListObject *obj;
+    int rows = (result->res->cols > 0) ? result->res->rows : 0;
+    int i;
+
+    obj = (plcPyResultListObject*)plc_result_list_type.tp_alloc(&plc_result_list_type, 0);
+    if (obj == NULL) {
+        plc_pyresult_free(result);
+        return NULL;
+    }
+    obj->result = result;
+
+    for (i = 0; i < rows; i++) {
+        PyObject *row = plc_pyobject_from_result_row(result, i);
+        if (row == NULL || PyList_Append((PyObject*)obj, row) != 0) {
+            raise_execution_error("Error converting result row %d", i);
+            Py_XDECREF(row);
+            /* the result is freed together with the list */
+            Py_DECREF(obj);
+            return NULL;
+        }
+        Py_DECREF(row);
+    }
+
+    return (PyObject*)obj;
+}
+
+/* Lazy result object, the rows are converted on access */
+static PyObject *plc_pyresult_lazy_new(plcPyResult *result) {
+    plcPyResultObject *obj;
+    int rows = result->res->rows;
+
+    obj = PyObject_New(plcPyResultObject, &plc_result_type);
+    if (obj == NULL) {
+        plc_pyresult_free(result);
+        return NULL;
+    }
+    obj->result = result;
+    obj->rows = (PyObject**)calloc(rows > 0 ? rows : 1, sizeof(PyObject*));
+
+    return (PyObject*)obj;
+}
+
+PyObject *plc_pyresult_new(plcPyResult *result, int lazy) {
+    if (plc_result_type_ready() < 0) {
+        plc_pyresult_free(result);
+        return NULL;
+    }
+
+    return lazy ? plc_pyresult_lazy_new(result) : plc_pyresult_list_new(result);
+}
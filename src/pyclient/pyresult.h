@@ -0,0 +1,19 @@
+/*------------------------------------------------------------------------------
+ *
+ *
+ * Copyright (c) 2016, Pivotal.
+ *
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef PLC_PYRESULT_H
+#define PLC_PYRESULT_H
+
+#include <Python.h>
+#include "pyconversions.h"
+
+/* Result of plpy.execute(), takes over the result and its conversions and
+ * frees them on error. Lazy result converts the rows on access */
+PyObject *plc_pyresult_new(plcPyResult *result, int lazy);
+
+#endif /* PLC_PYRESULT_H */
@@ -5,56 +5,759 @@
  *
  *------------------------------------------------------------------------------
  */
+#include <stdlib.h>
+
 #include "common/comm_channel.h"
 #include "common/comm_utils.h"
+#include "common/comm_trace.h"
 #include "pycall.h"
 #include "pyerror.h"
 #include "pyconversions.h"
+#include "pyprofile.h"
+#include "pyresult.h"
 
 #include <Python.h>
 
-PyObject *plpy_execute(PyObject *self UNUSED, PyObject *pyquery);
+PyObject *plpy_execute(PyObject *self UNUSED, PyObject *args);
+PyObject *plpy_prepare(PyObject *self UNUSED, PyObject *args);
+PyObject *plpy_cursor(PyObject *self UNUSED, PyObject *args);
+PyObject *plpy_subtransaction(PyObject *self UNUSED, PyObject *args UNUSED);
+PyObject *plpy_insert(PyObject *self UNUSED, PyObject *args);
+PyObject *plpy_execute_many(PyObject *self UNUSED, PyObject *args);
+PyObject *plpy_execute_async(PyObject *self UNUSED, PyObject *args);
+void plc_future_complete_pending(void);
+
+/* Number of rows fetched at once when iterating over the cursor */
+#define PLC_CURSOR_BATCH_SIZE_DEFAULT 1000
+
+/* Number of rows sent in a single message by plpy.insert() */
+#define PLC_INSERT_BATCH_SIZE_DEFAULT 10000
+
+/* Plan prepared in the backend, released when the object is destroyed */
+typedef struct plcPyPlan {
+    PyObject_HEAD
+    int        planid;
+    int        nargs;
+    plcPyType *args;
+} plcPyPlan;
+
+static PyTypeObject plc_plan_type;
+
+/*
+ * Cursor opened in the backend. Iteration fetches the rows in batches, so
+ * that only a single batch is kept in memory. Rows fetched for iteration
+ * are not returned by fetch(), which continues after the current batch
+ */
+typedef struct plcPyCursor {
+    PyObject_HEAD
+    int         cursorid;
+    int         batchsize;
+    int         closed;
+    int         exhausted;
+    PyObject   *batch;      /* current batch of the iteration, NULL if none */
+    Py_ssize_t  pos;        /* next row of the batch to return */
+} plcPyCursor;
+
+static PyTypeObject plc_cursor_type;
+
+/*
+ * Explicit subtransaction used as context manager. All the statements
+ * executed inside of it share the subtransaction, which is rolled back if
+ * the block raises an exception
+ */
+typedef struct plcPySubxact {
+    PyObject_HEAD
+    int entered;
+    int exited;
+} plcPySubxact;
+
+static PyTypeObject plc_subxact_type;
+
+/*
+ * Result of the statement sent by plpy.execute_async(). Only one statement
+ * is in flight at a time: anything else sent to the backend would be read by
+ * it while the statement runs, possibly as a part of a nested call. So the
+ * result is received by result() or before the next message is sent
+ */
+typedef struct plcPyFuture {
+    PyObject_HEAD
+    int       done;
+    PyObject *result;                   /* result object, NULL on error */
+    PyObject *errtype;                  /* exception raised receiving the result */
+    PyObject *errvalue;
+    PyObject *errtraceback;
+} plcPyFuture;
+
+static PyTypeObject plc_future_type;
 
+/* Future waiting for the answer of the backend, holds a reference */
+static plcPyFuture *plcFuturePending = NULL;
+
+static void send_to_backend(plcMessage *msg);
 static plcMsgResult *receive_from_backend();
+static void plc_future_complete(plcPyFuture *future);
+static plcMsgResult *receive_handle_from_backend(int *handle);
+static plcMsgSQL *plc_new_sql(plcSqlType sqltype);
+static PyObject *plpy_result_from_backend();
+static PyObject *plpy_result_new(plcMsgResult *resp);
+static PyObject *plc_plan_new(plcMsgResult *resp, int planid);
+static int plc_plan_value(plcPyPlan *plan, int i, PyObject *value, rawdata *data);
+static plcMsgSQL *plc_plan_sql(plcPyPlan *plan, PyObject *pyargs, plcSqlType sqltype);
+static int plc_insert_row(plcMsgSQL *msg, plcPyPlan *plan, PyObject *names, PyObject *pyrow);
+static int plc_insert_send(plcMsgSQL *msg, long long *processed);
+static plcMsgSQL *plc_execute_sql(PyObject *args, const char *fname);
+static PyObject *plc_cursor_fetch_rows(plcPyCursor *cursor, int count);
+static plcMsgSQL *plc_batch_item_sql(PyObject *pyitem, plcPyPlan *plan, long limit);
+
+/* Sends the message once the backend has answered the statement in flight */
+static void send_to_backend(plcMessage *msg) {
+    long long start;
+
+    plc_future_complete_pending();
+    start = plc_py_profile_clock();
+    plc_trace_begin("SPI round trip");
+    plcontainer_channel_send(plcconn_global, msg);
+    plc_py_profile_spi(plc_py_profile_clock() - start, 1);
+}
 
 static plcMsgResult *receive_from_backend() {
     plcMessage *resp = NULL;
     int         res = 0;
     plcConn    *conn = plcconn_global;
+    long long   start = plc_py_profile_clock();
 
     res = plcontainer_channel_receive(conn, &resp);
+    plc_py_profile_spi(plc_py_profile_clock() - start, 0);
     if (res < 0) {
+        plc_trace_end("SPI round trip");
         raise_execution_error("Error receiving data from the backend, %d", res);
         return NULL;
     }
 
     switch (resp->msgtype) {
         case MT_CALLREQ:
+            /* Nested call is a part of the statement run by the backend */
+            start = plc_py_profile_clock();
             handle_call((plcMsgCallreq*)resp, conn);
+            plc_py_profile_spi(plc_py_profile_clock() - start, 0);
             free_callreq((plcMsgCallreq*)resp, false, false);
             return receive_from_backend();
         case MT_RESULT:
+            plc_trace_end("SPI round trip");
             break;
         default:
+            plc_trace_end("SPI round trip");
             raise_execution_error("Client cannot process message type %c", resp->msgtype);
             return NULL;
     }
     return (plcMsgResult*)resp;
 }
 
-/* plpy methods */
-PyObject *plpy_execute(PyObject *self UNUSED, PyObject *pyquery) {
-    int           i, j;
-    plcMsgSQL    *msg;
+static plcMsgSQL *plc_new_sql(plcSqlType sqltype) {
+    plcMsgSQL *msg;
+
+    msg            = malloc(sizeof(plcMsgSQL));
+    msg->msgtype   = MT_SQL;
+    msg->sqltype   = sqltype;
+    msg->statement = NULL;
+    msg->planid    = 0;
+    msg->cursorid  = 0;
+    msg->limit     = 0;
+    msg->nargs     = 0;
+    msg->argtypes  = NULL;
+    msg->args      = NULL;
+    msg->nrows     = 0;
+    msg->types     = NULL;
+    msg->rows      = NULL;
+    msg->nbatch    = 0;
+    msg->batch     = NULL;
+    return msg;
+}
+
+/* Receives the answer with the handle of the plan or cursor in the first column */
+static plcMsgResult *receive_handle_from_backend(int *handle) {
     plcMsgResult *resp;
-    PyObject     *pyresult,
-                 *pydict,
-                 *pyval;
+
+    resp = receive_from_backend();
+    if (resp == NULL) {
+        raise_execution_error("Error receiving data from backend");
+        return NULL;
+    }
+    if (resp->rows != 1 || resp->cols < 1 || resp->types[0].type != PLC_DATA_INT4
+            || resp->data[0][0].isnull) {
+        raise_execution_error("Backend returned malformed answer to the %s request",
+                              resp->cols > 0 ? resp->names[0] : "SQL");
+        free_result(resp, false);
+        return NULL;
+    }
+
+    *handle = *((int*)resp->data[0][0].value);
+    return resp;
+}
+
+/* Receives the result of the query and wraps it into result object */
+static PyObject *plpy_result_from_backend() {
+    plcMsgResult *resp;
+
+    resp = receive_from_backend();
+    if (resp == NULL) {
+        raise_execution_error("Error receiving data from backend");
+        return NULL;
+    }
+
+    return plpy_result_new(resp);
+}
+
+/* Wraps the result message into result object, the message is freed on error */
+static PyObject *plpy_result_new(plcMsgResult *resp) {
+    int           j;
     plcPyResult  *result;
-    plcConn      *conn = plcconn_global;
 
-    if (!PyString_Check(pyquery)) {
-        raise_execution_error("plpy module 'execute()' expected string object as input query");
+    /* rows are passed the way the function being executed takes them */
+    result = plc_init_result_conversions(resp, plc_py_current_function != NULL
+                                               && plc_py_current_function->namedtupleRows);
+
+    for (j = 0; j < result->res->cols; j++) {
+        if (result->args[j].conv.inputfunc == NULL) {
+            raise_execution_error("Type %d is not yet supported by Python container",
+                                  (int)result->args[j].type);
+            plc_free_result_conversions(result);
+            free_result(resp, false);
+            return NULL;
+        }
+    }
+
+    /* the result is kept for the column accessors and the lazy rows */
+    return plc_pyresult_new(result, plc_py_current_function != NULL
+                                    && plc_py_current_function->lazyRows);
+}
+
+static void plc_plan_dealloc(PyObject *self) {
+    plcPyPlan *plan = (plcPyPlan*)self;
+    int        i;
+
+    /* Plan is released in the backend unless the connection is not usable */
+    if (plcconn_global != NULL && plc_sending_data == 0 && plc_is_execution_terminated == 0) {
+        plcMsgSQL *msg = plc_new_sql(SQL_TYPE_UNPREPARE);
+        msg->planid = plan->planid;
+        send_to_backend((plcMessage*)msg);
+        free_sql(msg, true, true);
+    }
+
+    for (i = 0; i < plan->nargs; i++) {
+        plc_py_free_type(&plan->args[i]);
+    }
+    free(plan->args);
+    PyObject_Del(self);
+}
+
+static int plc_plan_type_ready(void) {
+    if (plc_plan_type.tp_flags & Py_TPFLAGS_READY) {
+        return 0;
+    }
+
+    /* Static type object lives forever, so it starts with a reference */
+#if PY_MAJOR_VERSION < 3
+    plc_plan_type.ob_refcnt = 1;
+#else
+    plc_plan_type.ob_base.ob_base.ob_refcnt = 1;
+#endif
+    plc_plan_type.tp_name = "plpy.PLyPlan";
+    plc_plan_type.tp_basicsize = sizeof(plcPyPlan);
+    plc_plan_type.tp_dealloc = plc_plan_dealloc;
+    plc_plan_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    return PyType_Ready(&plc_plan_type);
+}
+
+/* Plan object for the answer to the prepare request */
+static PyObject *plc_plan_new(plcMsgResult *resp, int planid) {
+    plcPyPlan *plan;
+    int        i;
+
+    plan = PyObject_New(plcPyPlan, &plc_plan_type);
+    if (plan == NULL) {
+        return NULL;
+    }
+    plan->planid = planid;
+    plan->nargs = resp->cols - 1;
+    plan->args = malloc((plan->nargs + 1) * sizeof(plcPyType));
+    for (i = 0; i < plan->nargs; i++) {
+        plc_py_parse_type(&plan->args[i], &resp->types[i + 1]);
+    }
+
+    return (PyObject*)plan;
+}
+
+/* Converts the value of the plan argument, Python exception is set on error */
+static int plc_plan_value(plcPyPlan *plan, int i, PyObject *value, rawdata *data) {
+    int ret = -1;
+
+    data->isnull = 1;
+    data->value = NULL;
+    if (value == Py_None) {
+        return 0;
+    }
+
+    data->isnull = 0;
+    if (plan->args[i].conv.outputfunc != NULL) {
+        ret = plan->args[i].conv.outputfunc(value, &data->value, &plan->args[i]);
+    }
+    if (ret != 0) {
+        raise_execution_error("Exception raised converting plan argument %d to type %s",
+                              i + 1, plc_get_type_name(plan->args[i].type));
+    }
+    return ret;
+}
+
+/* Message with the plan handle and the arguments converted for the plan */
+static plcMsgSQL *plc_plan_sql(plcPyPlan *plan, PyObject *pyargs, plcSqlType sqltype) {
+    plcMsgSQL *msg;
+    int        nargs = 0;
+    int        i;
+
+    if (pyargs != NULL && pyargs != Py_None) {
+        if (!PySequence_Check(pyargs) || PyString_Check(pyargs)) {
+            PyErr_SetString(PyExc_TypeError, "prepared plan takes a sequence of arguments");
+            return NULL;
+        }
+        nargs = PySequence_Length(pyargs);
+    }
+    if (nargs != plan->nargs) {
+        PyErr_Format(PyExc_TypeError, "prepared plan expects %d arguments, but %d were given",
+                     plan->nargs, nargs);
+        return NULL;
+    }
+
+    msg = plc_new_sql(sqltype);
+    msg->planid = plan->planid;
+    msg->args = malloc((plan->nargs + 1) * sizeof(plcArgument));
+    for (i = 0; i < plan->nargs; i++) {
+        PyObject    *value = PySequence_GetItem(pyargs, i);
+        plcArgument *arg = &msg->args[i];
+        int          ret;
+
+        arg->name = NULL;
+        arg->data.isnull = 1;
+        arg->data.value = NULL;
+        plc_py_copy_type(&arg->type, &plan->args[i]);
+        msg->nargs = i + 1;
+
+        if (value == NULL) {
+            free_sql(msg, true, true);
+            return NULL;
+        }
+        ret = plc_plan_value(plan, i, value, &arg->data);
+        Py_DECREF(value);
+        if (ret != 0) {
+            free_sql(msg, true, true);
+            return NULL;
+        }
+    }
+
+    return msg;
+}
+
+/*
+ * Adds the row to the insert message. The row is either a sequence of the
+ * column values or a dict keyed by column names
+ */
+static int plc_insert_row(plcMsgSQL *msg, plcPyPlan *plan, PyObject *names, PyObject *pyrow) {
+    rawdata *row;
+    int      isdict = PyDict_Check(pyrow);
+    int      j;
+
+    if (!isdict && (!PySequence_Check(pyrow) || PyString_Check(pyrow))) {
+        PyErr_SetString(PyExc_TypeError, "plpy.insert() takes rows as sequences or dicts");
+        return -1;
+    }
+    if (!isdict && PySequence_Length(pyrow) != plan->nargs) {
+        PyErr_Format(PyExc_TypeError, "plpy.insert() expects rows of %d values, but %d were given",
+                     plan->nargs, (int)PySequence_Length(pyrow));
+        return -1;
+    }
+
+    row = malloc((plan->nargs + 1) * sizeof(rawdata));
+    for (j = 0; j < plan->nargs; j++) {
+        row[j].isnull = 1;
+        row[j].value = NULL;
+    }
+    msg->rows[msg->nrows] = row;
+    msg->nrows += 1;
+
+    for (j = 0; j < plan->nargs; j++) {
+        PyObject *value;
+        int       ret;
+
+        if (isdict) {
+            value = PyObject_GetItem(pyrow, PyTuple_GET_ITEM(names, j));
+        } else {
+            value = PySequence_GetItem(pyrow, j);
+        }
+        if (value == NULL) {
+            return -1;
+        }
+        ret = plc_plan_value(plan, j, value, &row[j]);
+        Py_DECREF(value);
+        if (ret != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Sends the batch of rows and adds the number of inserted rows to the total */
+static int plc_insert_send(plcMsgSQL *msg, long long *processed) {
+    plcMsgResult *resp;
+
+    send_to_backend((plcMessage*)msg);
+
+    resp = receive_from_backend();
+    if (resp == NULL) {
+        raise_execution_error("Error receiving data from backend");
+        return -1;
+    }
+    if (resp->cols != 0) {
+        raise_execution_error("Backend returned malformed answer to the insert request");
+        free_result(resp, false);
+        return -1;
+    }
+    *processed += resp->rows;
+    free_result(resp, false);
+
+    return 0;
+}
+
+/*
+ * Message for a single item of the batch: query string or (plan, args)
+ * pair, or arguments of the plan if the batch executes a single plan
+ */
+static plcMsgSQL *plc_batch_item_sql(PyObject *pyitem, plcPyPlan *plan, long limit) {
+    plcMsgSQL *msg;
+
+    if (plan != NULL) {
+        msg = plc_plan_sql(plan, pyitem, SQL_TYPE_PEXECUTE);
+    } else if (PyString_Check(pyitem)) {
+        msg = plc_new_sql(SQL_TYPE_STATEMENT);
+        msg->statement = PyString_AsString(pyitem);
+    } else if (PyTuple_Check(pyitem) && PyTuple_Size(pyitem) == 2
+               && Py_TYPE(PyTuple_GET_ITEM(pyitem, 0)) == &plc_plan_type) {
+        msg = plc_plan_sql((plcPyPlan*)PyTuple_GET_ITEM(pyitem, 0),
+                           PyTuple_GET_ITEM(pyitem, 1), SQL_TYPE_PEXECUTE);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "plpy.execute_many() takes query strings or (plan, args) pairs");
+        return NULL;
+    }
+
+    if (msg != NULL) {
+        msg->limit = (int)limit;
+    }
+    return msg;
+}
+
+static PyObject *plc_cursor_fetch_rows(plcPyCursor *cursor, int count) {
+    plcMsgSQL *msg;
+
+    if (cursor->closed) {
+        PyErr_SetString(PyExc_ValueError, "fetch from a closed cursor");
+        return NULL;
+    }
+    if (plc_is_execution_terminated != 0) {
+        return NULL;
+    }
+
+    msg = plc_new_sql(SQL_TYPE_FETCH);
+    msg->cursorid = cursor->cursorid;
+    msg->limit = count;
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
+
+    return plpy_result_from_backend();
+}
+
+static PyObject *plc_cursor_fetch(PyObject *self, PyObject *args) {
+    int count;
+
+    if (!PyArg_ParseTuple(args, "i", &count)) {
+        return NULL;
+    }
+    if (count <= 0) {
+        PyErr_SetString(PyExc_ValueError, "number of rows to fetch must be positive");
+        return NULL;
+    }
+    return plc_cursor_fetch_rows((plcPyCursor*)self, count);
+}
+
+static void plc_cursor_release(plcPyCursor *cursor) {
+    /* Cursor is closed in the backend unless the connection is not usable */
+    if (!cursor->closed && plcconn_global != NULL && plc_sending_data == 0
+            && plc_is_execution_terminated == 0) {
+        plcMsgSQL *msg = plc_new_sql(SQL_TYPE_CURSOR_CLOSE);
+        msg->cursorid = cursor->cursorid;
+        send_to_backend((plcMessage*)msg);
+        free_sql(msg, true, true);
+    }
+    cursor->closed = 1;
+    Py_CLEAR(cursor->batch);
+}
+
+static PyObject *plc_cursor_close(PyObject *self, PyObject *args UNUSED) {
+    plc_cursor_release((plcPyCursor*)self);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *plc_cursor_iternext(PyObject *self) {
+    plcPyCursor *cursor = (plcPyCursor*)self;
+
+    if (cursor->batch == NULL || cursor->pos >= PySequence_Length(cursor->batch)) {
+        Py_CLEAR(cursor->batch);
+        if (cursor->exhausted || cursor->closed) {
+            return NULL;
+        }
+
+        cursor->batch = plc_cursor_fetch_rows(cursor, cursor->batchsize);
+        cursor->pos = 0;
+        if (cursor->batch == NULL) {
+            return NULL;
+        }
+        if (PySequence_Length(cursor->batch) < cursor->batchsize) {
+            cursor->exhausted = 1;
+        }
+        if (PySequence_Length(cursor->batch) == 0) {
+            Py_CLEAR(cursor->batch);
+            return NULL;
+        }
+    }
+
+    return PySequence_GetItem(cursor->batch, cursor->pos++);
+}
+
+static void plc_cursor_dealloc(PyObject *self) {
+    plc_cursor_release((plcPyCursor*)self);
+    PyObject_Del(self);
+}
+
+static PyMethodDef plc_cursor_methods[] = {
+    {"fetch", plc_cursor_fetch, METH_VARARGS, NULL},
+    {"close", plc_cursor_close, METH_NOARGS,  NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static int plc_cursor_type_ready(void) {
+    if (plc_cursor_type.tp_flags & Py_TPFLAGS_READY) {
+        return 0;
+    }
+
+    /* Static type object lives forever, so it starts with a reference */
+#if PY_MAJOR_VERSION < 3
+    plc_cursor_type.ob_refcnt = 1;
+#else
+    plc_cursor_type.ob_base.ob_base.ob_refcnt = 1;
+#endif
+    plc_cursor_type.tp_name = "plpy.PLyCursor";
+    plc_cursor_type.tp_basicsize = sizeof(plcPyCursor);
+    plc_cursor_type.tp_dealloc = plc_cursor_dealloc;
+    plc_cursor_type.tp_iter = PyObject_SelfIter;
+    plc_cursor_type.tp_iternext = plc_cursor_iternext;
+    plc_cursor_type.tp_methods = plc_cursor_methods;
+    plc_cursor_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    return PyType_Ready(&plc_cursor_type);
+}
+
+static PyObject *plc_subxact_enter(PyObject *self, PyObject *args UNUSED) {
+    plcPySubxact *subxact = (plcPySubxact*)self;
+    plcMsgSQL    *msg;
+
+    if (subxact->entered) {
+        PyErr_SetString(PyExc_ValueError, "this subtransaction has already been entered");
+        return NULL;
+    }
+    if (plc_is_execution_terminated != 0) {
+        return NULL;
+    }
+
+    msg = plc_new_sql(SQL_TYPE_SUBXACT_BEGIN);
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
+    subxact->entered = 1;
+
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject *plc_subxact_exit(PyObject *self, PyObject *args) {
+    plcPySubxact *subxact = (plcPySubxact*)self;
+    plcMsgSQL    *msg;
+    PyObject     *type;
+    PyObject     *value;
+    PyObject     *traceback;
+
+    if (!PyArg_ParseTuple(args, "OOO", &type, &value, &traceback)) {
+        return NULL;
+    }
+    if (!subxact->entered) {
+        PyErr_SetString(PyExc_ValueError, "this subtransaction has not been entered");
+        return NULL;
+    }
+    if (subxact->exited) {
+        PyErr_SetString(PyExc_ValueError, "this subtransaction has already been exited");
+        return NULL;
+    }
+    if (plc_is_execution_terminated != 0) {
+        return NULL;
+    }
+
+    msg = plc_new_sql(type != Py_None ? SQL_TYPE_SUBXACT_ROLLBACK : SQL_TYPE_SUBXACT_COMMIT);
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
+    subxact->exited = 1;
+
+    /* The exception raised inside of the block is propagated */
+    return PyBool_FromLong(0);
+}
+
+static PyMethodDef plc_subxact_methods[] = {
+    {"__enter__", plc_subxact_enter, METH_NOARGS,  NULL},
+    {"__exit__",  plc_subxact_exit,  METH_VARARGS, NULL},
+    {"enter",     plc_subxact_enter, METH_NOARGS,  NULL},
+    {"exit",      plc_subxact_exit,  METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static int plc_subxact_type_ready(void) {
+    if (plc_subxact_type.tp_flags & Py_TPFLAGS_READY) {
+        return 0;
+    }
+
+    /* Static type object lives forever, so it starts with a reference */
+#if PY_MAJOR_VERSION < 3
+    plc_subxact_type.ob_refcnt = 1;
+#else
+    plc_subxact_type.ob_base.ob_base.ob_refcnt = 1;
+#endif
+    plc_subxact_type.tp_name = "plpy.PLySubtransaction";
+    plc_subxact_type.tp_basicsize = sizeof(plcPySubxact);
+    plc_subxact_type.tp_dealloc = (destructor)PyObject_Del;
+    plc_subxact_type.tp_methods = plc_subxact_methods;
+    plc_subxact_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    return PyType_Ready(&plc_subxact_type);
+}
+
+/* Receives the result of the future, the exception is kept for result() */
+static void plc_future_complete(plcPyFuture *future) {
+    plcMsgResult *resp;
+
+    resp = receive_from_backend();
+    if (resp == NULL) {
+        raise_execution_error("Error receiving data from backend");
+    } else {
+        future->result = plpy_result_new(resp);
+    }
+    if (future->result == NULL) {
+        /* Errors reported to the backend leave no Python exception behind */
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_RuntimeError, "result of plpy.execute_async() was not received");
+        }
+        PyErr_Fetch(&future->errtype, &future->errvalue, &future->errtraceback);
+    }
+    future->done = 1;
+}
+
+/*
+ * Receives the result of the statement in flight, if any. Called before any
+ * message is sent to the backend, including the result of the function
+ */
+void plc_future_complete_pending(void) {
+    plcPyFuture *future = plcFuturePending;
+
+    if (future != NULL && plc_sending_data == 0) {
+        plcFuturePending = NULL;
+        plc_future_complete(future);
+        Py_DECREF(future);
+    }
+}
+
+static PyObject *plc_future_result(PyObject *self, PyObject *args UNUSED) {
+    plcPyFuture *future = (plcPyFuture*)self;
+
+    if (!future->done) {
+        plc_future_complete_pending();
+    }
+    if (!future->done) {
+        PyErr_SetString(PyExc_RuntimeError, "result of plpy.execute_async() cannot be received now");
+        return NULL;
+    }
+    if (future->result == NULL) {
+        Py_XINCREF(future->errtype);
+        Py_XINCREF(future->errvalue);
+        Py_XINCREF(future->errtraceback);
+        PyErr_Restore(future->errtype, future->errvalue, future->errtraceback);
+        return NULL;
+    }
+
+    Py_INCREF(future->result);
+    return future->result;
+}
+
+static PyObject *plc_future_done(PyObject *self, PyObject *args UNUSED) {
+    return PyBool_FromLong(((plcPyFuture*)self)->done);
+}
+
+static void plc_future_dealloc(PyObject *self) {
+    plcPyFuture *future = (plcPyFuture*)self;
+
+    Py_XDECREF(future->result);
+    Py_XDECREF(future->errtype);
+    Py_XDECREF(future->errvalue);
+    Py_XDECREF(future->errtraceback);
+    PyObject_Del(self);
+}
+
+static PyMethodDef plc_future_methods[] = {
+    {"result", plc_future_result, METH_NOARGS, NULL},
+    {"done", plc_future_done, METH_NOARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static int plc_future_type_ready(void) {
+    if (plc_future_type.tp_flags & Py_TPFLAGS_READY) {
+        return 0;
+    }
+
+    /* Static type object lives forever, so it starts with a reference */
+#if PY_MAJOR_VERSION < 3
+    plc_future_type.ob_refcnt = 1;
+#else
+    plc_future_type.ob_base.ob_base.ob_refcnt = 1;
+#endif
+    plc_future_type.tp_name = "plpy.PLyFuture";
+    plc_future_type.tp_basicsize = sizeof(plcPyFuture);
+    plc_future_type.tp_dealloc = plc_future_dealloc;
+    plc_future_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    plc_future_type.tp_methods = plc_future_methods;
+    return PyType_Ready(&plc_future_type);
+}
+
+/* Batch size is taken from the container setting */
+static int plc_cursor_batch_size(void) {
+    const char *value = getenv("PLC_CURSOR_BATCH_SIZE");
+    int         size = (value != NULL) ? atoi(value) : 0;
+
+    return (size > 0) ? size : PLC_CURSOR_BATCH_SIZE_DEFAULT;
+}
+
+/*
+ * Message for the query or the prepared plan with its arguments, as taken
+ * by plpy.execute() and plpy.execute_async()
+ */
+static plcMsgSQL *plc_execute_sql(PyObject *args, const char *fname) {
+    plcMsgSQL *msg;
+    PyObject  *pyquery;
+    PyObject  *pyargs = NULL;
+    long       limit = 0;
+
+    if (!PyArg_ParseTuple(args, "O|Ol", &pyquery, &pyargs, &limit)) {
         return NULL;
     }
 
@@ -63,70 +766,469 @@ PyObject *plpy_execute(PyObject *self UNUSED, PyObject *pyquery) {
         return NULL;
     }
 
-    msg            = malloc(sizeof(plcMsgSQL));
-    msg->msgtype   = MT_SQL;
-    msg->sqltype   = SQL_TYPE_STATEMENT;
+    if (plc_plan_type_ready() < 0) {
+        return NULL;
+    }
+    if (Py_TYPE(pyquery) == &plc_plan_type) {
+        msg = plc_plan_sql((plcPyPlan*)pyquery, pyargs, SQL_TYPE_PEXECUTE);
+        if (msg != NULL) {
+            msg->limit = (int)limit;
+        }
+        return msg;
+    }
+
+    if (!PyString_Check(pyquery)) {
+        raise_execution_error("plpy module '%s()' expected string object as input query", fname);
+        return NULL;
+    }
+
+    /* For the query the second argument is the maximum number of rows */
+    if (pyargs != NULL) {
+        if (PyTuple_Size(args) > 2) {
+            PyErr_Format(PyExc_TypeError, "plpy.%s() takes at most 2 arguments for a query", fname);
+            return NULL;
+        }
+        limit = PyInt_AsLong(pyargs);
+        if (limit == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+
+    msg            = plc_new_sql(SQL_TYPE_STATEMENT);
     msg->statement = PyString_AsString(pyquery);
+    msg->limit     = (int)limit;
+    return msg;
+}
 
-    plcontainer_channel_send(conn, (plcMessage*)msg);
+/* plpy methods */
+PyObject *plpy_execute(PyObject *self UNUSED, PyObject *args) {
+    plcMsgSQL *msg;
+
+    msg = plc_execute_sql(args, "execute");
+    if (msg == NULL) {
+        return NULL;
+    }
+
+    send_to_backend((plcMessage*)msg);
 
     /* we don't need it anymore */
-    free(msg);
+    free_sql(msg, true, true);
 
-    resp = receive_from_backend();
+    return plpy_result_from_backend();
+}
+
+/*
+ * Sends the statement and returns the future at once, so that Python
+ * continues while the backend runs it. The result is received by result()
+ * or by the next request that needs an answer from the backend
+ */
+PyObject *plpy_execute_async(PyObject *self UNUSED, PyObject *args) {
+    plcMsgSQL   *msg;
+    plcPyFuture *future;
+
+    if (plc_future_type_ready() < 0) {
+        return NULL;
+    }
+
+    msg = plc_execute_sql(args, "execute_async");
+    if (msg == NULL) {
+        return NULL;
+    }
+
+    future = PyObject_New(plcPyFuture, &plc_future_type);
+    if (future == NULL) {
+        free_sql(msg, true, true);
+        return NULL;
+    }
+    future->done = 0;
+    future->result = NULL;
+    future->errtype = NULL;
+    future->errvalue = NULL;
+    future->errtraceback = NULL;
+
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
+
+    Py_INCREF(future);
+    plcFuturePending = future;
+
+    return (PyObject*)future;
+}
+
+PyObject *plpy_prepare(PyObject *self UNUSED, PyObject *args) {
+    plcMsgSQL    *msg;
+    plcMsgResult *resp;
+    PyObject     *plan;
+    PyObject     *pyquery;
+    PyObject     *pyargtypes = NULL;
+    PyObject     *seq = NULL;
+    int           planid;
+    int           i;
+
+    if (!PyArg_ParseTuple(args, "O|O", &pyquery, &pyargtypes)) {
+        return NULL;
+    }
+    if (!PyString_Check(pyquery)) {
+        PyErr_SetString(PyExc_TypeError, "plpy.prepare() expected string object as input query");
+        return NULL;
+    }
+    if (pyargtypes != NULL && pyargtypes != Py_None) {
+        seq = PySequence_Fast(pyargtypes, "plpy.prepare() takes a sequence of type names as its second argument");
+        if (seq == NULL) {
+            return NULL;
+        }
+    }
+
+    /* If the execution was terminated we don't need to proceed with SPI */
+    if (plc_is_execution_terminated != 0 || plc_plan_type_ready() < 0) {
+        Py_XDECREF(seq);
+        return NULL;
+    }
+
+    msg = plc_new_sql(SQL_TYPE_PREPARE);
+    msg->statement = PyString_AsString(pyquery);
+    msg->nargs = (seq == NULL) ? 0 : PySequence_Fast_GET_SIZE(seq);
+    msg->argtypes = malloc((msg->nargs + 1) * sizeof(char*));
+    for (i = 0; i < msg->nargs; i++) {
+        PyObject *pytype = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyString_Check(pytype)) {
+            PyErr_SetString(PyExc_TypeError, "plpy.prepare() takes a sequence of type names as its second argument");
+            msg->nargs = 0;
+            free_sql(msg, true, true);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        msg->argtypes[i] = PyString_AsString(pytype);
+    }
+
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
+    Py_XDECREF(seq);
+
+    /* The answer contains plan handle followed by the argument types */
+    resp = receive_handle_from_backend(&planid);
     if (resp == NULL) {
-        raise_execution_error("Error receiving data from backend");
         return NULL;
     }
 
-    result = plc_init_result_conversions(resp);
+    plan = plc_plan_new(resp, planid);
+    free_result(resp, false);
 
-    /* convert the result set into list of dictionaries */
-    pyresult = PyList_New(result->res->rows);
-    if (pyresult == NULL) {
-        raise_execution_error("Cannot allocate new list object in Python");
-        free_result(resp, false);
-        plc_free_result_conversions(result);
+    return plan;
+}
+
+PyObject *plpy_cursor(PyObject *self UNUSED, PyObject *args) {
+    plcMsgSQL    *msg;
+    plcMsgResult *resp;
+    plcPyCursor  *cursor;
+    PyObject     *pyquery;
+    PyObject     *pyargs = NULL;
+    int           cursorid;
+
+    if (!PyArg_ParseTuple(args, "O|O", &pyquery, &pyargs)) {
         return NULL;
     }
 
-    for (j = 0; j < result->res->cols; j++) {
-        if (result->args[j].conv.inputfunc == NULL) {
-            raise_execution_error("Type %d is not yet supported by Python container",
-                                  (int)result->args[j].type);
-            free_result(resp, false);
-            plc_free_result_conversions(result);
+    /* If the execution was terminated we don't need to proceed with SPI */
+    if (plc_is_execution_terminated != 0) {
+        return NULL;
+    }
+
+    if (plc_plan_type_ready() < 0 || plc_cursor_type_ready() < 0) {
+        return NULL;
+    }
+    if (Py_TYPE(pyquery) == &plc_plan_type) {
+        msg = plc_plan_sql((plcPyPlan*)pyquery, pyargs, SQL_TYPE_CURSOR_OPEN);
+        if (msg == NULL) {
+            return NULL;
+        }
+    } else if (PyString_Check(pyquery)) {
+        if (pyargs != NULL) {
+            PyErr_SetString(PyExc_TypeError, "plpy.cursor() takes arguments only with a prepared plan");
             return NULL;
         }
+        msg = plc_new_sql(SQL_TYPE_CURSOR_OPEN);
+        msg->statement = PyString_AsString(pyquery);
+    } else {
+        PyErr_SetString(PyExc_TypeError, "plpy.cursor() expected a query or a prepared plan");
+        return NULL;
     }
 
-    for (i = 0; i < result->res->rows; i++) {
-        pydict = PyDict_New();
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
 
-        for (j = 0; j < result->res->cols; j++) {
-            pyval = result->args[j].conv.inputfunc(result->res->data[i][j].value,
-                                                   &result->args[j]);
+    resp = receive_handle_from_backend(&cursorid);
+    if (resp == NULL) {
+        return NULL;
+    }
+    free_result(resp, false);
 
-            if (PyDict_SetItemString(pydict, result->res->names[j], pyval) != 0) {
-                raise_execution_error("Error setting result dictionary element",
-                                      (int)result->res->types[j].type);
-                free_result(resp, false);
-                plc_free_result_conversions(result);
+    cursor = PyObject_New(plcPyCursor, &plc_cursor_type);
+    if (cursor == NULL) {
+        return NULL;
+    }
+    cursor->cursorid = cursorid;
+    cursor->batchsize = plc_cursor_batch_size();
+    cursor->closed = 0;
+    cursor->exhausted = 0;
+    cursor->batch = NULL;
+    cursor->pos = 0;
+
+    return (PyObject*)cursor;
+}
+
+PyObject *plpy_subtransaction(PyObject *self UNUSED, PyObject *args UNUSED) {
+    plcPySubxact *subxact;
+
+    if (plc_subxact_type_ready() < 0) {
+        return NULL;
+    }
+
+    subxact = PyObject_New(plcPySubxact, &plc_subxact_type);
+    if (subxact == NULL) {
+        return NULL;
+    }
+    subxact->entered = 0;
+    subxact->exited = 0;
+
+    return (PyObject*)subxact;
+}
+
+/*
+ * Inserts the rows into the relation, sending them to the backend in
+ * batches. The rows can be given by any iterable, so that the whole data set
+ * does not have to be kept in memory. Returns the number of inserted rows
+ */
+PyObject *plpy_insert(PyObject *self UNUSED, PyObject *args) {
+    plcMsgSQL    *msg;
+    plcMsgResult *resp;
+    PyObject     *pyrelation;
+    PyObject     *pyrows;
+    PyObject     *pycolumns = NULL;
+    PyObject     *seq = NULL;
+    PyObject     *plan;
+    PyObject     *names;
+    PyObject     *iter;
+    PyObject     *pyrow;
+    long long     processed = 0;
+    int           batchsize = PLC_INSERT_BATCH_SIZE_DEFAULT;
+    int           planid;
+    int           ret = 0;
+    int           i;
+
+    if (!PyArg_ParseTuple(args, "OO|Oi", &pyrelation, &pyrows, &pycolumns, &batchsize)) {
+        return NULL;
+    }
+    if (!PyString_Check(pyrelation)) {
+        PyErr_SetString(PyExc_TypeError, "plpy.insert() expected relation name as its first argument");
+        return NULL;
+    }
+    if (batchsize <= 0) {
+        PyErr_SetString(PyExc_ValueError, "plpy.insert() batch size must be positive");
+        return NULL;
+    }
+    if (pycolumns != NULL && pycolumns != Py_None) {
+        seq = PySequence_Fast(pycolumns, "plpy.insert() takes a sequence of column names as its third argument");
+        if (seq == NULL) {
+            return NULL;
+        }
+    }
+
+    /* If the execution was terminated we don't need to proceed with SPI */
+    if (plc_is_execution_terminated != 0 || plc_plan_type_ready() < 0) {
+        Py_XDECREF(seq);
+        return NULL;
+    }
+
+    msg = plc_new_sql(SQL_TYPE_PREPARE_INSERT);
+    msg->statement = PyString_AsString(pyrelation);
+    msg->nargs = (seq == NULL) ? 0 : PySequence_Fast_GET_SIZE(seq);
+    msg->argtypes = malloc((msg->nargs + 1) * sizeof(char*));
+    for (i = 0; i < msg->nargs; i++) {
+        PyObject *pycolumn = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyString_Check(pycolumn)) {
+            PyErr_SetString(PyExc_TypeError, "plpy.insert() takes a sequence of column names as its third argument");
+            msg->nargs = 0;
+            free_sql(msg, true, true);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        msg->argtypes[i] = PyString_AsString(pycolumn);
+    }
+
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
+    Py_XDECREF(seq);
+
+    /* Insert is prepared as a plan with the column names as argument names */
+    resp = receive_handle_from_backend(&planid);
+    if (resp == NULL) {
+        return NULL;
+    }
+    plan = plc_plan_new(resp, planid);
+    names = PyTuple_New(resp->cols - 1);
+    for (i = 1; plan != NULL && names != NULL && i < resp->cols; i++) {
+        PyTuple_SET_ITEM(names, i - 1, PyString_FromString(resp->names[i]));
+    }
+    free_result(resp, false);
+    if (plan == NULL || names == NULL) {
+        Py_XDECREF(plan);
+        Py_XDECREF(names);
+        return NULL;
+    }
+
+    iter = PyObject_GetIter(pyrows);
+    if (iter == NULL) {
+        Py_DECREF(plan);
+        Py_DECREF(names);
+        return NULL;
+    }
+
+    msg = NULL;
+    while (ret == 0 && (pyrow = PyIter_Next(iter)) != NULL) {
+        if (msg == NULL) {
+            int j;
+
+            msg = plc_new_sql(SQL_TYPE_INSERT);
+            msg->planid = planid;
+            msg->nargs = ((plcPyPlan*)plan)->nargs;
+            msg->types = malloc((msg->nargs + 1) * sizeof(plcType));
+            for (j = 0; j < msg->nargs; j++) {
+                plc_py_copy_type(&msg->types[j], &((plcPyPlan*)plan)->args[j]);
+            }
+            msg->rows = malloc(batchsize * sizeof(rawdata*));
+        }
+
+        ret = plc_insert_row(msg, (plcPyPlan*)plan, names, pyrow);
+        Py_DECREF(pyrow);
+
+        if (ret == 0 && msg->nrows == batchsize) {
+            ret = plc_insert_send(msg, &processed);
+            free_sql(msg, true, true);
+            msg = NULL;
+        }
+    }
+    if (ret == 0 && PyErr_Occurred()) {
+        ret = -1;
+    }
+    if (ret == 0 && msg != NULL) {
+        ret = plc_insert_send(msg, &processed);
+    }
+    if (msg != NULL) {
+        free_sql(msg, true, true);
+    }
+
+    Py_DECREF(iter);
+    Py_DECREF(names);
+    Py_DECREF(plan);
+
+    if (ret != 0) {
+        return NULL;
+    }
+    return PyInt_FromLong((long)processed);
+}
+
+/*
+ * Executes the batch of statements, or of argument sets for a single plan,
+ * with one message to the backend. The backend sends all the results without
+ * waiting, so the batch costs a single round trip. Returns a list of results
+ */
+PyObject *plpy_execute_many(PyObject *self UNUSED, PyObject *args) {
+    plcMsgSQL  *msg;
+    plcPyPlan  *plan = NULL;
+    PyObject   *pyfirst;
+    PyObject   *pyitems = NULL;
+    PyObject   *seq;
+    PyObject   *pyresults;
+    long        limit = 0;
+    int         i;
+
+    if (!PyArg_ParseTuple(args, "O|Ol", &pyfirst, &pyitems, &limit)) {
+        return NULL;
+    }
+
+    /* If the execution was terminated we don't need to proceed with SPI */
+    if (plc_is_execution_terminated != 0 || plc_plan_type_ready() < 0) {
+        return NULL;
+    }
+
+    /* Either a plan with the sequence of argument sets, or a sequence of queries */
+    if (Py_TYPE(pyfirst) == &plc_plan_type) {
+        if (pyitems == NULL) {
+            PyErr_SetString(PyExc_TypeError, "plpy.execute_many() takes a sequence of arguments for the plan");
+            return NULL;
+        }
+        plan = (plcPyPlan*)pyfirst;
+    } else {
+        if (PyTuple_Size(args) > 2) {
+            PyErr_SetString(PyExc_TypeError, "plpy.execute_many() takes at most 2 arguments for queries");
+            return NULL;
+        }
+        if (pyitems != NULL) {
+            limit = PyInt_AsLong(pyitems);
+            if (limit == -1 && PyErr_Occurred()) {
                 return NULL;
             }
         }
+        pyitems = pyfirst;
+    }
+    if (PyString_Check(pyitems)) {
+        PyErr_SetString(PyExc_TypeError, "plpy.execute_many() takes a sequence of statements");
+        return NULL;
+    }
+    seq = PySequence_Fast(pyitems, "plpy.execute_many() takes a sequence of statements");
+    if (seq == NULL) {
+        return NULL;
+    }
 
-        if (PyList_SetItem(pyresult, i, pydict) != 0) {
-            raise_execution_error("Error setting result list element",
-                                  (int)result->res->types[j].type);
-            free_result(resp, false);
-            plc_free_result_conversions(result);
+    msg = plc_new_sql(SQL_TYPE_BATCH);
+    msg->batch = malloc((PySequence_Fast_GET_SIZE(seq) + 1) * sizeof(plcMsgSQL*));
+    for (i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+        msg->batch[i] = plc_batch_item_sql(PySequence_Fast_GET_ITEM(seq, i), plan, limit);
+        if (msg->batch[i] == NULL) {
+            free_sql(msg, true, true);
+            Py_DECREF(seq);
             return NULL;
         }
+        msg->nbatch = i + 1;
     }
 
-    free_result(resp, false);
-    plc_free_result_conversions(result);
+    pyresults = PyList_New(msg->nbatch);
+    if (pyresults == NULL || msg->nbatch == 0) {
+        free_sql(msg, true, true);
+        Py_DECREF(seq);
+        return pyresults;
+    }
+
+    /* statements refer to the strings of the sequence, so it is kept till sending */
+    send_to_backend((plcMessage*)msg);
+    free_sql(msg, true, true);
+    Py_DECREF(seq);
+
+    for (i = 0; i < PyList_Size(pyresults); i++) {
+        plcMsgResult *resp = receive_from_backend();
+        PyObject     *pyresult;
+
+        if (resp == NULL) {
+            raise_execution_error("Error receiving data from backend");
+            Py_DECREF(pyresults);
+            return NULL;
+        }
+        pyresult = plpy_result_new(resp);
+        if (pyresult == NULL) {
+            /* Remaining results are read, so that the next request gets its own answer */
+            for (i = i + 1; i < PyList_Size(pyresults); i++) {
+                resp = receive_from_backend();
+                if (resp == NULL) {
+                    break;
+                }
+                free_result(resp, false);
+            }
+            Py_DECREF(pyresults);
+            return NULL;
+        }
+        PyList_SET_ITEM(pyresults, i, pyresult);
+    }
 
-    return pyresult;
+    return pyresults;
 }
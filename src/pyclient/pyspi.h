@@ -10,6 +10,15 @@
 
 #include <Python.h>
 
-PyObject *plpy_execute(PyObject *self, PyObject *pyquery);
+PyObject *plpy_execute(PyObject *self, PyObject *args);
+PyObject *plpy_prepare(PyObject *self, PyObject *args);
+PyObject *plpy_cursor(PyObject *self, PyObject *args);
+PyObject *plpy_subtransaction(PyObject *self, PyObject *args);
+PyObject *plpy_insert(PyObject *self, PyObject *args);
+PyObject *plpy_execute_many(PyObject *self, PyObject *args);
+PyObject *plpy_execute_async(PyObject *self, PyObject *args);
+
+/* Receives the result of the statement sent by plpy.execute_async() */
+void plc_future_complete_pending(void);
 
 #endif /* PLC_PYSPI_H */
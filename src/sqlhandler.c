@@ -10,31 +10,213 @@
  */
 
 #include "postgres.h"
+#include "access/heapam.h"
+#include "catalog/namespace.h"
 #include "executor/spi.h"
+#include "lib/stringinfo.h"
+#include "parser/parse_relation.h"
+#include "parser/parse_type.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 #include "common/comm_utils.h"
 #include "common/comm_channel.h"
 #include "plc_typeio.h"
+#include "message_fns.h"
 #include "sqlhandler.h"
 
-static plcMsgResult *create_sql_result(void);
+/* Number of distinct result row descriptors with their column types kept */
+#define PLC_RESULT_TYPES_CACHE_SIZE 16
 
-static plcMsgResult *create_sql_result() {
-    plcMsgResult  *result;
-    int            i, j;
-    plcTypeInfo   *resTypes;
+/*
+ * Plan prepared by the client, the handle of the plan is its index plus one.
+ * Plans belong to the connection of the client and are freed with it
+ */
+typedef struct plcPlan {
+    void        *plan;      /* saved SPI plan, NULL for the free slot */
+    plcConn     *conn;      /* connection of the client that prepared the plan */
+    int          nargs;
+    Oid         *argOids;
+    plcTypeInfo *argTypes;
+} plcPlan;
+
+static plcPlan *plcPlans = NULL;
+static int      plcPlansSize = 0;
+
+/*
+ * Names of the portals of the cursors opened by the client, the handle of
+ * the cursor is its index plus one. Portals are closed by the end of the
+ * transaction, so the slot of a portal that does not exist anymore is free
+ */
+static char   **plcCursors = NULL;
+static int      plcCursorsSize = 0;
+
+/*
+ * Resource owners that were current before the explicit subtransactions of
+ * the client started, the last one belongs to the innermost subtransaction
+ */
+static ResourceOwner *plcSubxactOwners = NULL;
+static int            plcSubxactOwnersSize = 0;
+static int            plcSubxactDepth = 0;
+
+/*
+ * Column types of the query results, identified by the type OIDs and typmods
+ * of the row descriptor. Repeated queries reuse the conversion functions and
+ * the types sent to the client instead of looking them up for every result
+ */
+typedef struct plcResultTypes {
+    int          ncols;
+    Oid         *typeOids;
+    int32       *typmods;
+    plcTypeInfo *typeInfos;  /* conversion of the column values */
+    plcType     *types;      /* column types as they are sent to the client */
+    int          version;    /* protocol version of the client */
+} plcResultTypes;
+
+static plcResultTypes *plcResultTypesCache[PLC_RESULT_TYPES_CACHE_SIZE];
+
+static plcResultTypes *create_result_types(TupleDesc desc, int version);
+static plcResultTypes *get_result_types(TupleDesc desc, int version);
+static bool result_types_match(plcResultTypes *entry, TupleDesc desc, int version);
+static void free_result_types(plcResultTypes *entry);
+static plcMsgResult *create_sql_result(int version);
+static plcMsgResult *create_handle_result(const char *name, int handle, int ncols);
+static plcMsgResult *create_count_result(uint32 processed);
+static plcMessage *process_sql_result(int retval, int version);
+static plcMessage *prepare_plan(plcMsgSQL *msg, plcConn *conn);
+static plcMessage *prepare_insert(plcMsgSQL *msg, plcConn *conn);
+static plcMessage *save_plan(plcConn *conn, const char *query, int nargs, Oid *argOids, char **argnames);
+static plcMessage *insert_rows(plcMsgSQL *msg, plcConn *conn);
+static plcMessage *execute_plan(plcMsgSQL *msg, plcConn *conn);
+static void unprepare_plan(plcMsgSQL *msg, plcConn *conn);
+static void free_plan(plcPlan *plan);
+static plcPlan *get_plan(int planid, plcConn *conn);
+static void convert_plan_arguments(plcPlan *plan, plcMsgSQL *msg, Datum **values, char **nulls);
+static plcMessage *open_cursor(plcMsgSQL *msg, plcConn *conn);
+static plcMessage *fetch_cursor(plcMsgSQL *msg, int version);
+static void close_cursor(plcMsgSQL *msg);
+static Portal get_cursor(int cursorid);
+static void begin_subtransaction(void);
+static void end_subtransaction(bool commit);
+static plcMessage *process_sql_message(plcMsgSQL *msg, plcConn *conn);
+
+static bool result_types_match(plcResultTypes *entry, TupleDesc desc, int version) {
+    int i;
+
+    if (entry->ncols != desc->natts || entry->version != version) {
+        return false;
+    }
+    for (i = 0; i < entry->ncols; i++) {
+        if (entry->typeOids[i] != desc->attrs[i]->atttypid
+                || entry->typmods[i] != desc->attrs[i]->atttypmod) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void free_result_types(plcResultTypes *entry) {
+    int i;
+
+    for (i = 0; i < entry->ncols; i++) {
+        free_type_info(&entry->typeInfos[i]);
+        free_type(&entry->types[i]);
+    }
+    pfree(entry->typeOids);
+    pfree(entry->typmods);
+    pfree(entry->typeInfos);
+    pfree(entry->types);
+    pfree(entry);
+}
+
+static plcResultTypes *create_result_types(TupleDesc desc, int version) {
+    plcResultTypes *entry;
+    MemoryContext   oldContext;
+    int             i;
+
+    entry            = plc_top_alloc(sizeof(plcResultTypes));
+    entry->ncols     = desc->natts;
+    entry->typeOids  = plc_top_alloc((entry->ncols + 1) * sizeof(Oid));
+    entry->typmods   = plc_top_alloc((entry->ncols + 1) * sizeof(int32));
+    entry->typeInfos = plc_top_alloc((entry->ncols + 1) * sizeof(plcTypeInfo));
+    entry->types     = plc_top_alloc((entry->ncols + 1) * sizeof(plcType));
+    entry->version   = version;
+
+    oldContext = MemoryContextSwitchTo(TopMemoryContext);
+    for (i = 0; i < entry->ncols; i++) {
+        entry->typeOids[i] = desc->attrs[i]->atttypid;
+        entry->typmods[i] = desc->attrs[i]->atttypmod;
+        fill_type_info(NULL, entry->typeOids[i], &entry->typeInfos[i]);
+        if (version < PLC_PROTOCOL_VERSION_TYPED) {
+            plc_type_info_use_text(&entry->typeInfos[i]);
+        }
+        copy_type_info(&entry->types[i], &entry->typeInfos[i]);
+    }
+    MemoryContextSwitchTo(oldContext);
+
+    return entry;
+}
+
+/*
+ * Column types for the row descriptor of the result, taken from the cache if
+ * the same descriptor was seen before for the client of the same protocol
+ * version. The cache is kept in LRU order
+ */
+static plcResultTypes *get_result_types(TupleDesc desc, int version) {
+    plcResultTypes *entry;
+    int             i, j;
+
+    for (i = 0; i < PLC_RESULT_TYPES_CACHE_SIZE && plcResultTypesCache[i] != NULL; i++) {
+        if (result_types_match(plcResultTypesCache[i], desc, version)) {
+            entry = plcResultTypesCache[i];
+
+            /* Composite column types might have changed since they were cached */
+            for (j = 0; j < entry->ncols; j++) {
+                if (!plc_type_valid(&entry->typeInfos[j])) {
+                    entry = create_result_types(desc, version);
+                    free_result_types(plcResultTypesCache[i]);
+                    plcResultTypesCache[i] = entry;
+                    break;
+                }
+            }
+
+            for (; i > 0; i--) {
+                plcResultTypesCache[i] = plcResultTypesCache[i - 1];
+            }
+            plcResultTypesCache[0] = entry;
+            return entry;
+        }
+    }
+
+    entry = create_result_types(desc, version);
+    if (plcResultTypesCache[PLC_RESULT_TYPES_CACHE_SIZE - 1] != NULL) {
+        free_result_types(plcResultTypesCache[PLC_RESULT_TYPES_CACHE_SIZE - 1]);
+    }
+    for (i = PLC_RESULT_TYPES_CACHE_SIZE - 1; i > 0; i--) {
+        plcResultTypesCache[i] = plcResultTypesCache[i - 1];
+    }
+    plcResultTypesCache[0] = entry;
+
+    return entry;
+}
+
+static plcMsgResult *create_sql_result(int version) {
+    plcMsgResult   *result;
+    int             i, j;
+    plcResultTypes *resTypes;
+
+    resTypes = get_result_types(SPI_tuptable->tupdesc, version);
 
     result          = palloc(sizeof(plcMsgResult));
     result->msgtype = MT_RESULT;
     result->cols    = SPI_tuptable->tupdesc->natts;
     result->rows    = SPI_processed;
-    result->types   = palloc(result->cols * sizeof(*result->types));
+    result->types   = resTypes->types;
     result->names   = palloc(result->cols * sizeof(*result->names));
     result->exception_callback = NULL;
-    resTypes        = palloc(result->cols * sizeof(plcTypeInfo));
+    result->sharedTypes = 1;
     for (j = 0; j < result->cols; j++) {
-        fill_type_info(NULL, SPI_tuptable->tupdesc->attrs[j]->atttypid, &resTypes[j]);
-        copy_type_info(&result->types[j], &resTypes[j]);
         result->names[j] = SPI_fname(SPI_tuptable->tupdesc, j + 1);
     }
 
@@ -57,42 +239,612 @@ static plcMsgResult *create_sql_result() {
                     result->data[i][j].value = NULL;
                 } else {
                     result->data[i][j].isnull = 0;
-                    result->data[i][j].value = resTypes[j].outfunc(origval, &resTypes[j]);
+                    result->data[i][j].value = resTypes->typeInfos[j].outfunc(origval, &resTypes->typeInfos[j]);
                 }
             }
         }
     }
 
-    for (i = 0; i < result->cols; i++) {
-        free_type_info(&resTypes[i]);
+    return result;
+}
+
+static plcMessage *process_sql_result(int retval, int version) {
+    plcMessage *result = NULL;
+
+    if (retval < 0) {
+        lprintf(ERROR, "SPI execution failed: %s", SPI_result_code_string(retval));
+    }
+
+    switch (retval) {
+        case SPI_OK_SELECT:
+        case SPI_OK_INSERT_RETURNING:
+        case SPI_OK_DELETE_RETURNING:
+        case SPI_OK_UPDATE_RETURNING:
+            /* some data was returned back */
+            result = (plcMessage*)create_sql_result(version);
+            break;
+        default:
+            /* Utility statements like SHOW or EXPLAIN might return rows as well */
+            if (SPI_tuptable != NULL) {
+                result = (plcMessage*)create_sql_result(version);
+            } else {
+                result = (plcMessage*)create_count_result(SPI_processed);
+            }
+            break;
     }
-    pfree(resTypes);
 
+    SPI_freetuptable(SPI_tuptable);
     return result;
 }
 
-plcMessage *handle_sql_message(plcMsgSQL *msg) {
-    int retval;
+/* Result of statement that returns no rows, only the number of processed rows */
+static plcMsgResult *create_count_result(uint32 processed) {
+    plcMsgResult *result;
+
+    result          = palloc(sizeof(plcMsgResult));
+    result->msgtype = MT_RESULT;
+    result->cols    = 0;
+    result->rows    = (int)processed;
+    result->types   = palloc(sizeof(*result->types));
+    result->names   = palloc(sizeof(*result->names));
+    result->data    = NULL;
+    result->exception_callback = NULL;
+    result->sharedTypes = 0;
+
+    return result;
+}
+
+/*
+ * Result of a single row with the handle in the first column, the rest of
+ * the columns are left to the caller
+ */
+static plcMsgResult *create_handle_result(const char *name, int handle, int ncols) {
+    plcMsgResult *result;
+
+    result          = palloc(sizeof(plcMsgResult));
+    result->msgtype = MT_RESULT;
+    result->cols    = ncols + 1;
+    result->rows    = 1;
+    result->types   = palloc(result->cols * sizeof(*result->types));
+    result->names   = palloc(result->cols * sizeof(*result->names));
+    result->data    = palloc(sizeof(*result->data));
+    result->data[0] = palloc(result->cols * sizeof(*result->data[0]));
+    result->exception_callback = NULL;
+    result->sharedTypes = 0;
+
+    result->types[0].type = PLC_DATA_INT4;
+    result->types[0].nSubTypes = 0;
+    result->types[0].typeName = NULL;
+    result->types[0].pgTypeName = NULL;
+    result->types[0].subTypes = NULL;
+    result->names[0] = pstrdup(name);
+    result->data[0][0].isnull = 0;
+    result->data[0][0].value = palloc(sizeof(int32));
+    *((int32*)result->data[0][0].value) = (int32)handle;
+
+    return result;
+}
+
+static plcPlan *get_plan(int planid, plcConn *conn) {
+    if (planid < 1 || planid > plcPlansSize || plcPlans[planid - 1].plan == NULL
+            || plcPlans[planid - 1].conn != conn) {
+        lprintf(ERROR, "prepared plan %d does not exist", planid);
+    }
+    return &plcPlans[planid - 1];
+}
+
+/*
+ * Prepares the plan and answers with its handle and the types of its
+ * arguments. The plan is kept till the client releases it
+ */
+static plcMessage *prepare_plan(plcMsgSQL *msg, plcConn *conn) {
+    plcMessage *result;
+    Oid        *argOids;
+    int         i;
+
+    argOids = (Oid*)palloc((msg->nargs + 1) * sizeof(Oid));
+    for (i = 0; i < msg->nargs; i++) {
+        int32 typmod;
+
+        if (msg->argtypes[i] == NULL) {
+            lprintf(ERROR, "type of the plan argument %d is not specified", i + 1);
+        }
+        parseTypeString(msg->argtypes[i], &argOids[i], &typmod);
+    }
+
+    result = save_plan(conn, msg->statement, msg->nargs, argOids, msg->argtypes);
+    pfree(argOids);
+
+    return result;
+}
+
+/*
+ * Prepares the insert into the given columns of the relation, the types of
+ * plan arguments are the types of the columns
+ */
+static plcMessage *prepare_insert(plcMsgSQL *msg, plcConn *conn) {
+    plcMessage     *result;
+    text           *relname;
+    Relation        rel;
+    TupleDesc       desc;
+    StringInfoData  query;
+    Oid            *argOids;
+    char          **argnames;
+    int             nargs = 0;
+    int             i;
+
+    relname = DatumGetTextP(DirectFunctionCall1(textin, CStringGetDatum(msg->statement)));
+    rel = heap_openrv(makeRangeVarFromNameList(textToQualifiedNameList(relname)), AccessShareLock);
+    desc = RelationGetDescr(rel);
+
+    argOids = (Oid*)palloc((desc->natts + msg->nargs + 1) * sizeof(Oid));
+    argnames = (char**)palloc((desc->natts + msg->nargs + 1) * sizeof(char*));
+    if (msg->nargs == 0) {
+        for (i = 0; i < desc->natts; i++) {
+            if (!desc->attrs[i]->attisdropped) {
+                argOids[nargs] = desc->attrs[i]->atttypid;
+                argnames[nargs] = NameStr(desc->attrs[i]->attname);
+                nargs += 1;
+            }
+        }
+    } else {
+        for (i = 0; i < msg->nargs; i++) {
+            int attnum;
+
+            if (msg->argtypes[i] == NULL) {
+                lprintf(ERROR, "name of the column %d is not specified", i + 1);
+            }
+            attnum = attnameAttNum(rel, msg->argtypes[i], false);
+            if (attnum == InvalidAttrNumber) {
+                lprintf(ERROR, "column \"%s\" of relation \"%s\" does not exist",
+                        msg->argtypes[i], RelationGetRelationName(rel));
+            }
+            argOids[nargs] = desc->attrs[attnum - 1]->atttypid;
+            argnames[nargs] = msg->argtypes[i];
+            nargs += 1;
+        }
+    }
+
+    initStringInfo(&query);
+    appendStringInfo(&query, "INSERT INTO %s (",
+                     quote_qualified_identifier(get_namespace_name(RelationGetNamespace(rel)),
+                                                RelationGetRelationName(rel)));
+    for (i = 0; i < nargs; i++) {
+        appendStringInfo(&query, "%s%s", (i > 0) ? ", " : "", quote_identifier(argnames[i]));
+    }
+    appendStringInfoString(&query, ") VALUES (");
+    for (i = 0; i < nargs; i++) {
+        appendStringInfo(&query, "%s$%d", (i > 0) ? ", " : "", i + 1);
+    }
+    appendStringInfoChar(&query, ')');
+
+    result = save_plan(conn, query.data, nargs, argOids, argnames);
+
+    /* The lock is kept till the end of transaction */
+    heap_close(rel, NoLock);
+    pfree(query.data);
+    pfree(argOids);
+    pfree(argnames);
+
+    return result;
+}
+
+/*
+ * Prepares and saves the plan, answering with its handle and the types of
+ * its arguments. The plan is kept till the client releases it or its
+ * connection is closed
+ */
+static plcMessage *save_plan(plcConn *conn, const char *query, int nargs, Oid *argOids, char **argnames) {
+    plcMsgResult *result;
+    plcPlan      *plan = NULL;
+    void         *tmpplan;
+    void         *savedplan;
+    int           i;
+
+    tmpplan = SPI_prepare(query, nargs, argOids);
+    if (tmpplan == NULL) {
+        lprintf(ERROR, "SPI_prepare failed: %s", SPI_result_code_string(SPI_result));
+    }
+    savedplan = SPI_saveplan(tmpplan);
+    SPI_freeplan(tmpplan);
+    if (savedplan == NULL) {
+        lprintf(ERROR, "SPI_saveplan failed: %s", SPI_result_code_string(SPI_result));
+    }
+
+    /* Find a free slot for the plan, growing the table if there is none */
+    for (i = 0; i < plcPlansSize; i++) {
+        if (plcPlans[i].plan == NULL) {
+            plan = &plcPlans[i];
+            break;
+        }
+    }
+    if (plan == NULL) {
+        int size = (plcPlansSize == 0) ? 16 : plcPlansSize * 2;
+
+        if (plcPlans == NULL) {
+            plcPlans = (plcPlan*)plc_top_alloc(size * sizeof(plcPlan));
+        } else {
+            plcPlans = (plcPlan*)repalloc(plcPlans, size * sizeof(plcPlan));
+        }
+        memset(&plcPlans[plcPlansSize], 0, (size - plcPlansSize) * sizeof(plcPlan));
+        plan = &plcPlans[plcPlansSize];
+        plcPlansSize = size;
+    }
+
+    plan->plan = savedplan;
+    plan->conn = conn;
+    plan->nargs = nargs;
+    plan->argOids = (Oid*)plc_top_alloc((nargs + 1) * sizeof(Oid));
+    memcpy(plan->argOids, argOids, nargs * sizeof(Oid));
+    plan->argTypes = (plcTypeInfo*)plc_top_alloc((nargs + 1) * sizeof(plcTypeInfo));
+
+    result = create_handle_result("plan", (int)(plan - plcPlans) + 1, plan->nargs);
+    for (i = 0; i < plan->nargs; i++) {
+        fill_type_info(NULL, plan->argOids[i], &plan->argTypes[i]);
+        copy_type_info(&result->types[i + 1], &plan->argTypes[i]);
+        result->names[i + 1] = pstrdup(argnames[i]);
+        result->data[0][i + 1].isnull = 1;
+        result->data[0][i + 1].value = NULL;
+    }
+
+    return (plcMessage*)result;
+}
+
+/* Converts the argument values sent by the client to the plan arguments */
+static void convert_plan_arguments(plcPlan *plan, plcMsgSQL *msg, Datum **values, char **nulls) {
+    int i;
+
+    if (msg->nargs != plan->nargs) {
+        lprintf(ERROR, "prepared plan %d expects %d arguments, but %d were given",
+                msg->planid, plan->nargs, msg->nargs);
+    }
+
+    *values = palloc((plan->nargs + 1) * sizeof(Datum));
+    *nulls = palloc((plan->nargs + 1) * sizeof(char));
+    for (i = 0; i < plan->nargs; i++) {
+        if (msg->args[i].type.type != plan->argTypes[i].type) {
+            lprintf(ERROR, "argument %d of prepared plan %d has type %s, but %s was given",
+                    i + 1, msg->planid, plc_get_type_name(plan->argTypes[i].type),
+                    plc_get_type_name(msg->args[i].type.type));
+        }
+        if (msg->args[i].data.isnull) {
+            (*values)[i] = (Datum) 0;
+            (*nulls)[i] = 'n';
+        } else {
+            (*values)[i] = plan->argTypes[i].infunc(msg->args[i].data.value, &plan->argTypes[i]);
+            (*nulls)[i] = ' ';
+        }
+    }
+}
+
+static plcMessage *execute_plan(plcMsgSQL *msg, plcConn *conn) {
+    plcPlan *plan = get_plan(msg->planid, conn);
+    Datum   *values;
+    char    *nulls;
+    int      retval;
+
+    convert_plan_arguments(plan, msg, &values, &nulls);
+    retval = SPI_execute_plan(plan->plan, values, nulls, false, msg->limit);
+    pfree(values);
+    pfree(nulls);
+
+    return process_sql_result(retval, conn->version);
+}
+
+/*
+ * Executes the prepared plan for each of the rows sent by the client. Rows
+ * are converted in the temporary context reset for each row, so that the
+ * memory used by the batch does not depend on its size
+ */
+static plcMessage *insert_rows(plcMsgSQL *msg, plcConn *conn) {
+    plcPlan       *plan = get_plan(msg->planid, conn);
+    MemoryContext  rowcontext;
+    MemoryContext  oldcontext;
+    Datum         *values;
+    char          *nulls;
+    uint32         processed = 0;
+    int            i, j;
+
+    if (msg->nargs != plan->nargs) {
+        lprintf(ERROR, "prepared plan %d expects %d values in a row, but %d were given",
+                msg->planid, plan->nargs, msg->nargs);
+    }
+    for (j = 0; j < plan->nargs; j++) {
+        if (msg->types[j].type != plan->argTypes[j].type) {
+            lprintf(ERROR, "value %d of prepared plan %d has type %s, but %s was given",
+                    j + 1, msg->planid, plc_get_type_name(plan->argTypes[j].type),
+                    plc_get_type_name(msg->types[j].type));
+        }
+    }
+
+    values = palloc((plan->nargs + 1) * sizeof(Datum));
+    nulls = palloc((plan->nargs + 1) * sizeof(char));
+    rowcontext = AllocSetContextCreate(CurrentMemoryContext,
+                                       "PL/Container insert row",
+                                       ALLOCSET_DEFAULT_MINSIZE,
+                                       ALLOCSET_DEFAULT_INITSIZE,
+                                       ALLOCSET_DEFAULT_MAXSIZE);
+
+    for (i = 0; i < msg->nrows; i++) {
+        int retval;
+
+        oldcontext = MemoryContextSwitchTo(rowcontext);
+        for (j = 0; j < plan->nargs; j++) {
+            if (msg->rows[i][j].isnull) {
+                values[j] = (Datum) 0;
+                nulls[j] = 'n';
+            } else {
+                values[j] = plan->argTypes[j].infunc(msg->rows[i][j].value, &plan->argTypes[j]);
+                nulls[j] = ' ';
+            }
+        }
+        MemoryContextSwitchTo(oldcontext);
+
+        retval = SPI_execute_plan(plan->plan, values, nulls, false, 0);
+        if (retval < 0) {
+            lprintf(ERROR, "SPI execution failed: %s", SPI_result_code_string(retval));
+        }
+        processed += SPI_processed;
+        SPI_freetuptable(SPI_tuptable);
+        MemoryContextReset(rowcontext);
+    }
+
+    MemoryContextDelete(rowcontext);
+    pfree(values);
+    pfree(nulls);
+
+    return (plcMessage*)create_count_result(processed);
+}
+
+/* Plans unknown to this session or to the connection are ignored, as releasing
+ * the plan is not answered and the client cannot be notified */
+static void unprepare_plan(plcMsgSQL *msg, plcConn *conn) {
+    if (msg->planid < 1 || msg->planid > plcPlansSize || plcPlans[msg->planid - 1].plan == NULL
+            || plcPlans[msg->planid - 1].conn != conn) {
+        return;
+    }
+    free_plan(&plcPlans[msg->planid - 1]);
+}
+
+static void free_plan(plcPlan *plan) {
+    int i;
+
+    SPI_freeplan(plan->plan);
+    for (i = 0; i < plan->nargs; i++) {
+        free_type_info(&plan->argTypes[i]);
+    }
+    pfree(plan->argTypes);
+    pfree(plan->argOids);
+    memset(plan, 0, sizeof(plcPlan));
+}
+
+static Portal get_cursor(int cursorid) {
+    Portal portal = NULL;
+
+    if (cursorid >= 1 && cursorid <= plcCursorsSize && plcCursors[cursorid - 1] != NULL) {
+        portal = SPI_cursor_find(plcCursors[cursorid - 1]);
+    }
+    if (portal == NULL) {
+        lprintf(ERROR, "cursor %d does not exist", cursorid);
+    }
+    return portal;
+}
+
+/*
+ * Opens the cursor for the query or for the prepared plan and answers with
+ * the cursor handle. Rows are not fetched till the client asks for them
+ */
+static plcMessage *open_cursor(plcMsgSQL *msg, plcConn *conn) {
+    Portal  portal;
+    int     cursorid = 0;
+    int     i;
+
+    if (msg->statement != NULL) {
+        void *tmpplan = SPI_prepare(msg->statement, 0, NULL);
+        if (tmpplan == NULL) {
+            lprintf(ERROR, "SPI_prepare failed: %s", SPI_result_code_string(SPI_result));
+        }
+        portal = SPI_cursor_open(NULL, tmpplan, NULL, NULL, false);
+        SPI_freeplan(tmpplan);
+    } else {
+        plcPlan *plan = get_plan(msg->planid, conn);
+        Datum   *values;
+        char    *nulls;
+
+        convert_plan_arguments(plan, msg, &values, &nulls);
+        portal = SPI_cursor_open(NULL, plan->plan, values, nulls, false);
+        pfree(values);
+        pfree(nulls);
+    }
+    if (portal == NULL) {
+        lprintf(ERROR, "SPI_cursor_open failed: %s", SPI_result_code_string(SPI_result));
+    }
+
+    /* Find a free slot for the cursor, growing the table if there is none */
+    for (i = 0; i < plcCursorsSize; i++) {
+        if (plcCursors[i] != NULL && SPI_cursor_find(plcCursors[i]) == NULL) {
+            pfree(plcCursors[i]);
+            plcCursors[i] = NULL;
+        }
+        if (plcCursors[i] == NULL) {
+            cursorid = i + 1;
+            break;
+        }
+    }
+    if (cursorid == 0) {
+        int size = (plcCursorsSize == 0) ? 16 : plcCursorsSize * 2;
+
+        if (plcCursors == NULL) {
+            plcCursors = (char**)plc_top_alloc(size * sizeof(char*));
+        } else {
+            plcCursors = (char**)repalloc(plcCursors, size * sizeof(char*));
+        }
+        memset(&plcCursors[plcCursorsSize], 0, (size - plcCursorsSize) * sizeof(char*));
+        cursorid = plcCursorsSize + 1;
+        plcCursorsSize = size;
+    }
+    plcCursors[cursorid - 1] = plc_top_strdup((char*)portal->name);
+
+    return (plcMessage*)create_handle_result("cursor", cursorid, 0);
+}
+
+static plcMessage *fetch_cursor(plcMsgSQL *msg, int version) {
+    Portal        portal = get_cursor(msg->cursorid);
+    plcMsgResult *result;
+
+    SPI_cursor_fetch(portal, true, (msg->limit > 0) ? msg->limit : FETCH_ALL);
+    result = create_sql_result(version);
+    SPI_freetuptable(SPI_tuptable);
+
+    return (plcMessage*)result;
+}
+
+/* Cursors unknown to this session are ignored, as closing the cursor is not
+ * answered. The portal might be already closed by the end of transaction */
+static void close_cursor(plcMsgSQL *msg) {
+    Portal portal;
+
+    if (msg->cursorid < 1 || msg->cursorid > plcCursorsSize || plcCursors[msg->cursorid - 1] == NULL) {
+        return;
+    }
+
+    portal = SPI_cursor_find(plcCursors[msg->cursorid - 1]);
+    if (portal != NULL) {
+        SPI_cursor_close(portal);
+    }
+    pfree(plcCursors[msg->cursorid - 1]);
+    plcCursors[msg->cursorid - 1] = NULL;
+}
+
+static void begin_subtransaction() {
+    if (plcSubxactDepth == plcSubxactOwnersSize) {
+        int size = (plcSubxactOwnersSize == 0) ? 16 : plcSubxactOwnersSize * 2;
+
+        if (plcSubxactOwners == NULL) {
+            plcSubxactOwners = (ResourceOwner*)plc_top_alloc(size * sizeof(ResourceOwner));
+        } else {
+            plcSubxactOwners = (ResourceOwner*)repalloc(plcSubxactOwners, size * sizeof(ResourceOwner));
+        }
+        plcSubxactOwnersSize = size;
+    }
+
+    plcSubxactOwners[plcSubxactDepth] = CurrentResourceOwner;
+    BeginInternalSubTransaction(NULL);
+    plcSubxactDepth++;
+}
+
+static void end_subtransaction(bool commit) {
+    if (plcSubxactDepth == 0) {
+        lprintf(ERROR, "there is no subtransaction to %s", commit ? "commit" : "roll back");
+    }
+
+    plcSubxactDepth--;
+    if (commit) {
+        ReleaseCurrentSubTransaction();
+    } else {
+        RollbackAndReleaseCurrentSubTransaction();
+    }
+    CurrentResourceOwner = plcSubxactOwners[plcSubxactDepth];
+}
+
+void release_plans(plcConn *conn) {
+    int i;
+
+    for (i = 0; i < plcPlansSize; i++) {
+        if (plcPlans[i].plan != NULL && plcPlans[i].conn == conn) {
+            free_plan(&plcPlans[i]);
+        }
+    }
+}
+
+int get_subtransaction_depth() {
+    return plcSubxactDepth;
+}
+
+void release_subtransactions(int depth, bool isAbort) {
+    MemoryContext oldcontext = CurrentMemoryContext;
+
+    /* Subtransactions of the aborted transaction are rolled back with it */
+    if (isAbort) {
+        if (plcSubxactDepth > depth) {
+            plcSubxactDepth = depth;
+        }
+        return;
+    }
+
+    while (plcSubxactDepth > depth) {
+        end_subtransaction(false);
+    }
+    MemoryContextSwitchTo(oldcontext);
+    SPI_restore_connection();
+}
+
+static plcMessage *process_sql_message(plcMsgSQL *msg, plcConn *conn) {
+    plcMessage *result = NULL;
+
+    switch (msg->sqltype) {
+        case SQL_TYPE_STATEMENT:
+            result = process_sql_result(SPI_exec(msg->statement, msg->limit), conn->version);
+            break;
+        case SQL_TYPE_PREPARE:
+            result = prepare_plan(msg, conn);
+            break;
+        case SQL_TYPE_PEXECUTE:
+            result = execute_plan(msg, conn);
+            break;
+        case SQL_TYPE_UNPREPARE:
+            unprepare_plan(msg, conn);
+            break;
+        case SQL_TYPE_CURSOR_OPEN:
+            result = open_cursor(msg, conn);
+            break;
+        case SQL_TYPE_FETCH:
+            result = fetch_cursor(msg, conn->version);
+            break;
+        case SQL_TYPE_CURSOR_CLOSE:
+            close_cursor(msg);
+            break;
+        case SQL_TYPE_PREPARE_INSERT:
+            result = prepare_insert(msg, conn);
+            break;
+        case SQL_TYPE_INSERT:
+            result = insert_rows(msg, conn);
+            break;
+        default:
+            lprintf(ERROR, "unsupported SQL message type %d", (int)msg->sqltype);
+            break;
+    }
+
+    return result;
+}
+
+plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, bool statementSubxact) {
     plcMessage   *result = NULL;
 
+    switch (msg->sqltype) {
+        case SQL_TYPE_SUBXACT_BEGIN:
+            begin_subtransaction();
+            return NULL;
+        case SQL_TYPE_SUBXACT_COMMIT:
+        case SQL_TYPE_SUBXACT_ROLLBACK:
+            end_subtransaction(msg->sqltype == SQL_TYPE_SUBXACT_COMMIT);
+            return NULL;
+        default:
+            break;
+    }
+
+    /*
+     * Statements inside of the explicit subtransaction share it, and the
+     * function might accept that the failed statement aborts the transaction
+     */
+    if (plcSubxactDepth > 0 || !statementSubxact) {
+        return process_sql_message(msg, conn);
+    }
+
     PG_TRY();
     {
         BeginInternalSubTransaction(NULL);
-        retval = SPI_exec(msg->statement, 0);
-        switch (retval) {
-            case SPI_OK_SELECT:
-            case SPI_OK_INSERT_RETURNING:
-            case SPI_OK_DELETE_RETURNING:
-            case SPI_OK_UPDATE_RETURNING:
-                /* some data was returned back */
-                result = (plcMessage*)create_sql_result();
-                break;
-            default:
-                lprintf(ERROR, "cannot handle non-select sql at the moment");
-                break;
-        }
-
-        SPI_freetuptable(SPI_tuptable);
+        result = process_sql_message(msg, conn);
         ReleaseCurrentSubTransaction();
     }
     PG_CATCH();
@@ -10,8 +10,21 @@
 #ifndef PLC_SQLHANDLER_H
 #define PLC_SQLHANDLER_H
 
+#include "common/comm_connectivity.h"
 #include "common/messages/messages.h"
 
-plcMessage *handle_sql_message(plcMsgSQL *msg);
+plcMessage *handle_sql_message(plcMsgSQL *msg, plcConn *conn, bool statementSubxact);
+
+/* Frees the plans prepared by the client, called before its connection is closed */
+void release_plans(plcConn *conn);
+
+/* Number of the explicit subtransactions started by the client */
+int get_subtransaction_depth(void);
+
+/*
+ * Finishes the explicit subtransactions left by the client above the given
+ * depth, rolling them back unless the transaction is already aborted
+ */
+void release_subtransactions(int depth, bool isAbort);
 
 #endif /* PLC_SQLHANDLER_H */
@@ -55,6 +55,130 @@ CREATE OR REPLACE FUNCTION pytimestamptz(t timestamptz) RETURNS timestamptz AS $
 return t
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pydatetimetypes(t timestamp, tz timestamptz, d date, tm time, i interval) RETURNS text AS $$
+# container: plc_python
+return ','.join([type(x).__name__ for x in (t, tz, d, tm, i)])
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyreturntimestamp(t timestamp) RETURNS timestamp AS $$
+# container: plc_python
+import datetime
+return t + datetime.timedelta(days=1, microseconds=1)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyreturntimestamptz() RETURNS timestamptz AS $$
+# container: plc_python
+return '2012-01-02T12:34:56.789012+04:00'
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyreturndate(d date) RETURNS date AS $$
+# container: plc_python
+import datetime
+return d + datetime.timedelta(days=1)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyreturntime(t time) RETURNS time AS $$
+# container: plc_python
+return t.replace(hour=t.hour + 1)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyreturninterval(i interval) RETURNS interval AS $$
+# container: plc_python
+import datetime
+return i + datetime.timedelta(hours=1)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyintervalstr(i interval) RETURNS text AS $$
+# container: plc_python
+return type(i).__name__ + ' ' + str(i)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyreturnsameinterval(i interval) RETURNS interval AS $$
+# container: plc_python
+return i
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytimestampstr(t timestamp) RETURNS text AS $$
+# container: plc_python
+return type(t).__name__ + ' ' + str(t)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytimestamptzstr(t timestamptz) RETURNS text AS $$
+# container: plc_python
+return type(t).__name__ + ' ' + str(t)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pydatestr(d date) RETURNS text AS $$
+# container: plc_python
+return type(d).__name__ + ' ' + str(d)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytimestr(t time) RETURNS text AS $$
+# container: plc_python
+return type(t).__name__ + ' ' + str(t)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytexttimestamp(s text) RETURNS timestamp AS $$
+# container: plc_python
+return s
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytexttimestamptz(s text) RETURNS timestamptz AS $$
+# container: plc_python
+return s
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytextdate(s text) RETURNS date AS $$
+# container: plc_python
+return s
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytexttime(s text) RETURNS time AS $$
+# container: plc_python
+return s
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytextinterval(s text) RETURNS interval AS $$
+# container: plc_python
+return s
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pynaivetimestamptz() RETURNS timestamptz AS $$
+# container: plc_python
+import datetime
+return datetime.datetime(2012, 1, 2, 12, 34, 56)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pypointlen(p point) RETURNS int AS $$
+# container: plc_python
+return len(p)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pypointpass(p point) RETURNS point AS $$
+# container: plc_python
+return p
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyreturninet() RETURNS inet AS $$
+# container: plc_python
+return '192.168.1.1/24'
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pypointsum() RETURNS float8 AS $$
+# container: plc_python
+import struct
+plpy.register_binary_type('point', lambda b: struct.unpack('>dd', bytes(b)))
+rv = plpy.execute("select '(1.5,2.5)'::point as p")
+return rv[0]['p'][0] + rv[0]['p'][1]
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pypointarr() RETURNS point[] AS $$
+# container: plc_python
+import struct
+plpy.register_binary_type('point', encoder=lambda t: struct.pack('>dd', *t))
+return [(1, 2), (3.5, 4)]
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pytext(t text) RETURNS text AS $$
 # container: plc_python
 return t+'bar'
@@ -138,7 +262,7 @@ $$ LANGUAGE plcontainer;
 
 CREATE OR REPLACE FUNCTION pytsarr(t timestamp[]) RETURNS int AS $$
 # container: plc_python
-return sum([1 if '2010' in x else 0 for x in t])
+return sum([1 if x.year == 2010 else 0 for x in t])
 $$ LANGUAGE plcontainer;
 
 CREATE OR REPLACE FUNCTION pybyteaarr(b bytea[]) RETURNS bytea AS $$
@@ -219,6 +343,11 @@ CREATE OR REPLACE FUNCTION pyreturnarrtextnulls() RETURNS text[] AS $BODY$
 return ['a','b',None,'d',None,'f']
 $BODY$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pyreturnarrtext2d(a text[]) RETURNS text[] AS $BODY$
+# container: plc_python
+return a
+$BODY$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pyreturnarrmulti() RETURNS int[] AS $BODY$
 # container: plc_python
 return [[x for x in range(5)] for _ in range(5)]
@@ -277,6 +406,113 @@ names = map(lambda x: x['fname'], res)
 return ','.join(names)
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pyresultcolumns() RETURNS text AS $$
+# container: plc_python
+res = plpy.execute('select fname, userid from users order by userid')
+return '%d %s %s %s' % (res.nrows(), ','.join(res.colnames()),
+                        ','.join(res.column('fname')), res[-1]['fname'])
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyresultlist() RETURNS text AS $$
+# container: plc_python
+import json
+res = plpy.execute('select fname from users order by userid limit 2')
+res.append({'fname': 'x'})
+return '%s %d %s' % (isinstance(res, list), len(res + []), json.dumps(res))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyresultlazy() RETURNS text AS $$
+# container: plc_python
+# lazy_rows: on
+res = plpy.execute('select fname from users order by userid')
+return '%s %d %s' % (isinstance(res, list), len(res), res[-1]['fname'])
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyprepare(n int) RETURNS text AS $$
+# container: plc_python
+if 'plan' not in SD:
+    SD['plan'] = plpy.prepare('select fname from users where userid = $1', ['int4'])
+return plpy.execute(SD['plan'], [n])[0]['fname']
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyexecutelimit() RETURNS int AS $$
+# container: plc_python
+return len(plpy.execute('select fname from users order by 1', 2))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycursor() RETURNS text AS $$
+# container: plc_python
+cur = plpy.cursor('select fname from users order by fname')
+first = [r['fname'] for r in cur.fetch(1)]
+rest = [r['fname'] for r in cur]
+cur.close()
+return ','.join(first + rest)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pycursorplan(n int) RETURNS bigint AS $$
+# container: plc_python
+plan = plpy.prepare('select generate_series(1, $1) as n', ['int4'])
+return sum(r['n'] for r in plpy.cursor(plan, [n]))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pysubtransaction() RETURNS int AS $$
+# container: plc_python
+n = 0
+with plpy.subtransaction():
+    for i in range(10):
+        n += plpy.execute('select %d as i' % i)[0]['i']
+try:
+    with plpy.subtransaction():
+        n += plpy.execute('select 100 as i')[0]['i']
+        raise ValueError('rolled back')
+except ValueError:
+    pass
+return n
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pynostatementsubxact() RETURNS int AS $$
+# container: plc_python
+# statement_subtransactions: off
+return sum(plpy.execute('select %d as i' % i)[0]['i'] for i in range(10))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyinsert(n int) RETURNS text AS $$
+# container: plc_python
+plpy.execute('truncate table_insert')
+inserted = plpy.insert('table_insert', ((i, 'name%d' % i) for i in range(n)), None, 100)
+inserted += plpy.insert('table_insert', [{'id': n}], ['id'])
+updated = plpy.execute("update table_insert set name = 'none' where name is null")
+deleted = plpy.execute('delete from table_insert where id >= 10')
+return '%d %d %d %d' % (inserted, updated.nrows(), len(updated), deleted.nrows())
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyexecutemany() RETURNS text AS $$
+# container: plc_python
+plan = plpy.prepare('select $1 * 2 as a', ['int4'])
+r = plpy.execute_many(plan, [[i] for i in range(5)])
+q = plpy.execute_many(['select 1 as a', (plan, [10]), 'select count(*) as a from table_insert'])
+return ' '.join(str(x[0]['a']) for x in r + q)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyexecuteasync() RETURNS text AS $$
+# container: plc_python
+f = plpy.execute_async('select sum(i) as s from generate_series(1, 1000) i')
+local = sum(range(10))
+r = f.result()
+p = plpy.execute_async(plpy.prepare('select $1 * 2 as a', ['int4']), [21])
+return '%d %d %d %s' % (r[0]['s'], local, p.result()[0]['a'], p.done())
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyresulttypes() RETURNS text AS $$
+# container: plc_python
+res = []
+for i in range(3):
+    a = plpy.execute('select %d as a, \'x\'::text as t' % i)
+    b = plpy.execute('select %d as b, 1.5::float8 as t' % i)
+    res.append('%d %s %d %s' % (a[0]['a'], a[0]['t'], b[0]['b'], b[0]['t']))
+return ', '.join(res)
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pynested_call_one(a text) RETURNS text AS $$
 # container: plc_python
 q = "SELECT pynested_call_two('%s')" % a
@@ -296,6 +532,16 @@ CREATE OR REPLACE FUNCTION pynested_call_three(a text) RETURNS text AS $$
 return a
 $$ LANGUAGE plcontainer ;
 
+CREATE OR REPLACE FUNCTION pyreplace_nested() RETURNS text AS $$
+# container: plc_python
+plpy.execute("""CREATE OR REPLACE FUNCTION pyreplace_nested() RETURNS text AS $f$
+# container: plc_python
+return 'replaced'
+$f$ LANGUAGE plcontainer""")
+r = plpy.execute("SELECT pyreplace_nested() AS r")
+return 'original, nested ' + r[0]['r']
+$$ LANGUAGE plcontainer ;
+
 CREATE OR REPLACE FUNCTION py_plpy_get_record() RETURNS int AS $$
 # container: plc_python
 import sys
@@ -351,6 +597,18 @@ CREATE OR REPLACE FUNCTION pylogging2() RETURNS void AS $$
 plpy.execute('select pylogging()')
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pyloglevel() RETURNS void AS $$
+# container: plc_python
+plpy.debug('debug before the exception')
+plpy.notice('notice before the exception')
+try:
+    raise ValueError('handled exception')
+except ValueError as e:
+    plpy.warning('warning on the %s' % e)
+plpy.notice('notice after the exception')
+plpy.error('error after the messages')
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pygdset(key varchar, value varchar) RETURNS text AS $$
 # container: plc_python
 GD[key] = value
@@ -397,6 +655,16 @@ CREATE OR REPLACE FUNCTION pyunargs4(int, int, int, int) RETURNS int AS $$
 return len(args)
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pyoverload(a int) RETURNS text AS $$
+# container: plc_python
+return 'int %d' % a
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyoverload(a text) RETURNS text AS $$
+# container: plc_python
+return 'text ' + a
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pylargeint8in(a int8[]) RETURNS float8 AS $$
 #container : plc_python
 return sum(a)/float(len(a))
@@ -495,6 +763,31 @@ CREATE OR REPLACE FUNCTION pytestudt16() RETURNS SETOF test_type3 AS $$
 return {'a': [1,3], 'b': [2,4], 'c': ['foo','bar']}
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pytestudtnamedtuple(r test_type3) RETURNS test_type3 AS $$
+# container: plc_python
+# namedtuple_rows: on
+return r._replace(a = r.a + len(r._fields))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyspinamedtuplerows() RETURNS text AS $$
+# container: plc_python
+# namedtuple_rows: on
+rv = plpy.execute("select 1 as a, 'x'::text as b")
+return '%d %s %s' % (rv[0].a, rv[0].b, isinstance(rv[0], tuple))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyspidictrows() RETURNS text AS $$
+# container: plc_python
+# namedtuple_rows: off
+rv = plpy.execute("select 1 as a, 'x'::text as b")
+return '%d %s %s' % (rv[0]['a'], rv[0]['b'], isinstance(rv[0], dict))
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pytestudtdropped(r table_dropped) RETURNS table_dropped AS $$
+# container: plc_python
+return {'a': r['a'] + 1, 'c': r['c'] + len(r)}
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pytestudtrecord1() RETURNS record AS $$
 # container: plc_python
 return {'a': 1, 'b': 2, 'c': 'foo'}
@@ -553,6 +846,18 @@ import math
 return math.log10(100)
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pypreload() RETURNS text AS $$
+# container: plc_python_preload
+import sys
+return '%s %s' % ('fractions' in sys.modules, 'xml.dom.minidom' in sys.modules)
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pynopreload() RETURNS text AS $$
+# container: plc_python
+import sys
+return '%s %s' % ('fractions' in sys.modules, 'xml.dom.minidom' in sys.modules)
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pyanaconda() RETURNS double precision AS $$
 # container: plc_anaconda
 import sklearn
@@ -562,6 +867,18 @@ import pandas
 return 1.0
 $$ LANGUAGE plcontainer;
 
+CREATE OR REPLACE FUNCTION pyanacondanumpy(a float8[]) RETURNS float8[] AS $$
+# container: plc_anaconda
+# numpy_arrays: on
+return a * a.shape[0]
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyanacondanumpysum(a int4[]) RETURNS int8 AS $$
+# container: plc_anaconda
+# numpy_arrays: on
+return a.sum()
+$$ LANGUAGE plcontainer;
+
 CREATE OR REPLACE FUNCTION pyversion() RETURNS varchar AS $$
 # container : plc_python_shared
 import sys
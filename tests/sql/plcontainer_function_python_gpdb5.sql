@@ -65,4 +65,20 @@ CREATE OR REPLACE FUNCTION pybadudtarr2() RETURNS test_type4[] AS $$
 # container: plc_python
 return [ {'a': 1, 'b': [2, 3], 'c': ['foo', 'bar']},
          {'a': 4, 'b': [5, 'f'], 'c': ['a', 'b']} ]
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyjson(j json) RETURNS json AS $$
+# container: plc_python
+return {'b': j['a'] * 2}
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyjsonarr(j json[]) RETURNS int AS $$
+# container: plc_python
+return sum([x['a'] for x in j])
+$$ LANGUAGE plcontainer;
+
+CREATE OR REPLACE FUNCTION pyuuid(u uuid) RETURNS uuid AS $$
+# container: plc_python
+import uuid
+return uuid.UUID(int=u.int + 1)
 $$ LANGUAGE plcontainer;
\ No newline at end of file
@@ -81,6 +81,17 @@ CREATE TABLE table_record (
     second int4
 );
 
+CREATE TABLE table_dropped (
+    a int4,
+    b text,
+    c int4
+) DISTRIBUTED BY (a);
+
+CREATE TABLE table_insert (
+    id int4,
+    name text
+) DISTRIBUTED BY (id);
+
 /* Inserting some test data */
 
 INSERT INTO users (fname, lname, username) VALUES ('jane', 'doe', 'j_doe');
@@ -105,4 +116,7 @@ INSERT INTO sequences (sequence, eid, product) VALUES ('ABCDEF', 2, 'env') ;
 INSERT INTO sequences (sequence, eid, product) VALUES ('ABCDEF', 3, 'env') ;
 INSERT INTO sequences (sequence, eid, product) VALUES ('ABCDEF', 4, 'gag') ;
 INSERT INTO sequences (sequence, eid, product) VALUES ('ABCDEF', 5, 'env') ;
-INSERT INTO sequences (sequence, eid, product) VALUES ('ABCDEF', 6, 'ns1') ;
\ No newline at end of file
+INSERT INTO sequences (sequence, eid, product) VALUES ('ABCDEF', 6, 'ns1') ;
+
+INSERT INTO table_dropped VALUES (1, 'foo', 2);
+ALTER TABLE table_dropped DROP COLUMN b;
\ No newline at end of file
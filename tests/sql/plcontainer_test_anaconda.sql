@@ -1 +1,3 @@
-select pyanaconda();
\ No newline at end of file
+select pyanaconda();
+select pyanacondanumpy(array[[1,2],[3,4]]::float8[]);
+select pyanacondanumpysum(array[1,2,3]::int4[]);
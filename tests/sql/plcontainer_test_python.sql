@@ -11,6 +11,46 @@ select pyfloat(3.1415926535897932384626433832::float8);
 select pynumeric(3.1415926535897932384626433832::numeric);
 select pytimestamp('2012-01-02 12:34:56.789012'::timestamp);
 select pytimestamptz('2012-01-02 12:34:56.789012 UTC+4'::timestamptz);
+select pydatetimetypes('2012-01-02 12:34:56'::timestamp, '2012-01-02 12:34:56 UTC'::timestamptz, '2012-01-02'::date, '12:34:56'::time, '1 day'::interval);
+select pyreturntimestamp('2012-01-02 12:34:56.789012'::timestamp);
+select pyreturntimestamptz();
+select pyreturndate('2016-12-31'::date) = '2017-01-01'::date;
+select pyreturntime('12:34:56.789'::time) = '13:34:56.789'::time;
+select pyreturninterval('1 day 02:00:00'::interval)::text;
+select pyintervalstr('1 mon'::interval);
+select pyintervalstr('24:00:00'::interval);
+select pyintervalstr('1 day 02:00:00'::interval);
+select pyreturnsameinterval('1 mon'::interval)::text;
+select pyreturnsameinterval('24:00:00'::interval)::text;
+select pyreturnsameinterval('-01:00:00'::interval)::text;
+select pytimestampstr('infinity'::timestamp);
+select pytimestampstr('-infinity'::timestamp);
+select pytimestampstr('0044-03-15 12:00:00 BC'::timestamp);
+select pytimestampstr('10000-01-01 00:00:00'::timestamp);
+select pytimestamptzstr('infinity'::timestamptz);
+select pytimestamptzstr('0044-03-15 12:00:00+00 BC'::timestamptz);
+select pydatestr('0044-03-15 BC'::date);
+select pydatestr('10000-01-01'::date);
+select pytimestr('24:00:00'::time);
+select pytexttimestamp('infinity');
+select pytexttimestamp('epoch');
+select pytexttimestamp('Jan 1 2020');
+select pytexttimestamp('now') = 'now'::timestamp;
+select pytexttimestamp('2020-02-29 24:00:00');
+select pytexttimestamptz('2012-01-02 12:34:56');
+select pynaivetimestamptz();
+select pytextdate('2020-02-29');
+select pytextdate('2020-02-31');
+select pytextdate('2021-04-31');
+select pytexttime('24:00:00');
+select pytextinterval('36:00:00');
+select pytextinterval('100:00:00');
+select pytextinterval('1 day 2 hours');
+select pypointlen('(1.5,2.5)'::point);
+select pypointpass('(1.5,2.5)'::point);
+select pyreturninet();
+select pypointsum();
+select pypointarr();
 select pytext('text');
 select pytext('');
 select pybytea('123'::bytea);
@@ -51,6 +91,7 @@ select pyreturnarrbytea2(14);
 select pyreturntupint8();
 select pyreturnarrint8nulls();
 select pyreturnarrtextnulls();
+select pyreturnarrtext2d(array[['a',null],['','b c']]::text[]);
 select pyreturnarrmulti();
 select pyreturnsetofint8(5);
 select pyreturnsetofint4arr(6);
@@ -63,12 +104,42 @@ select pywriteFile();
 \! ls -l /tmp/foo
 select pyconcat(fname, lname) from users order by 1;
 select pyconcatall();
+select pyresultcolumns();
+select pyresultlist();
+select pyresultlazy();
+select pyprepare(n) from generate_series(1, 4) n order by 1;
+select pyexecutelimit();
+select pycursor();
+select pycursorplan(2500);
+select pysubtransaction();
+select pynostatementsubxact();
+select pyinsert(250);
+select count(*) from table_insert;
+select pyexecutemany();
+select pyexecuteasync();
+select pyresulttypes();
+select counter, value > 0 as positive from plcontainer_client_counters() where container_name = 'plc_python' order by 1;
+select function_name, calls > 0 as called, array_upper(time_histogram, 1) as buckets from plcontainer_client_stats() where container_name = 'plc_python' and function_name = 'pybool';
+select function_name, calls > 0 as called, bytes_sent > 0 and bytes_received > 0 as transferred from plcontainer_function_stats_summary() where function_name = 'pybool';
+select bool_and(status = 'on') as enabled from plcontainer_trace(true);
+select pybool('t');
+select name, phase from plcontainer_local_trace_events() where thread_name = 'plc_python' and name = 'python execute' group by 1, 2 order by 2;
+select plcontainer_trace_dump() like '{"traceEvents":[%]}' as dumped;
+select plcontainer_json_string(E'a"b\\c') as quoted;
+select plcontainer_json_string(E'a\tb\nc\001d') as escaped;
+select bool_and(status = 'off') as disabled from plcontainer_trace(false);
 select pynested_call_three('a');
 select pynested_call_two('a');
 select pynested_call_one('a');
+select pyreplace_nested();
+select pyreplace_nested();
 select py_plpy_get_record();
 select pylogging();
 select pylogging2();
+set client_min_messages = warning;
+select pyloglevel();
+reset client_min_messages;
+select pyloglevel();
 select pygdset('1','a');
 select pygdset('2','b');
 select pygdset('3','c');
@@ -85,6 +156,11 @@ select pyunargs1('foo');
 select pyunargs2(123, 'foo');
 select pyunargs3(123, 'foo', 'bar');
 select pyunargs4(1,null,null,1);
+select pyoverload(1);
+select pyoverload('a'::text);
+select pyoverload(2);
+select pypreload();
+select pynopreload();
 select pylargeint8in(array_agg(id)) from generate_series(1,100000) id;
 select avg(x) from (select unnest(pylargeint8out(100000)) as x) as q;
 select pylargetextin(string_agg(x,',')) from (select x::varchar from generate_series(1,100000) x) as q;
@@ -104,6 +180,10 @@ select pytestudt8();
 select * from pytestudt11();
 select * from pytestudt13( (1,2,'a')::test_type3 );
 select pytestudt16();
+select * from pytestudtnamedtuple( (1,2,'a')::test_type3 );
+select pyspinamedtuplerows();
+select pyspidictrows();
+select * from pytestudtdropped( (select t from table_dropped t) );
 select * from pytestudtrecord1() as t(a int, b int, c varchar);
 select * from pytestudtrecord2() as t(a int, b int, c varchar);
 select pyreturnsetofint8(2), pyreturnsetofint8(3);
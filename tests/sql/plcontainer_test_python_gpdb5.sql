@@ -13,4 +13,7 @@ select unnest(a) from (select pytestudt12() as a) as q;
 select * from unnest(pytestudt14( array[(1,1,'a'), (2,2,'b'), (3,3,'c')]::test_type3[] ));
 select * from pytestudt15( array[(1,1,'a'), (2,2,'b'), (3,3,'c')]::test_type3[] );
 select pybadudtarr();
-select pybadudtarr2();
\ No newline at end of file
+select pybadudtarr2();
+select pyjson('{"a": 21}'::json)::text;
+select pyjsonarr(array['{"a": 1}', '{"a": 2}']::json[]);
+select pyuuid('a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'::uuid);
\ No newline at end of file